@@ -6,22 +6,71 @@
 #include "Arduino.h"
 #include "math.h"
 #include "utility/PID_v1mod.h"
+#include "utility/PID_v1fix.h"
+#include "utility/AdcScan.h"
 #include "Rims.h"
 
+#ifdef WITH_PROFILER
+	///\brief Run statement and add its duration to stage of _profiler
+	#define PROFILE(stage,statement) \
+		{unsigned long profileStart = micros(); statement; \
+		 _profiler.add(stage,micros()-profileStart);}
+#else
+	#define PROFILE(stage,statement) {statement;}
+#endif
+
 /*
 ============================================================
 Global Variable
 ============================================================
 */
 
-///\brief Last time interrupt was called [µSec]
-volatile unsigned long g_flowLastTime = 0;
-///\brief Current time interrupt is called [µSec]
-volatile unsigned long g_flowCurTime = 0;
-///\brief ISR for flow sensor.
-void isrFlow(); /// ISR for flow sensor
+#if FLOWMAXINTERRUPTS != 2
+	#error "FLOWMAXINTERRUPTS : g_isrFlows has one isrFlow per interrupt"
+#endif
+///\brief Flow sensor pulses counted on each interrupt
+volatile unsigned long g_flowPulses[FLOWMAXINTERRUPTS];
+///\brief Time of the last flow sensor pulse on each interrupt [µSec]
+volatile unsigned long g_flowLastPulse[FLOWMAXINTERRUPTS];
+///\brief Incremented after each pulse, for tear-free snapshots
+volatile byte g_flowSequence[FLOWMAXINTERRUPTS];
+///\brief ISR for flow sensor on interrupt 0.
+void isrFlow0();
+///\brief ISR for flow sensor on interrupt 1.
+void isrFlow1();
+///\brief ISR attached for each interrupt number
+void (* const g_isrFlows[FLOWMAXINTERRUPTS])() = {isrFlow0, isrFlow1};
 ///\brief Header for csv printing on serial monitor
-const char g_csvHeader[] = "time,sp,cv,pv,flow,timerRemaining";
+const char g_csvHeader[] PROGMEM = "time,sp,cv,pv,flow,timerRemaining";
+#ifndef pgm_read_ptr
+///\brief avr-libc of IDE 1.0.x has no pgm_read_ptr, AVR pointers are words
+#define pgm_read_ptr(addr) ((const void*)pgm_read_word(addr))
+#endif
+const char g_taskSSR[] PROGMEM = "ssr";
+const char g_taskTimer[] PROGMEM = "timer";
+const char g_taskTelemetry[] PROGMEM = "telemetry";
+const char g_taskMem[] PROGMEM = "flash";
+const char g_taskLCD[] PROGMEM = "lcd";
+const char g_taskTherm[] PROGMEM = "therm";
+const char g_taskPID[] PROGMEM = "pid";
+const char g_taskDisplay[] PROGMEM = "display";
+const char g_taskLog[] PROGMEM = "log";
+const char g_taskKeys[] PROGMEM = "keys";
+const char g_taskProfiler[] PROGMEM = "profiler";
+const char g_taskIdentStep[] PROGMEM = "step";
+const char g_taskIdentSample[] PROGMEM = "sample";
+///\brief Name of each task id, see Rims::getTaskName()
+const char* const g_taskNames[TASKIDQTY] PROGMEM = {
+	g_taskSSR, g_taskTimer, g_taskTelemetry, g_taskMem, g_taskLCD,
+	g_taskTherm, g_taskPID, g_taskDisplay, g_taskLog, g_taskKeys,
+	g_taskProfiler, g_taskIdentStep, g_taskIdentSample, g_taskKeys};
+///\brief Priority of each task id, lower runs first (periodic tasks)
+const byte g_taskPriorities[TASKIDQTY] PROGMEM = \
+	{0,0,0,0,0,0,1,2,3,4,255,0,1,2};
+#ifdef WITH_W25QFLASH
+///\brief Size of each field of a flash log keyframe [bytes]
+const byte g_memKeyframeSizes[MEMFIELDS] = {4,2,2,2,4};
+#endif
 
 /*
 ============================================================
@@ -42,13 +91,28 @@ RIMS class definition
  */
 Rims::Rims(UIRims* uiRims, byte analogPinTherm, byte ssrPin, 
 	       double* currentTemp, double* ssrControl, double* settedTemp)
-: _ui(uiRims), _analogPinPV(analogPinTherm), _pinCV(ssrPin),
-  _processValPtr(currentTemp), _controlValPtr(ssrControl), _setPointPtr(settedTemp),
+: _ui(uiRims),
   _myPID(currentTemp, ssrControl, settedTemp, 0, 0, 0, DIRECT),
-  _pidQty(0), 
-  _stopOnCriticalFlow(false), _rimsInitialized(false),
+  _myPIDFix(&_processValFix, &_controlValFix, &_setPointFix, 0, 0, 0, DIRECT),
+  _analogPinPV(analogPinTherm), _pinCV(ssrPin),
+  _pinLED(13),_pinHeaterVolt(-1),
+  _ssrModulation(SSRWINDOW), _mainsFreq(DEFAULTMAINSFREQ), _ssrAccumulator(0),
+  _ssrChannel(-1), _taskQty(0),
+  _rimsInitialized(false), _stopOnCriticalFlow(false), _noPower(false),
   _memConnected(false),
-  _pinLED(13),_pinHeaterVolt(-1), _noPower(false)
+  _pidQty(0), _useFixedPID(false), _tuningTablePGM(NULL), _tuningRowQty(0),
+  _gainScheduling(GAINSCHEDVOLUME), _tableFixedPID(false),
+  _mashWater(0), _gainKey(0),
+  _thermTablePGM(NULL), _thermTablePGMStep(1),
+  _thermSum(0), _thermSampleIndex(0), _thermSamplesReady(false),
+  _setPointPtr(settedTemp), _processValPtr(currentTemp), _controlValPtr(ssrControl),
+  _setPointFix(0), _processValFix(0), _controlValFix(0),
+  _pidSampleTime(SAMPLETIME), _displayPeriod(SAMPLETIME),
+  _logPeriod(SAMPLETIME),
+  _interruptFlow(-1), _flowSlot(0)
+#ifdef WITH_W25QFLASH
+  , _memLogLoaded(false), _memPageData(0), _memPageLen(MEMPAGEHEADER)
+#endif
 {
 	_steinhartCoefs[0] = DEFAULTSTEINHART0;
 	_steinhartCoefs[1] = DEFAULTSTEINHART1;
@@ -56,13 +120,28 @@ Rims::Rims(UIRims* uiRims, byte analogPinTherm, byte ssrPin,
 	_steinhartCoefs[3] = DEFAULTSTEINHART3;
 	_res1 = DEFAULTRES1;
 	_fineTuneTemp = 0;
+	_buildThermTable();
+	AdcScan::addChannel(analogPinTherm);
 	for(int i=0;i<=3;i++)
 	{
 		_kps[i] = 0; _kis[i] = 0; _kds[i] = 0; _tauFilter[i] = 0; 
-		_mashWaterValues[i] = -1;
+		_mashWaterValues[i] = -1; _fixedPIDs[i] = false;
 	}
+	for(int i=0;i<LOGCHANNELS;i++)
+	{
+		_logDecimations[i] = _logBurstDecimations[i] = 1;
+	}
+	_logTicks = _logTransientTime = 0;
 	_myPID.SetSampleTime(SAMPLETIME);
 	_myPID.SetOutputLimits(0,SSRWINDOWSIZE);
+	_myPIDFix.SetSampleTime(SAMPLETIME);
+	_myPIDFix.SetOutputLimits(0,SSRWINDOWSIZE);
+#ifdef WITH_PROFILER
+	_profiler.setName(PROFILERPASS,F("pass"));
+	_profiler.setName(PROFILERTEMP,F("temp"));
+	_profiler.setName(PROFILERCOMPUTE,F("compute"));
+	_profiler.setName(PROFILERPUSH,F("push"));
+#endif
 	_settedTime = (unsigned long)DEFAULTTIME*1000;
 	*(_setPointPtr) = DEFAULTSP;
 	_currentPID = 0;
@@ -81,15 +160,50 @@ Rims::Rims(UIRims* uiRims, byte analogPinTherm, byte ssrPin,
  *   	  \f]
  *        for more information : http://en.wikipedia.org/wiki/Steinhart%E2%80%93Hart_equation
  *
+ * The equation is evaluated here only, every THERMTABLESTEP ADC counts,
+ * to fill a table of THERMTABLESIZE temperatures. getTempPV() then
+ * interpolates linearly in this table instead of calling log() and
+ * pow() at each sample. With THERMTABLESTEP = 12, interpolation error
+ * is below 0.03 celcius between 20 and 105 celcius.
+ *
  * \param res1 : float. In ohm.
  * \param fineTuneTemp : float. optional (default=0). if you want to add a fine tune factor
           after the steinhart-hart temperature calculation.
  */
 void Rims::setThermistor(float steinhartCoefs[], float res1, float fineTuneTemp)
 {
-	for(int i=0;i<=4;i++) _steinhartCoefs[i] = steinhartCoefs[i];
+	for(int i=0;i<4;i++) _steinhartCoefs[i] = steinhartCoefs[i];
 	_res1 = res1;
-	_fineTuneTemp = fineTuneTemp;
+	_fineTuneTemp = (long)floor(100*fineTuneTemp+0.5);
+	_thermTablePGM = NULL;
+	_buildThermTable();
+}
+
+/*!
+ * \brief Set a precomputed thermistor table stored in flash memory.
+ *
+ * Same as setThermistor() but the temperature table is given
+ * (declared with PROGMEM) instead of being computed and kept in SRAM.
+ * With step = 1, there is one entry for each ADC value from 0 to
+ * THERMADCMAX, i.e. (THERMADCMAX+1) entries, and no interpolation
+ * error. The thermTable tool of extras/host generates it from the
+ * Steinhart-hart coefficients :
+ *
+ *     ./thermTable 0.0006 0.0003 -0.000007 0.0000003 10000 > thermTable.h
+ *
+ * \param tablePGM : int16_t[]. Temperatures in hundredths of celcius
+ *                   for ADC = 0, step, 2*step, ..., THERMADCMAX.
+ * \param step : byte (default=1). ADC counts between two entries.
+ *               THERMADCMAX must be a multiple of it.
+ * \param fineTuneTemp : float. optional (default=0). Added to the
+ *                       temperature read in the table.
+ */
+void Rims::setThermistorTable(const int16_t tablePGM[], byte step,
+							  float fineTuneTemp)
+{
+	_thermTablePGM = tablePGM;
+	_thermTablePGMStep = step;
+	_fineTuneTemp = (long)floor(100*fineTuneTemp+0.5);
 }
 
 /*!
@@ -129,19 +243,118 @@ void Rims::setThermistor(float steinhartCoefs[], float res1, float fineTuneTemp)
  *                       This mash water volume will be associated to this PID.
  *                       Total of 4 regulators is allowed (with different
  *                       mash water volume).
+ *                       For an interpolated tuning at any volume, see
+ *                       setTuningTable().
+ * \param fixedPoint : boolean (default=false). If true, this regulator
+ *                     is computed by PIDfix : same algorithm and same
+ *                     gains, but with 32 bits integers only (temperatures
+ *                     in hundredths of celcius, Q16.16 internal terms),
+ *                     which avoids software floating point on AVR at
+ *                     each sample.
  */
 void Rims::setTuningPID(double Kp, double Ki, double Kd, double tauFilter,
-                        int mashWaterQty)
+                        int mashWaterQty, boolean fixedPoint)
 {
 	if(mashWaterQty != -1) _currentPID = _pidQty;
 	else _currentPID = 0;
 	_kps[_currentPID] = Kp; _kis[_currentPID] = Ki; _kds[_currentPID] = Kd;
     _tauFilter[_currentPID] = tauFilter;
 	_mashWaterValues[_currentPID] = mashWaterQty;
+	_fixedPIDs[_currentPID] = fixedPoint;
 	_currentPID = 0;
 	_pidQty++;
 }
 
+/*!
+ * \brief Set a gain table stored in flash memory, instead of
+ *        setTuningPID().
+ *
+ * Each row is {key, Kp, Ki, Kd, tauFilter}, rows sorted by increasing
+ * key. The gains used are linearly interpolated between the two rows
+ * around the key (first or last row beyond the table), so every mash
+ * volume between two calibrated points gets its own tuning :
+ *
+ *     const float tuning[][TUNINGCOLUMNS] PROGMEM = {
+ *         {10, 1500, 4, -100000, 80},
+ *         {20, 2000, 5, -150000, 80},
+ *         {35, 2600, 6, -200000, 80}};
+ *     rims.setTuningTable(tuning,3);
+ *
+ * With GAINSCHEDVOLUME, the exact mash water quantity is asked at
+ * start (UIRims::askMashVolume()) and the gains are set once. With
+ * GAINSCHEDFLOW or GAINSCHEDTEMP, the gains are interpolated again at
+ * each PID sample from the measured flow [L/min] or the process value
+ * [celcius], once it moved by GAINSCHEDDEADBAND or more. The change
+ * is bumpless (PIDmod::TransferTunings()) : the integral term takes
+ * the step of the proportional and derivative terms.
+ *
+ * \param tablePGM : float[][TUNINGCOLUMNS]. Declared with PROGMEM.
+ * \param rowQty : byte. Rows of tablePGM, 0 to go back to
+ *                 setTuningPID() regulators.
+ * \param scheduling : byte (default=GAINSCHEDVOLUME). Key of the rows :
+ *                     GAINSCHEDVOLUME, GAINSCHEDFLOW or GAINSCHEDTEMP.
+ * \param fixedPoint : boolean (default=false). Compute with PIDfix,
+ *                     see setTuningPID().
+ */
+void Rims::setTuningTable(const float tablePGM[][TUNINGCOLUMNS],
+                          byte rowQty, byte scheduling, boolean fixedPoint)
+{
+	_tuningTablePGM = (rowQty > 0) ? tablePGM : NULL;
+	_tuningRowQty = rowQty;
+	_gainScheduling = scheduling;
+	_tableFixedPID = fixedPoint;
+	if(rowQty > 0) _mashWater = pgm_read_float(&tablePGM[0][0]);
+}
+
+/*!
+ * \brief Interpolate the gain table at key and give the gains to the
+ *        PIDs.
+ * \param key : float. Mash water [L], flow [L/min] or temperature
+ *              [celcius], see setTuningTable()
+ * \param transfer : boolean. If true, bumpless change of the running
+ *                   PID, else both PIDs are set (before the session).
+ */
+void Rims::_scheduleGains(float key, boolean transfer)
+{
+	float tunings[TUNINGCOLUMNS], key0, key1, frac = 0;
+	byte row = 0, last = _tuningRowQty - 1;
+	while(row+1 < last and \
+	      key >= pgm_read_float(&_tuningTablePGM[row+1][0])) row++;
+	if(last > 0)
+	{
+		key0 = pgm_read_float(&_tuningTablePGM[row][0]);
+		key1 = pgm_read_float(&_tuningTablePGM[row+1][0]);
+		if(key1 > key0) frac = constrain((key-key0)/(key1-key0),0.0,1.0);
+	}
+	for(byte col=1;col<TUNINGCOLUMNS;col++)
+	{
+		tunings[col] = pgm_read_float(&_tuningTablePGM[row][col]);
+		if(frac > 0)
+		{
+			tunings[col] += frac * \
+				(pgm_read_float(&_tuningTablePGM[row+1][col]) - tunings[col]);
+		}
+	}
+	_gainKey = key;
+	if(transfer)
+	{
+		if(_useFixedPID)
+		{
+			_myPIDFix.TransferTunings(tunings[1],tunings[2],tunings[3],
+			                          tunings[4]);
+		}
+		else _myPID.TransferTunings(tunings[1],tunings[2],tunings[3],
+		                            tunings[4]);
+	}
+	else
+	{
+		_myPID.SetTunings(tunings[1],tunings[2],tunings[3]);
+		_myPID.SetDerivativeFilter(tunings[4]);
+		_myPIDFix.SetTunings(tunings[1],tunings[2],tunings[3]);
+		_myPIDFix.SetDerivativeFilter(tunings[4]);
+	}
+}
+
 /*!
  * \brief Set interrupt function for flow sensor.
  * 
@@ -150,6 +363,10 @@ void Rims::setTuningPID(double Kp, double Ki, double Kd, double tauFilter,
  * an Arduino UNO, if interrupt #1 is used for the flow sensor,
  * you should call in setup() : pinMode(3,INPUT_PULLUP);
  * 
+ * Each Rims instance can have its own sensor on its own interrupt
+ * (up to FLOWMAXINTERRUPTS, e.g. an HLT loop and a RIMS loop on the
+ * same board). Instances given the same interrupt share its pulses.
+ * 
  * \param interruptFlow : byte. Interrupt pin number connected to the
  *                        flow sensor. For more info :
  *                        http://arduino.cc/en/Reference/attachInterrupt
@@ -170,8 +387,17 @@ void Rims::setInterruptFlow(byte interruptFlow, float flowFactor,
 							float lowBound,float upBound,
 							boolean stopOnCriticalFlow)
 {
-	attachInterrupt(interruptFlow,isrFlow,RISING);
+	if(interruptFlow >= FLOWMAXINTERRUPTS) return;
+	attachInterrupt(interruptFlow,g_isrFlows[interruptFlow],RISING);
+	_interruptFlow = interruptFlow;
 	_flowFactor = flowFactor;
+	unsigned long pulses, lastPulse;
+	_flowSnapshot(pulses,lastPulse);
+	for(byte i=0;i<FLOWWINDOWSLOTS;i++)
+	{
+		_flowPulses[i] = pulses; _flowPulseTimes[i] = lastPulse;
+	}
+	_flowSlotTime = millis();
 	_ui->setFlowBounds(lowBound,upBound);
 	_stopOnCriticalFlow = stopOnCriticalFlow;
 }
@@ -186,6 +412,25 @@ void Rims::setPinLED(byte pinLED)
 	_pinLED = pinLED;
 }
 
+/*!
+ * \brief Set how the SSR on-time is applied in each SSRWINDOWSIZE
+ *        window.
+ *
+ * SSRWINDOW (default) turns the SSR on at the start of the window for
+ * the whole on-time. SSRSIGMADELTA spreads the same on-time over the
+ * window in whole mains cycles, evenly distributed (see SsrTimer) :
+ * less temperature ripple in the tube at low flow. It needs a
+ * zero-cross SSR.
+ *
+ * \param modulation : byte. SSRWINDOW or SSRSIGMADELTA
+ * \param mainsFreq : byte. 50 or 60 [Hz]
+ */
+void Rims::setSSRModulation(byte modulation, byte mainsFreq)
+{
+	_ssrModulation = modulation;
+	_mainsFreq = mainsFreq;
+}
+
 /*!
  * \brief Set pin to detect if there is voltage applied on heater.
  * 
@@ -212,6 +457,162 @@ void Rims::setHeaterPowerDetect(char pinHeaterVolt)
 	_pinHeaterVolt = pinHeaterVolt;
 }
 
+/*!
+ * \brief Choose how data points are sent on the serial port, at each
+ *        log period (see setSampleTimes()). Can be called at any time.
+ *
+ * Data points are written in a ring buffer and sent by the next
+ * iterations, as fast as the serial port takes them : the regulation
+ * never waits for the serial port. When the buffer is full, data
+ * points are dropped and counted.
+ *
+ * \param mode : byte. TELEMETRYCSV (default, g_csvHeader columns),
+ *               TELEMETRYBINARY (SLIP frames, see Telemetry::push(),
+ *               decoded by extras/host/memDump) or TELEMETRYOFF.
+ * \param baud : unsigned long (default=TELEMETRYBAUD). Same as given
+ *               to Serial.begin().
+ */
+void Rims::setTelemetry(byte mode, unsigned long baud)
+{
+	_telemetry.setMode(mode,baud);
+}
+
+/*!
+ * \brief Choose the fields sent by the telemetry. Takes effect at the
+ *        start of the next brew session (CSV header).
+ * \param fields : unsigned int. TELEMETRYTIME, TELEMETRYSP... ORed,
+ *                 TELEMETRYDEFAULTFIELDS are the g_csvHeader ones.
+ *                 PID terms (TELEMETRYPTERM...) are in mSec of SSR
+ *                 window, as the cv.
+ */
+void Rims::setTelemetryFields(unsigned int fields)
+{
+	_telemetry.setFields(fields);
+}
+
+/*!
+ * \brief Data points dropped since the start of the brew session,
+ *        serial port too slow for the telemetry.
+ */
+unsigned int Rims::getTelemetryDropped()
+{
+	return _telemetry.dropped();
+}
+
+#ifdef WITH_PROFILER
+/*!
+ * \brief Print the timing statistics of each task, of the whole
+ *        _iterate() pass and of a few parts of the tasks
+ *        (PROFILERTEMP...) since the start of the session, see
+ *        Profiler::print(). Also sent with the serial command 'p'.
+ *
+ * Serial.print() waits here : call it between sessions, or expect a
+ * late task.
+ */
+void Rims::printProfile()
+{
+	_profiler.print(Serial);
+}
+
+/*!
+ * \brief Clear the timing statistics (serial command 'r').
+ */
+void Rims::resetProfile()
+{
+	_profiler.reset();
+}
+#endif
+
+/*!
+ * \brief Tasks of the cooperative scheduler (see _addTask()), set by
+ *        run() at the start of a session.
+ */
+byte Rims::getTaskQty()
+{
+	return _taskQty;
+}
+
+/*!
+ * \brief Name of a task, for reports.
+ * \param task : byte. 0 to getTaskQty()-1
+ */
+const __FlashStringHelper* Rims::getTaskName(byte task)
+{
+	return (const __FlashStringHelper*) \
+	       pgm_read_ptr(&g_taskNames[_taskIds[task]]);
+}
+
+#ifdef WITH_PROFILER
+/*!
+ * \brief Runs of a task skipped since the start of the session : it
+ *        started a whole period late. Shows which task is slow (or
+ *        delayed by the ones with a lower priority). WITH_PROFILER.
+ * \param task : byte. 0 to getTaskQty()-1
+ */
+unsigned int Rims::getTaskMisses(byte task)
+{
+	return _taskMisses[task];
+}
+
+/*!
+ * \brief Longest delay between the time a task was due and its run
+ *        since the start of the session [mSec]. WITH_PROFILER.
+ * \param task : byte. 0 to getTaskQty()-1
+ */
+unsigned long Rims::getTaskMaxLate(byte task)
+{
+	return _taskMaxLates[task];
+}
+#endif
+
+/*!
+ * \brief Set the data point rate of a data log channel, as a
+ *        decimation of the log period (see setSampleTimes(),
+ *        IDENTSAMPLETIME for RimsIdent).
+ *
+ * For exemple, setLogRate(LOGFLASH,10) logs at 0.1 Hz on long mashes
+ * and still at every sample for LOGBURSTTIME after the temperature
+ * was out of MAXTEMPVAR (heat up, step change).
+ *
+ * \param channel : byte. LOGSERIAL (telemetry) or LOGFLASH.
+ * \param decimation : byte. A data point every decimation samples,
+ *                     default is 1.
+ * \param burstDecimation : byte (default=1). Same, after a transient.
+ */
+void Rims::setLogRate(byte channel, byte decimation, byte burstDecimation)
+{
+	if(channel >= LOGCHANNELS) return;
+	_logDecimations[channel] = (decimation > 0) ? decimation : 1;
+	_logBurstDecimations[channel] = (burstDecimation > 0) ? burstDecimation : 1;
+}
+
+/*!
+ * \brief Set the PID sample time, the LCD refresh period and the data
+ *        log period, SAMPLETIME by default. Used from the next
+ *        session (call it in setup()).
+ *
+ * PID gains keep their units ([mSec/celcius], per sec for Ki and sec
+ * for Kd) : a small tube can be controlled every 250 mSec, a large
+ * kettle every 2 sec, with the same tuning. A PID sample that runs
+ * late is computed with the time really elapsed (see
+ * PIDmod::Compute()). The thermistor is oversampled THERMOVERSAMPLES
+ * times per PID sample.
+ *
+ * \param pidTime : unsigned int. PID sample time [mSec], at least
+ *                  THERMOVERSAMPLES.
+ * \param displayTime : unsigned int. LCD values refresh period [mSec]
+ * \param logTime : unsigned int. Data point period, before the
+ *                  decimation of setLogRate() [mSec]. Each data point
+ *                  is the last PID sample.
+ */
+void Rims::setSampleTimes(unsigned int pidTime, unsigned int displayTime,
+                          unsigned int logTime)
+{
+	_pidSampleTime = (pidTime > THERMOVERSAMPLES) ? pidTime : THERMOVERSAMPLES;
+	_displayPeriod = (displayTime > 0) ? displayTime : SAMPLETIME;
+	_logPeriod = (logTime > 0) ? logTime : SAMPLETIME;
+}
+
 #ifdef WITH_W25QFLASH
 	/*!
 	 * \brief Set pin for flash memory chip select.
@@ -237,6 +638,7 @@ void Rims::setHeaterPowerDetect(char pinHeaterVolt)
 	{ 
 		_myMem.setCSPin(csPin); 
 		_memConnected = _myMem.verifyMem();
+		_memLogLoaded = false;
 	}
 	
 	/*!
@@ -268,11 +670,12 @@ void Rims::setHeaterPowerDetect(char pinHeaterVolt)
 				_ui->showMemAccessScreen();
 				do
 				{
-					Serial.println("MEMORY ACCESS MODE");
-					Serial.println("<1> dump brew session data");
-					Serial.println("<2> calculate free space");
-					Serial.println("<3> clear all memory");
-					Serial.println("<4> exit");
+					Serial.println(F("MEMORY ACCESS MODE"));
+					Serial.println(F("<1> dump brew session data"));
+					Serial.println(F("<2> calculate free space"));
+					Serial.println(F("<3> clear all memory"));
+					Serial.println(F("<4> exit"));
+					Serial.println(F("<5> binary dump brew session data"));
 					while(not Serial.available());
 					selectedMenu = Serial.parseInt();
 					Serial.read(); // flush remaining '\n'
@@ -289,7 +692,10 @@ void Rims::setHeaterPowerDetect(char pinHeaterVolt)
 						_memClearAll();
 						break;
 					case 4:
-						Serial.println("EXIT");
+						Serial.println(F("EXIT"));
+						break;
+					case 5:
+						_memDumpBinary();
 						break;
 					}
 					// flush remaining '\n' :
@@ -297,91 +703,185 @@ void Rims::setHeaterPowerDetect(char pinHeaterVolt)
 				}
 				while(selectedMenu != 4);
 			}
-			else Serial.println("MEM NOT FOUND!");
+			else Serial.println(F("MEM NOT FOUND!"));
 		}
 	}
 	
 	/*!
 	 * \brief Dump brew session data on USB serial port.
+	 * 
+	 * Session is read one page at a time in _memPage and decoded,
+	 * see _memAddBrewData(). Pages of an unknown format and pages not
+	 * committed are skipped.
 	 */
 	void Rims::_memDumpBrewData()
 	{
-		byte readBuffer[BYTESPERDATA];
-		unsigned int brewSession, brewSessionQty;
-		unsigned long startingAddr, nextStartingAddr, curAddr;
-		unsigned long sessionDataQty;
-		float time, sp, pv, flow, timerRemaining;
-		unsigned int cv;
-		Serial.println("DUMP");
-		Serial.print("Currently ");
+		unsigned int brewSession, brewSessionQty, page, offset, endOffset;
+		long values[MEMFIELDS], timeDelta;
+		int sp;
+		byte i, field, recordQty;
+		const byte *data, *dataEnd = _memPage + MEMPAGESIZE;
+		Serial.println(F("DUMP"));
+		Serial.print(F("Currently "));
 		brewSessionQty = _memCountSessions();
 		Serial.print(brewSessionQty);
-		Serial.println(" brew sessions. Which one, starting at 1 ?");
+		Serial.println(F(" brew sessions. Which one, starting at 1 ?"));
 		while(not Serial.available());
 		brewSession = Serial.parseInt();
 		Serial.write('>');Serial.println(brewSession);
 		if(brewSession >= 1 and brewSession <= brewSessionQty)
 		{
-			Serial.println(g_csvHeader);
-			_myMem.read(ADDRSESSIONTABLE + 4*(brewSession-1),
-						readBuffer,4);
-			memcpy(&startingAddr,readBuffer,4);
-			if(brewSession == brewSessionQty) // last session
+			Serial.println((const __FlashStringHelper*)g_csvHeader);
+			brewSession += _memFirstSession - 1;
+			endOffset = _memFindSession(brewSession + 1);
+			for(offset = _memFindSession(brewSession);
+				offset < endOffset;
+				offset++)
 			{
-				sessionDataQty = _memCountSessionData();
-				nextStartingAddr = startingAddr+ 4 + \
-				                   BYTESPERDATA*(sessionDataQty);
+				page = (_memOldestPage + offset) % MEMPAGEQTY;
+				_myMem.read((unsigned long)page*MEMPAGESIZE,
+				            _memPage,MEMPAGESIZE);
+				recordQty = _memPage[1];
+				if(_memPage[0] != MEMPAGEFORMAT or recordQty == 0xFF) continue;
+				sp = (int)_memGetLE(_memPage+2,2);
+				data = _memPage + MEMPAGEHEADER;
+				timeDelta = 0;
+				for(i=0;i<recordQty;i++)
+				{
+					for(field=0;field<MEMFIELDS;field++)
+					{
+						if(i == 0) // keyframe
+						{
+							values[field] = _memGetLE(data,
+											g_memKeyframeSizes[field]);
+							data += g_memKeyframeSizes[field];
+						}
+						else if(field == 0) // time
+						{
+							timeDelta += _memGetDelta(&data,dataEnd);
+							values[0] += timeDelta;
+						}
+						else values[field] += _memGetDelta(&data,dataEnd);
+					}
+					if(data > dataEnd) break; // corrupted page
+					Serial.print(values[0]/1000.0,3);	Serial.write(',');
+					Serial.print(sp/100.0,1);			Serial.write(',');
+					Serial.print(values[1]);			Serial.write(',');
+					Serial.print(values[2]/100.0,2);	Serial.write(',');
+					Serial.print(values[3]/100.0,2);	Serial.write(',');
+					Serial.println(values[4]);
+				}
 			}
-			else
+		}		
+	}
+	
+	/*!
+	 * \brief Dump brew session pages on USB serial port, in binary.
+	 * 
+	 * Pages are sent as stored (see _memAddBrewData()), about 5 bytes
+	 * per data point instead of about 33 in ASCII. Each page is a SLIP
+	 * frame : MEMFRAMEPAGE, page offset in the session (2 bytes), the
+	 * MEMPAGESIZE bytes of the page, then a CRC16 (CCITT, initial
+	 * value 0xFFFF) of the previous bytes. Pages not committed are not
+	 * sent. A MEMFRAMEEND frame with the page qty of the session ends
+	 * the dump. Values of several bytes are little endian.
+	 * 
+	 * A transfer can be resumed : the first page offset is asked
+	 * after the brew session. extras/host/memDump decodes the frames
+	 * to CSV.
+	 */
+	void Rims::_memDumpBinary()
+	{
+		unsigned int brewSession, brewSessionQty, page, offset, endOffset;
+		unsigned int startOffset, firstOffset, crc;
+		byte header[3];
+		Serial.println(F("BINARY DUMP"));
+		Serial.print(F("Currently "));
+		brewSessionQty = _memCountSessions();
+		Serial.print(brewSessionQty);
+		Serial.println(F(" brew sessions. Which one, starting at 1 ?"));
+		while(not Serial.available());
+		brewSession = Serial.parseInt();
+		Serial.write('>');Serial.println(brewSession);
+		Serial.println(F("First page, starting at 0 ?"));
+		while(not Serial.available());
+		firstOffset = Serial.parseInt();
+		Serial.write('>');Serial.println(firstOffset);
+		if(brewSession < 1 or brewSession > brewSessionQty) return;
+		brewSession += _memFirstSession - 1;
+		startOffset = _memFindSession(brewSession);
+		endOffset = _memFindSession(brewSession + 1);
+		for(offset = startOffset + firstOffset; offset < endOffset; offset++)
+		{
+			page = (_memOldestPage + offset) % MEMPAGEQTY;
+			_myMem.read((unsigned long)page*MEMPAGESIZE,
+			            _memPage,MEMPAGESIZE);
+			if(_memPage[0] != MEMPAGEFORMAT or _memPage[1] == 0xFF) continue;
+			header[0] = MEMFRAMEPAGE;
+			_memPutLE(header+1,offset-startOffset,2);
+			Serial.write(SLIPEND);
+			crc = _memSlipWrite(header,3,0xFFFF);
+			crc = _memSlipWrite(_memPage,MEMPAGESIZE,crc);
+			_memPutLE(header,crc,2);
+			_memSlipWrite(header,2,0);
+			Serial.write(SLIPEND);
+		}
+		header[0] = MEMFRAMEEND;
+		_memPutLE(header+1,endOffset-startOffset,2);
+		Serial.write(SLIPEND);
+		crc = _memSlipWrite(header,3,0xFFFF);
+		_memPutLE(header,crc,2);
+		_memSlipWrite(header,2,0);
+		Serial.write(SLIPEND);
+		Serial.println();
+	}
+	
+	/*!
+	 * \brief Send bytes inside a SLIP frame, SLIPEND and SLIPESC
+	 *        escaped.
+	 * \param data : const byte*. Bytes to send.
+	 * \param n : unsigned int. Number of bytes.
+	 * \param crc : unsigned int. CRC16 of the bytes already sent.
+	 * \return unsigned int : CRC16 updated with the bytes sent.
+	 */
+	unsigned int Rims::_memSlipWrite(const byte* data, unsigned int n,
+	                                 unsigned int crc)
+	{
+		unsigned int i;
+		for(i=0;i<n;i++)
+		{
+			crc = Telemetry::crc16(crc,data[i]);
+			if(data[i] == SLIPEND)
 			{
-				_myMem.read(ADDRSESSIONTABLE + 4*(brewSession),
-							readBuffer,4);
-				memcpy(&nextStartingAddr,readBuffer,4);
+				Serial.write(SLIPESC); Serial.write(SLIPESCEND);
 			}
-			_myMem.read(startingAddr,readBuffer,4);
-			memcpy(&sp,readBuffer,4); // set point at the beginning
-			for(curAddr = startingAddr + 4;
-				curAddr < nextStartingAddr;
-				curAddr += BYTESPERDATA)
+			else if(data[i] == SLIPESC)
 			{
-				_myMem.read(curAddr,readBuffer,BYTESPERDATA);
-				memcpy(&time,readBuffer,4);
-				memcpy(&cv,readBuffer+4,2);
-				memcpy(&pv,readBuffer+6,4);
-				memcpy(&flow,readBuffer+10,4);
-				memcpy(&timerRemaining,readBuffer+14,4);
-				Serial.print(time,3);	Serial.write(',');
-				Serial.print(sp,1);		Serial.write(',');
-				Serial.print(cv);		Serial.write(',');
-				Serial.print(pv,3);		Serial.write(',');
-				Serial.print(flow,2);	Serial.write(',');
-				Serial.println(timerRemaining,0);
+				Serial.write(SLIPESC); Serial.write(SLIPESCESC);
 			}
-		}		
+			else Serial.write(data[i]);
+		}
+		return crc;
 	}
 	
 	/*!
 	 * \brief Show free memory on flash mem via USB serial port.
+	 * 
+	 * Memory is never full : oldest sessions are overwritten, one
+	 * sector at a time.
 	 */
 	void Rims::_memFreeSpace()
 	{
-		byte readBuffer[4];
-		unsigned int brewSesQty = _memCountSessions();
-		unsigned long freeBytes, lastSessionAddr, freePoints;
-		Serial.println("FREE MEM");
-		if(brewSesQty)
-		{
-			_myMem.read(ADDRSESSIONTABLE+4*(brewSesQty-1),
-						readBuffer,4);
-			memcpy(&lastSessionAddr,readBuffer,4);
-		}
-		else lastSessionAddr = ADDRBREWDATA - 4;
-		freeBytes = MEMSIZEBYTES - \
-		   (lastSessionAddr + 4 + BYTESPERDATA*_memCountSessionData());
-		freePoints = freeBytes / BYTESPERDATA;
-		Serial.print("Currently ");
-		Serial.print(freeBytes); Serial.print(" free bytes or about ");
-		Serial.print(freePoints); Serial.println(" data points");
+		unsigned long freeBytes, freePoints;
+		_memCountSessions();
+		freeBytes = MEMSIZEBYTES - (unsigned long)MEMPAGESIZE * \
+		   ((_memNextPage + MEMPAGEQTY - _memOldestPage) % MEMPAGEQTY);
+		freePoints = (freeBytes / MEMPAGESIZE) * MEMDATAPERPAGE;
+		Serial.println(F("FREE MEM"));
+		Serial.print(F("Currently "));
+		Serial.print(freeBytes); Serial.print(F(" free bytes or about "));
+		Serial.print(freePoints); Serial.println(F(" data points"));
+		Serial.println(F("Then oldest sessions are overwritten"));
 	}
 	
 	/*!
@@ -390,183 +890,430 @@ void Rims::setHeaterPowerDetect(char pinHeaterVolt)
 	void Rims::_memClearAll()
 	{
 		char inputChar;
-		Serial.println("CLEAR");
-		Serial.println("Are you sure ? (y/n)");
+		Serial.println(F("CLEAR"));
+		Serial.println(F("Are you sure ? (y/n)"));
 		while(not Serial.available());
 		inputChar = Serial.read();
 		Serial.write('>');Serial.println(inputChar);
 		if(inputChar == 'Y' or inputChar == 'y')
 		{
-			Serial.println("Clearing all memory...");
+			Serial.println(F("Clearing all memory..."));
 			_myMem.erase(0x000000,W25Q_ERASE_CHIP);
 			_myMem.waitFree();
-			Serial.println("Finished!");
+			_memLogLoaded = false;
+			Serial.println(F("Finished!"));
 		}
 	}
 	
 	/*!
-	 * \brief Count how many brew sessions were saved in flash mem.
-	 * 
-	 * Max is 1024 brew sessions. When new brew session 
-	 * is started, the starting address of the datablock is saved in 
-	 * the brew sessions table, starting at ADDRSESSIONTABLE or 0x000000.
-	 * For exemple, if 2 brew session were done of 2 seconds each
-	 * (so 4+18+18=40 bytes each), the memory map of the brew 
-	 * sessions table would be :
-	 * 
-	 * Address  | Data       | Size 
-	 * -------- | -----------| -------
-	 * 0x000000 | 0x00001100 | 4 bytes
-	 * 0x000004 | 0x00001128 | 4 bytes      
-	 * 0x000008 | 0xFFFFFFFF | 4 bytes
-	 * 0x00000C | 0xFFFFFFFF | 4 bytes
-	 * ...      | ...        | ...
-	 * 0x000FFF | 0xFFFFFFFF | 4 bytes
+	 * \brief Count how many brew sessions are kept in flash mem.
+	 * 
+	 * Brew data is a circular log of pages over the whole memory.
+	 * There is no table : each page header holds a sequence number
+	 * and the number of its brew session (see _memAddBrewData()).
+	 * Sessions are numbered in order, so the count is the difference
+	 * between the sessions of the newest and of the oldest pages.
+	 * 
+	 * The log is located once by _memLoadLog(), then kept up to date
+	 * in RAM.
 	 * 
 	 */
 	unsigned int Rims::_memCountSessions()
 	{
-		bool nullAddrFound = false;
-		byte page, offset, readBuffer[256];
-		for(page=0;page<16;page++)  // 16 pages per sector
+		if(not _memLogLoaded) _memLoadLog();
+		return _memSessionQty;
+	}
+	
+	/*!
+	 * \brief Locate the circular log in flash mem.
+	 * 
+	 * Pages are programmed in order and the sector after the newest
+	 * page is always kept erased, so first pages of sectors have
+	 * increasing sequence numbers from the oldest sector to the
+	 * newest one, then are erased (or from an older format), then
+	 * increase again : the newest sector is found by binary search
+	 * on its first page, and the newest page in this sector by
+	 * binary search too. About 12 header reads instead of a
+	 * 256 sectors scan.
+	 */
+	void Rims::_memLoadLog()
+	{
+		unsigned long firstSeq, seq;
+		unsigned int low, high, middle, session, headSector, lastPage, page;
+		_memNextPage = _memOldestPage = 0;
+		_memNextSeq = 0;
+		_memSessionQty = 0;
+		_memLogLoaded = true;
+		// === NEWEST SECTOR ===
+		if(_memReadHeader(0,&firstSeq,&session))
 		{
-			_myMem.read(ADDRSESSIONTABLE+(256*page),readBuffer,256);
-			offset = 0;
-			do
+			low = 1; high = MEMSECTORQTY;
+			while(low < high) // last sector with seq >= firstSeq
 			{
-				if(readBuffer[offset] == 0xFF) 
-				{
-					nullAddrFound = true;
-					break;
-				}
-				offset++;
+				middle = (low + high)/2;
+				if(_memReadHeader(middle*MEMPAGESPERSECTOR,&seq,&session) \
+				   and seq >= firstSeq) low = middle + 1;
+				else high = middle;
+			}
+			headSector = low - 1;
+		}
+		else if(_memReadHeader((MEMSECTORQTY-1)*MEMPAGESPERSECTOR,
+		                       &seq,&session))
+		{
+			headSector = MEMSECTORQTY-1;
+		}
+		else return; // empty
+		// === NEWEST PAGE ===
+		low = 1; high = MEMPAGESPERSECTOR;
+		while(low < high) // last programmed page of head sector
+		{
+			middle = (low + high)/2;
+			if(_memReadHeader(headSector*MEMPAGESPERSECTOR+middle,
+			                  &seq,&session)) low = middle + 1;
+			else high = middle;
+		}
+		lastPage = headSector*MEMPAGESPERSECTOR + low - 1;
+		_memReadHeader(headSector*MEMPAGESPERSECTOR,&firstSeq,&session);
+		_memNextSeq = firstSeq + low;
+		_memNextPage = (lastPage + 1) % MEMPAGEQTY;
+		// === OLDEST PAGE ===
+		// sector after the newest one is erased, unless power was cut
+		// before it was.
+		for(byte i=1;i<=2;i++)
+		{
+			page = ((headSector + i) % MEMSECTORQTY)*MEMPAGESPERSECTOR;
+			if(_memReadHeader(page,&seq,&session))
+			{
+				_memOldestPage = page;
+				break;
 			}
-			while(offset > 0);
-			if(nullAddrFound) break;
 		}
-		return (page*64)+(offset/4);
+		_memSession = _memPageSession(lastPage);
+		_memFirstSession = _memPageSession(_memOldestPage);
+		_memSessionQty = _memSession - _memFirstSession + 1;
 	}
 	
 	/*!
-	 * \brief Count how many data point were taken.
-	 * 
-	 * When brew data is added in the memory, a sector is filled with "0"
-	 * to remember how many data were taken. This sector is at the address
-   * ADDRDATACOUNT or 0x001000 (second sector).
-	 * If 12 brew data were taken since de beginning (or 12 seconds were
-	 * ellapsed), the memory map would be like this :
-	 * 
-	 * Address  | Data           
-	 * -------- | -----------
-	 * 0x001000 | b00000000
-	 * 0x001001 | b11110000         
-	 * 0x001002 | b11111111
-	 * 0x001003 | b11111111
-	 * ...      | ...
-	 * 0x001FFF | b11111111
-	 * 
-	 * I used this method because of a limitation of the flash memory.
-	 * I could not use normal counting because freshly erased bits 
-	 * can be cleared (set to "0") but cannot be set to "1" without 
-	 * full sector erase.
+	 * \brief Read the header of a page of the log.
+	 * \param page : unsigned int. Page number, 0 to MEMPAGEQTY-1.
+	 * \param seq : unsigned long*. Page sequence number.
+	 * \param session : unsigned int*. Brew session of the page.
+	 * \return byte : 0 if not a log page (erased or other format),
+	 *                data points in the page, 0xFF if not committed.
+	 */
+	byte Rims::_memReadHeader(unsigned int page, unsigned long* seq,
+	                          unsigned int* session)
+	{
+		byte header[MEMPAGEHEADER];
+		_myMem.read((unsigned long)page*MEMPAGESIZE,header,MEMPAGEHEADER);
+		if(header[0] != MEMPAGEFORMAT) return 0;
+		*seq = (unsigned long)_memGetLE(header+4,4) & 0xFFFFFFFFUL;
+		*session = (unsigned int)_memGetLE(header+8,2) & 0xFFFF;
+		return header[1];
+	}
+	
+	/*!
+	 * \brief Brew session of a page of the log. A page not committed
+	 *        may be incomplete, the session of the page before it is
+	 *        returned then.
+	 */
+	unsigned int Rims::_memPageSession(unsigned int page)
+	{
+		unsigned long seq;
+		unsigned int session = 0;
+		while(_memReadHeader(page,&seq,&session) == 0xFF and \
+		      page != _memOldestPage)
+		{
+			page = (page + MEMPAGEQTY - 1) % MEMPAGEQTY;
+		}
+		return session;
+	}
+	
+	/*!
+	 * \brief Find the first page of a brew session by binary search.
+	 * \param session : unsigned int. Brew session number.
+	 * \return unsigned int : pages from the oldest page of the log,
+	 *                        pages in the log if not found.
+	 */
+	unsigned int Rims::_memFindSession(unsigned int session)
+	{
+		unsigned int low = 0, middle, page;
+		unsigned int high = (_memNextPage + MEMPAGEQTY - _memOldestPage) % \
+		                    MEMPAGEQTY;
+		session -= _memFirstSession; // sessions number can wrap
+		while(low < high)
+		{
+			middle = (low + high)/2;
+			page = (_memOldestPage + middle) % MEMPAGEQTY;
+			if((unsigned int)(_memPageSession(page) - _memFirstSession) \
+			   < session) low = middle + 1;
+			else high = middle;
+		}
+		return low;
+	}
+	
+	/*!
+	 * \brief Forget a sector of the log before it's erased. If the
+	 *        oldest page was in it, the oldest brew session loses its
+	 *        first pages (or all of them).
+	 * 
+	 * Reads the flash memory : call it before queuing the erase,
+	 * while the memory is still free.
 	 * 
+	 * \param sector : unsigned int. Sector number, 0 to MEMSECTORQTY-1.
 	 */
-	unsigned long Rims::_memCountSessionData()
+	void Rims::_memDropSector(unsigned int sector)
 	{
-		boolean freeBitFound = false;
-		byte i,page,offset,readBuffer[256];
-		for(page=0;page<16;page++) // 16 pages per sector
+		if(_memSessionQty > 0 and \
+		   _memOldestPage/MEMPAGESPERSECTOR == sector and \
+		   _memOldestPage != _memNextPage)
 		{
-			_myMem.read(ADDRDATACOUNT+(page*256),readBuffer,256);
-			do
-			{
-				if(readBuffer[offset] & 0xFF)
-				{
-					freeBitFound = true;
-					break;
-				}
-				offset++;
-			}
-			while(offset>0);
-			if(freeBitFound) break;
+			_memOldestPage = ((sector + 1) % MEMSECTORQTY) * \
+			                 MEMPAGESPERSECTOR;
+			_memFirstSession = _memPageSession(_memOldestPage);
+			_memSessionQty = _memSession - _memFirstSession + 1;
 		}
-		for(i=0;i<8;i++) if((readBuffer[offset]>>i) & 0x01) break;
-		return 8*((page*256)+offset)+i;
 	}
 	
 	/*!
 	 * \brief Initialize flash memory
 	 * 
-	 * Verify where to store the new datas and saved temperature
-	 * setpoint at the beginning of the datablock.
+	 * Start a new brew session after the newest page of the log and
+	 * keep the temperature setpoint for the header of each page.
+	 * When the session starts a sector, it's erased (normally it was
+	 * already, see _memCommitPage()).
 	 * 
-	 * \param sp : float. Temperature setpoint stored at the beginning
-	 *                    of the datablock.
+	 * \param sp : float. Temperature setpoint stored in the header
+	 *                    of each page.
 	 * 
 	 */
 	void Rims::_memInit(float sp)
 	{
-		unsigned int brewSesQty = _memCountSessions();
-		unsigned long lastSesDataQty = _memCountSessionData();
-		byte buffer[4];
-		unsigned long lastStartingAddr;
-		if(brewSesQty == 0) _memNextAddr = ADDRBREWDATA;
-		else
+		if(_memCountSessions() == 0)
+		{
+			_memSession = _memFirstSession = 0;
+			_memOldestPage = _memNextPage;
+		}
+		else _memSession++;
+		_memSessionQty = _memSession - _memFirstSession + 1;
+		if(_memNextPage % MEMPAGESPERSECTOR == 0)
 		{
-			_myMem.read(ADDRSESSIONTABLE+(4*(brewSesQty-1)),buffer,4);
-			memcpy(&lastStartingAddr,buffer,4);
-			_memNextAddr = lastStartingAddr+\
-			               (BYTESPERDATA*lastSesDataQty) + 4;
+			_memDropSector(_memNextPage/MEMPAGESPERSECTOR);
+			_myMem.queueErase((unsigned long)_memNextPage*MEMPAGESIZE);
 		}
-		memcpy(buffer,&_memNextAddr,4);
-		_myMem.program(ADDRSESSIONTABLE+((brewSesQty*4)%1024),buffer,4);
-		_myMem.erase(ADDRDATACOUNT,W25Q_ERASE_SECTOR);
-		_memDataQty = 0;
-		memcpy(buffer,&sp,4);
-		_myMem.program(_memNextAddr,buffer,4);
-		_memNextAddr += 4;
+		_memSetPoint = (int)floor(sp*100.0 + 0.5);
+		_memPageData = 0;
+		_memPageLen = MEMPAGEHEADER;
 	}
 	
 	/*!
-	 * \brief Add data point to the flash memory.
-	 * 
-	 * Five values is added at _memNextAddr, 18 bytes in total.
-	 * Temperature setpoint (float : 4 bytes) is saved only
-	 * once, at the beginning of the brew sessions in _memInit().
-	 * For exemple, for the first data (starting at ADDRBREWDATA
-	 * or 0x001100) of the first brew session, the memory map would be :
-	 * 
-	 * Address  | Data           | Size
-	 * -------- | -------------- | -----
-	 * 0x001100 | sp             | 4 bytes 
-	 * 0x001104 | time           | 4 bytes
-	 * 0x091108 | cv             | 2 bytes
-	 * 0x09110A | pv             | 4 bytes
-	 * 0x09110E | flow           | 4 bytes
-	 * 0x091102 | timerRemaining | 4 bytes
-	 * 
-	 * \param time : float. time in sec of data point
+	 * \brief Add data point to the page buffer.
+	 * 
+	 * Nothing is sent to the flash memory until the page is full, see
+	 * _memCommitPage(). Values are integers and each page can be
+	 * decoded alone. The first data point of a page is a keyframe
+	 * stored in full, the next ones only store the difference with
+	 * the previous point (difference of time step for time) as
+	 * zigzag varints : 5 to 7 bytes per point instead of 18 with
+	 * floats. For exemple, the first page of a fresh memory would be :
+	 * 
+	 * Address  | Data                         | Size
+	 * -------- | ---------------------------- | -----
+	 * 0x000000 | MEMPAGEFORMAT                | 1 byte
+	 * 0x000001 | data point qty               | 1 byte
+	 * 0x000002 | sp [celcius/100]             | 2 bytes
+	 * 0x000004 | page sequence number         | 4 bytes
+	 * 0x000008 | brew session number          | 2 bytes
+	 * 0x00000A | time [mSec]                  | 4 bytes
+	 * 0x00000E | cv                           | 2 bytes
+	 * 0x000010 | pv [celcius/100]             | 2 bytes
+	 * 0x000012 | flow [L/min/100]             | 2 bytes
+	 * 0x000014 | timerRemaining [sec]         | 4 bytes
+	 * 0x000018 | time step delta, cv delta... | 1-5 bytes each
+	 * ...      | ...                          | ...
+	 * 
+	 * Fields are little endian, signed. A varint stores 7 bits per
+	 * byte, MSB set when another byte follows.
+	 * 
+	 * The page buffer is programmed from the flash queue, see
+	 * _memCommitPage(). While it's queued, the point starting the
+	 * next page is held in _memLastValues and written as the keyframe
+	 * with the next point (replaced by it if the memory is still busy).
+	 * 
+	 * \param time : unsigned long. time of data point [mSec]
 	 * \param cv : unsigned int. SSR control value (mSec at ON state)
-	 * \param pv : float. temperature in deg Celcius
+	 * \param pv : long. temperature [celcius/100]
 	 * \param flow : float. flow in L/min
-	 * \param timerRemaining : float. remaining time on timer
+	 * \param timerRemaining : unsigned long. remaining time on timer
 	 *                         in seconds.
 	 */
-	void Rims::_memAddBrewData(float time, unsigned int cv,
-							   float pv, float flow,
-							   float timerRemaining)
-	{
-		byte writeBuffer[BYTESPERDATA], dataCountMkr;
-		memcpy(writeBuffer,&time,4);
-		memcpy(writeBuffer+4,&cv,2);
-		memcpy(writeBuffer+6,&pv,4);
-		memcpy(writeBuffer+10,&flow,4);
-		memcpy(writeBuffer+14,&timerRemaining,4);
-		_myMem.program(_memNextAddr,writeBuffer,BYTESPERDATA);
-		dataCountMkr = 0xFF << ((_memDataQty % 8)+1);
-		_myMem.program(ADDRDATACOUNT+_memDataQty/8,&dataCountMkr,1);
-		_memDataQty ++;
-		_memNextAddr += BYTESPERDATA;
+	void Rims::_memAddBrewData(unsigned long time, unsigned int cv,
+							   long pv, float flow,
+							   unsigned long timerRemaining)
+	{
+		long values[MEMFIELDS] = {(long)time, (long)cv, pv,
+		                          (long)floor(flow*100.0 + 0.5),
+		                          (long)timerRemaining};
+		byte delta[MEMMAXDELTASIZE], *deltaEnd = delta, field;
+		long timeDelta = values[0] - _memLastValues[0];
+		if(_memPageLen == 0 and not _myMem.queued(_memPage))
+		{
+			_memPutKeyframe(_memLastValues); // held point
+		}
+		if(_memPageData > 0)
+		{
+			deltaEnd = _memPutDelta(deltaEnd,timeDelta - _memLastTimeDelta);
+			for(field=1;field<MEMFIELDS;field++)
+			{
+				deltaEnd = _memPutDelta(deltaEnd,
+				                        values[field] - _memLastValues[field]);
+			}
+			if(_memPageLen + (deltaEnd-delta) > MEMPAGESIZE) _memCommitPage();
+		}
+		if(_memPageData == 0) // keyframe
+		{
+			if(_myMem.queued(_memPage)) _memPageLen = 0; // held
+			else _memPutKeyframe(values);
+			timeDelta = 0;
+		}
+		else
+		{
+			memcpy(_memPage+_memPageLen,delta,deltaEnd-delta);
+			_memPageLen += deltaEnd-delta;
+			_memPageData++;
+		}
+		memcpy(_memLastValues,values,sizeof(values));
+		_memLastTimeDelta = timeDelta;
+	}
+	
+	/*!
+	 * \brief Start the page buffer with a keyframe.
+	 * 
+	 * Bytes after the data points stay at 0xFF, see _memAddBrewData().
+	 * 
+	 * \param values : const long[MEMFIELDS]. time, cv, pv, flow and
+	 *                 timerRemaining of the data point.
+	 */
+	void Rims::_memPutKeyframe(const long values[])
+	{
+		memset(_memPage,0xFF,MEMPAGESIZE);
+		_memPage[0] = MEMPAGEFORMAT;
+		_memPutLE(_memPage+2,_memSetPoint,2);
+		_memPageLen = MEMPAGEHEADER;
+		for(byte field=0;field<MEMFIELDS;field++)
+		{
+			_memPutLE(_memPage+_memPageLen,values[field],
+			          g_memKeyframeSizes[field]);
+			_memPageLen += g_memKeyframeSizes[field];
+		}
+		_memPageData = 1;
+	}
+	
+	/*!
+	 * \brief Queue the page buffer, then its commit marker.
+	 * 
+	 * Two program instructions per page instead of two per data
+	 * point. The data point qty is programmed last, a page that stays
+	 * at 0xFF (power cut) is skipped. Also called at the end of a
+	 * session to save a partial page.
+	 * 
+	 * When a sector is started, the next one is erased : it's the
+	 * oldest one when the memory is full. Every sector is erased once
+	 * per turn of the log, including the pages holding the log state.
+	 * 
+	 * Never waits for the flash memory : the page, the commit marker
+	 * and the erase are queued and sent one step at a time by
+	 * _iterate() while brewing goes on. The page buffer is not copied,
+	 * it stays unchanged until it's sent (see _memAddBrewData()).
+	 */
+	void Rims::_memCommitPage()
+	{
+		unsigned long addr = (unsigned long)_memNextPage*MEMPAGESIZE;
+		unsigned int nextSector = (_memNextPage/MEMPAGESPERSECTOR + 1) % \
+		                          MEMSECTORQTY;
+		boolean sectorStart = (_memNextPage % MEMPAGESPERSECTOR == 0);
+		if(_memPageLen == 0 and not _myMem.queued(_memPage))
+		{
+			_memPutKeyframe(_memLastValues); // held point
+		}
+		if(_memPageData == 0) return;
+		if(sectorStart) _memDropSector(nextSector);
+		_memPutLE(_memPage+4,_memNextSeq,4);
+		_memPutLE(_memPage+8,_memSession,2);
+		_myMem.queueProgram(addr,_memPage,MEMPAGESIZE);
+		_myMem.queueProgram(addr+1,&_memPageData,1);
+		if(sectorStart)
+		{
+			_myMem.queueErase((unsigned long)nextSector*MEMSECTORSIZE);
+		}
+		_memNextPage = (_memNextPage + 1) % MEMPAGEQTY;
+		_memNextSeq++;
+		_memPageData = 0;
+	}
+	
+	/*!
+	 * \brief Write a signed value as a zigzag varint.
+	 * \param dst : byte*. Where to write, up to 5 bytes.
+	 * \param value : long. Value between -2^31 and 2^31-1.
+	 * \return byte* : after the last byte written.
+	 */
+	byte* Rims::_memPutDelta(byte* dst, long value)
+	{
+		unsigned long zigzag = ((unsigned long)value << 1) ^ \
+		                       (value < 0 ? ~0UL : 0UL);
+		zigzag &= 0xFFFFFFFFUL;
+		while(zigzag >= 0x80)
+		{
+			*dst++ = (byte)(zigzag | 0x80);
+			zigzag >>= 7;
+		}
+		*dst++ = (byte)zigzag;
+		return dst;
+	}
+	
+	/*!
+	 * \brief Read a zigzag varint written by _memPutDelta().
+	 * \param src : const byte**. Where to read, moved after the varint.
+	 * \param end : const byte*. End of the page, not read.
+	 * \return long : value read, 0 if truncated (*src is then > end).
+	 */
+	long Rims::_memGetDelta(const byte** src, const byte* end)
+	{
+		unsigned long zigzag = 0;
+		byte shift = 0, data;
+		do
+		{
+			if(*src >= end or shift > 28)
+			{
+				*src = end + 1;
+				return 0;
+			}
+			data = *(*src)++;
+			zigzag |= (unsigned long)(data & 0x7F) << shift;
+			shift += 7;
+		}
+		while(data & 0x80);
+		zigzag &= 0xFFFFFFFFUL;
+		return (zigzag & 1) ? -(long)(zigzag >> 1) - 1 : (long)(zigzag >> 1);
+	}
+	
+	/*!
+	 * \brief Write the size lowest bytes of value, little endian.
+	 */
+	void Rims::_memPutLE(byte* dst, long value, byte size)
+	{
+		for(byte i=0;i<size;i++) dst[i] = (byte)(value >> (8*i));
+	}
+	
+	/*!
+	 * \brief Read a signed little endian value of size bytes.
+	 */
+	long Rims::_memGetLE(const byte* src, byte size)
+	{
+		unsigned long value = 0;
+		for(byte i=0;i<size;i++) value |= (unsigned long)src[i] << (8*i);
+		if(size < 4 and (src[size-1] & 0x80)) value |= ~0UL << (8*size);
+		return (long)(int32_t)value;
 	}
 #endif
 
@@ -576,10 +1323,32 @@ void Rims::setHeaterPowerDetect(char pinHeaterVolt)
  * Should be called in the loop() function of your sketchbook
  * First time : _initialize() is called
  * Remaining time : _iterate() is called
+ *
+ * Thermistor and keypad pins are converted in background by AdcScan
+ * during regulation, so _iterate() never waits for the ADC. Blocking
+ * dialogs of _initialize() use analogRead() as before. The SSR is
+ * switched by the SsrTimer interrupt during regulation, on a channel of
+ * this instance (loop refresh if SsrTimer refuses it).
  */
 void Rims::run()
 {
-	if(not _rimsInitialized) _initialize();
+	if(not _rimsInitialized)
+	{
+#ifdef WITH_W25QFLASH
+		if(_memConnected)
+		{
+			_memCommitPage(); // end of last session
+			_myMem.flush();   // on chip before the set point dialogs
+		}
+#endif
+		AdcScan::stop();
+		SsrTimer::detach(_ssrChannel);
+		_ssrChannel = -1;
+		_initialize();
+		AdcScan::start();
+		_ssrChannel = SsrTimer::attach(_pinCV,_pinLED,SSRWINDOWSIZE,
+		                  (_ssrModulation == SSRSIGMADELTA) ? _mainsFreq : 0);
+	}
 	else _iterate();
 }
 
@@ -589,7 +1358,7 @@ void Rims::run()
  * Initialization procedure :
  * -# Ask Temperature set point
  * -# Ask Timer time
- * -# Ask Mash water qty (if setted)
+ * -# Ask Mash water qty (if setted, exact volume with a gain table)
  * -# Show pump switching warning
  * -# Show heater switching warning
  */
@@ -601,8 +1370,15 @@ void Rims::_initialize()
 	// === ASK TIMER ===
 	_settedTime = (unsigned long)_ui->askTime(_settedTime/1000)*1000;
 	// === ASK MASH WATER ===
-	if(_pidQty != 1) _currentPID = _ui->askMashWater(_mashWaterValues,
-													 _currentPID);
+	if(_tuningTablePGM != NULL)
+	{
+		if(_gainScheduling == GAINSCHEDVOLUME)
+		{
+			_mashWater = _ui->askMashVolume(_mashWater);
+		}
+	}
+	else if(_pidQty != 1) _currentPID = _ui->askMashWater(_mashWaterValues,
+														  _currentPID);
 	// === PUMP SWITCHING WARN ===
 	_ui->showPumpWarning(this->getFlow());
 	_currentTime = millis();
@@ -615,6 +1391,7 @@ void Rims::_initialize()
 			_ui->setFlow(this->getFlow(),false);
 			lastFlowRefresh = _currentTime;
 		}
+		_ui->refreshLCD();
 	}
 	// === HEATER SWITCHING WARN ===
 	_ui->showHeaterWarning(this->getHeaterVoltage());
@@ -624,13 +1401,18 @@ void Rims::_initialize()
 		{
 			_ui->setHeaterVoltState(this->getHeaterVoltage(),false);
 		}
+		_ui->refreshLCD();
 	}
 #ifdef WITH_W25QFLASH
 	// === MEM INIT ===
 	if(_memConnected) _memInit(*_setPointPtr);
 #endif
-	Serial.println(g_csvHeader);
+	_telemetry.printHeader();
+	_telemetry.reset();
+	_logTicks = 0;
+	_logTransientTime = millis();
 	_ui->showTempScreen();
+	_resetThermSamples();
 	*(_processValPtr) = this->getTempPV();
 	_ui->setTempSP(*(_setPointPtr));
 	_ui->setTempPV(*(_processValPtr));
@@ -638,63 +1420,209 @@ void Rims::_initialize()
 	_runningTime = _totalStoppedTime = _timerStopTime = 0;
 	_buzzerState = false;
 	stopHeating(true);
-	_myPID.SetTunings(_kps[_currentPID],_kis[_currentPID],_kds[_currentPID]);
-	_myPID.SetDerivativeFilter(_tauFilter[_currentPID]);
+	_useFixedPID = (_tuningTablePGM != NULL) ? _tableFixedPID : \
+	                                           _fixedPIDs[_currentPID];
+	_setPointFix = (long)floor(100*(*_setPointPtr)+0.5);
+	_myPID.SetSampleTime(_pidSampleTime);
+	_myPIDFix.SetSampleTime(_pidSampleTime);
+	if(_tuningTablePGM != NULL)
+	{
+		switch(_gainScheduling)
+		{
+			case GAINSCHEDFLOW :
+				_scheduleGains(this->getFlow(),false);
+				break;
+			case GAINSCHEDTEMP :
+				_scheduleGains(*(_processValPtr),false);
+				break;
+			default :
+				_scheduleGains(_mashWater,false);
+				break;
+		}
+	}
+	else
+	{
+		_myPID.SetTunings(_kps[_currentPID],_kis[_currentPID],
+						  _kds[_currentPID]);
+		_myPID.SetDerivativeFilter(_tauFilter[_currentPID]);
+		_myPIDFix.SetTunings(_kps[_currentPID],_kis[_currentPID],
+							 _kds[_currentPID]);
+		_myPIDFix.SetDerivativeFilter(_tauFilter[_currentPID]);
+	}
 	*(_controlValPtr) = 0;
+	_controlValFix = 0;
 	stopHeating(false);
 	_rimsInitialized = true;
 	_currentTime = _windowStartTime = _timerStartTime = _rimsStartTime \
-				 = _lastScreenSwitchTime = millis();
-	_lastTimePID = _currentTime - SAMPLETIME;
+				 = _lastTimePID = _lastScreenSwitchTime = millis();
+	// === TASKS ===
+	_clearTasks();
+	_addTask(&Rims::_refreshSSR,TASKSSR,0,0);
+	_addTask(&Rims::_taskTimer,TASKTIMER,0,0);
+	_addTask(&Rims::_taskTelemetry,TASKTELEMETRY,0,0);
+#ifdef WITH_W25QFLASH
+	_addTask(&Rims::_taskMem,TASKMEM,0,0);
+#endif
+	_addTask(&Rims::_taskLCD,TASKLCD,0,0);
+	_addTask(&Rims::_sampleTherm,TASKTHERM,_pidSampleTime/THERMOVERSAMPLES,0);
+	_addTask(&Rims::_taskPID,TASKPID,_pidSampleTime,0);
+	_addTask(&Rims::_refreshDisplay,TASKDISPLAY,_displayPeriod,0);
+	_addTask(&Rims::_taskLog,TASKLOG,_logPeriod,0);
+	_addTask(&Rims::_taskKeys,TASKKEYS,KEYSPERIOD,0);
 }
 
 /*!
- * \brief Main method called for temperature regulation at each iteration
- * 
- * At each PID calculation (at each SAMPLETIME sec), datas is
- * sent over Serial communication for logging purpose.
+ * \brief One pass of the cooperative scheduler, called by run().
  *
+ * Time is read once for the whole pass (_currentTime). Tasks with a
+ * period of 0 run at each pass, in the order they were added. Then,
+ * among the periodic tasks that are due, only the one with the lowest
+ * priority runs, so a pass never stacks them : the others run at the
+ * next passes. A task that starts a whole period late has
+ * skipped a run, which is counted WITH_PROFILER (see getTaskMisses()).
  */
 void Rims::_iterate()
 {
+	byte i, next = TASKMAXQTY, priority, nextPriority = 255;
+#ifdef WITH_PROFILER
+	unsigned long passStart = micros();
+#endif
 	_currentTime = millis();
-	if(_currentTime-_lastTimePID>=SAMPLETIME)
-	{
-		// === READ TEMPERATURE/FLOW ===
-		*(_processValPtr) = getTempPV();
-		_flow = this->getFlow();
-		// === CRITCAL STATES ===
-		stopHeating((_stopOnCriticalFlow and _criticalFlow) \
-		            or _ncTherm or _noPower);
-		// === REFRESH PID ===
-		_myPID.Compute();
-		// === REFRESH DISPLAY ===
-		_refreshDisplay();
-		// === DATA LOG ===
-#ifdef WITH_W25QFLASH
-		if(_memConnected)
+	for(i=0;i<_taskQty;i++)
+	{
+		if(_taskPeriods[i] == 0) PROFILE(i,(this->*_taskFns[i])())
+	}
+	for(i=0;i<_taskQty;i++)
+	{
+		if(_taskPeriods[i] == 0 or \
+		   (long)(_currentTime - _taskNextTimes[i]) < 0) continue;
+		priority = pgm_read_byte(&g_taskPriorities[_taskIds[i]]);
+		if(next == TASKMAXQTY or priority < nextPriority)
 		{
-			_memAddBrewData((_currentTime-_rimsStartTime)/1000.0,
-							*(_controlValPtr),
-							*(_processValPtr),
-							_flow,
-							(_settedTime-_runningTime)/1000.0);
+			next = i;
+			nextPriority = priority;
+		}
+	}
+	if(next != TASKMAXQTY)
+	{
+#ifdef WITH_PROFILER
+		if(_currentTime - _taskNextTimes[next] > _taskMaxLates[next])
+		{
+			_taskMaxLates[next] = _currentTime - _taskNextTimes[next];
 		}
 #endif
-		Serial.print(
-	    (double)(_currentTime-_rimsStartTime)/1000.0,3);	Serial.write(',');
-		Serial.print(*(_setPointPtr),1);					Serial.write(',');
-		Serial.print(*(_controlValPtr),0);					Serial.write(',');
-		Serial.print(*(_processValPtr),3);					Serial.write(',');
-		Serial.print(_flow,2);								Serial.write(',');
-		Serial.println((_settedTime-_runningTime)/1000.0,0);
-		_lastTimePID += SAMPLETIME;
-	}
-	// === SSR CONTROL ===
-	_refreshSSR();
-	// === TIME REMAINING ===
-	_refreshTimer();
-	// === KEY CHECK ===
+		_taskNextTimes[next] += _taskPeriods[next];
+		while((long)(_currentTime - _taskNextTimes[next]) >= 0)
+		{
+			_taskNextTimes[next] += _taskPeriods[next];
+#ifdef WITH_PROFILER
+			_taskMisses[next]++;
+#endif
+		}
+		PROFILE(next,(this->*_taskFns[next])())
+	}
+#ifdef WITH_PROFILER
+	_profiler.add(PROFILERPASS,micros()-passStart);
+#endif
+}
+
+/*!
+ * \brief Remove every task of the scheduler. WITH_PROFILER, the
+ *        statistics are cleared and the profiler serial command task
+ *        is added back, at the lowest priority.
+ */
+void Rims::_clearTasks()
+{
+	_taskQty = 0;
+#ifdef WITH_PROFILER
+	for(byte i=0;i<TASKMAXQTY;i++) _profiler.setName(i,NULL);
+	_profiler.reset();
+	_addTask(&Rims::_taskProfiler,TASKPROFILER,PROFILERPERIOD,0);
+#endif
+}
+
+/*!
+ * \brief Add a task to the cooperative scheduler (see _iterate()).
+ *
+ * Up to TASKMAXQTY tasks, added by _initialize() : a class derived
+ * from Rims adds its own tasks there.
+ *
+ * \param task : RimsTask. Method called, e.g. &Rims::_taskPID.
+ * \param id : byte. TASKPID..., name and priority (lower runs first,
+ *             only for periodic tasks) are read from g_taskNames and
+ *             g_taskPriorities.
+ * \param period : unsigned long. 0 runs the task at each pass [mSec]
+ * \param phase : unsigned long. First run, from now [mSec]
+ */
+void Rims::_addTask(RimsTask task, byte id, unsigned long period,
+					unsigned long phase)
+{
+	if(_taskQty == TASKMAXQTY) return;
+	_taskFns[_taskQty] = task;
+	_taskIds[_taskQty] = id;
+	_taskPeriods[_taskQty] = period;
+	_taskNextTimes[_taskQty] = millis() + phase;
+#ifdef WITH_PROFILER
+	_taskMisses[_taskQty] = 0;
+	_taskMaxLates[_taskQty] = 0;
+	_profiler.setName(_taskQty,getTaskName(_taskQty));
+#endif
+	_taskQty++;
+}
+
+/*!
+ * \brief Task : read temperature and flow, schedule the gains (see
+ *        setTuningTable()), then compute the PID with the time elapsed
+ *        since the last sample.
+ */
+void Rims::_taskPID()
+{
+	// first sample of the session : nominal sample time
+	unsigned long timeChange = (_lastTimePID == _rimsStartTime) ? 0 : \
+	                           _currentTime - _lastTimePID;
+	PROFILE(PROFILERTEMP,*(_processValPtr) = getTempPV())
+	_flow = this->getFlow();
+	// === CRITCAL STATES ===
+	stopHeating((_stopOnCriticalFlow and _criticalFlow) \
+				or _ncTherm or _noPower);
+	// === GAIN SCHEDULING ===
+	if(_tuningTablePGM != NULL and _gainScheduling != GAINSCHEDVOLUME)
+	{
+		float key = (_gainScheduling == GAINSCHEDFLOW) ? _flow : \
+		                                                 *(_processValPtr);
+		if(abs(key - _gainKey) >= GAINSCHEDDEADBAND) _scheduleGains(key,true);
+	}
+	// === REFRESH PID ===
+	if(_useFixedPID)
+	{
+		PROFILE(PROFILERCOMPUTE,
+				if(_myPIDFix.Compute(timeChange))
+				{
+					*(_controlValPtr) = _controlValFix;
+				})
+	}
+	else PROFILE(PROFILERCOMPUTE,_myPID.Compute(timeChange))
+	_lastTimePID = _currentTime;
+}
+
+/*!
+ * \brief Task : data point of the last PID sample.
+ */
+void Rims::_taskLog()
+{
+	if(abs(*(_setPointPtr)-*(_processValPtr)) > MAXTEMPVAR)
+	{
+		_logTransientTime = _currentTime;
+	}
+	_logDataPoint(_lastTimePID-_rimsStartTime);
+}
+
+/*!
+ * \brief Task : screen switching, end of session once the timer
+ *        is elapsed.
+ */
+void Rims::_taskKeys()
+{
 	int keyPressed = _ui->readKeysADC();
 	if((keyPressed!=KEYNONE and _currentTime-_lastScreenSwitchTime>=500)\
 	    or _currentTime-_lastScreenSwitchTime >= SCREENSWITCHTIME)
@@ -712,6 +1640,105 @@ void Rims::_iterate()
 	}
 }
 
+/*!
+ * \brief Task : time remaining.
+ */
+void Rims::_taskTimer()
+{
+	_refreshTimer();
+}
+
+/*!
+ * \brief Task : send telemetry bytes without waiting.
+ */
+void Rims::_taskTelemetry()
+{
+	_telemetry.drain();
+}
+
+/*!
+ * \brief Task : send changed LCD cells.
+ */
+void Rims::_taskLCD()
+{
+	_ui->refreshLCD();
+}
+
+#ifdef WITH_W25QFLASH
+/*!
+ * \brief Task : one step of the flash instruction queue.
+ */
+void Rims::_taskMem()
+{
+	if(_memConnected) _myMem.poll();
+}
+#endif
+
+#ifdef WITH_PROFILER
+/*!
+ * \brief Task : serial commands of the profiler, 'p' prints and 'r'
+ *        resets the statistics.
+ */
+void Rims::_taskProfiler()
+{
+	if(not Serial.available()) return;
+	switch(Serial.read())
+	{
+		case 'p' :
+			printProfile();
+			break;
+		case 'r' :
+			resetProfile();
+			break;
+	}
+}
+#endif
+
+/*!
+ * \brief Send the current data point to the telemetry and to the
+ *        flash memory, each at its own rate (see setLogRate()).
+ *        Called at each sample. Both channels get the same values.
+ * \param time : unsigned long. Time of the data point [mSec]
+ */
+void Rims::_logDataPoint(unsigned long time)
+{
+	long values[TELEMETRYFIELDQTY];
+	boolean burst = (_currentTime - _logTransientTime < LOGBURSTTIME);
+	byte decimation = burst ? _logBurstDecimations[LOGSERIAL] \
+	                        : _logDecimations[LOGSERIAL];
+	values[0] = time;
+	values[1] = (long)floor(*(_setPointPtr)*100.0 + 0.5);
+	values[2] = (long)floor(*(_controlValPtr) + 0.5);
+	values[3] = _processValFix;
+	values[4] = (long)floor(_flow*100.0 + 0.5);
+	values[5] = (_settedTime-_runningTime + 500)/1000;
+	if(_logTicks % decimation == 0)
+	{
+		if(_useFixedPID)
+		{
+			values[6] = _myPIDFix.GetPTerm();
+			values[7] = _myPIDFix.GetITerm();
+			values[8] = _myPIDFix.GetDTerm();
+		}
+		else
+		{
+			values[6] = (long)floor(_myPID.GetPTerm() + 0.5);
+			values[7] = (long)floor(_myPID.GetITerm() + 0.5);
+			values[8] = (long)floor(_myPID.GetDTerm() + 0.5);
+		}
+		PROFILE(PROFILERPUSH,_telemetry.push(values))
+	}
+#ifdef WITH_W25QFLASH
+	decimation = burst ? _logBurstDecimations[LOGFLASH] \
+	                   : _logDecimations[LOGFLASH];
+	if(_memConnected and _logTicks % decimation == 0)
+	{
+		_memAddBrewData(values[0],values[2],values[3],_flow,values[5]);
+	}
+#endif
+	_logTicks++;
+}
+
 /*!
  * \brief Refresh timer value.
  *
@@ -722,7 +1749,6 @@ void Rims::_iterate()
  */
 void Rims::_refreshTimer(boolean verifyTemp)
 {
-	_currentTime = millis();
 	if(not _timerElapsed)
 	{
 		if(abs(*(_setPointPtr)-*(_processValPtr)) <= MAXTEMPVAR or not verifyTemp)
@@ -771,10 +1797,50 @@ void Rims::_refreshDisplay()
 /*!
  * \brief Refresh solid state relay
  * SSR will be refreshed in function of _controlValPtr value. 
+ *
+ * When this instance has an SsrTimer channel, _controlValPtr is only
+ * published to its interrupt, which switches the SSR on time whatever
+ * the loop does.
  */
 void Rims::_refreshSSR()
 {
-	_currentTime = millis();
+	if(_ssrChannel >= 0)
+	{
+		SsrTimer::setDuty(_ssrChannel,(unsigned int)(*(_controlValPtr)+0.5));
+	}
+	else
+	{
+		_refreshSSRWindow();
+	}
+	_noPower = !this->getHeaterVoltage();
+}
+
+/*!
+ * \brief Time proportioning of the SSR from the loop, without
+ *        SsrTimer : the on-time is late by up to one loop pass.
+ *        With SSRSIGMADELTA, a mains cycle is decided at each pass
+ *        that starts a new one (1000/_mainsFreq mSec).
+ */
+void Rims::_refreshSSRWindow()
+{
+	if(_ssrModulation == SSRSIGMADELTA)
+	{
+		unsigned long cycle = 1000 / _mainsFreq;
+		if(*(_controlValPtr) <= 0) // stopHeating() : off right away
+		{
+			digitalWrite(_pinCV,LOW);
+			digitalWrite(_pinLED,LOW);
+		}
+		if(_currentTime - _windowStartTime < cycle) return;
+		_windowStartTime += (_currentTime - _windowStartTime) / cycle * cycle;
+		_ssrAccumulator += (*(_controlValPtr) < SSRWINDOWSIZE) ? \
+		                   (unsigned int)(*(_controlValPtr)+0.5) : SSRWINDOWSIZE;
+		boolean on = (_ssrAccumulator >= SSRWINDOWSIZE);
+		if(on) _ssrAccumulator -= SSRWINDOWSIZE;
+		digitalWrite(_pinCV,on);
+		digitalWrite(_pinLED,on);
+		return;
+	}
 	if(_currentTime - _windowStartTime > SSRWINDOWSIZE)
 	{
 		_windowStartTime += SSRWINDOWSIZE;
@@ -789,49 +1855,203 @@ void Rims::_refreshSSR()
 		digitalWrite(_pinCV,LOW);
 		digitalWrite(_pinLED,LOW);
 	}
-	_noPower = !this->getHeaterVoltage();
 }
 
 /*!
  * \brief Get temperature from thermistor
  *
- * Steinhart-hart equation will be applied here. If voltage is maximal
- * (i.e. ~=5V) it means that the thermistor is not connected and 
- * regulation and heating is stopped until reconnection.
+ * Temperature is the mean of the last THERMOVERSAMPLES ADC readings
+ * taken by _sampleTherm() between two PID samples, read with its
+ * THERMADCFRACBITS fractional bits in the thermistor table (see
+ * setThermistor()). Averaging divides the ADC noise standard deviation
+ * by 8, so the derivative filter time constant can be lowered.
+ * The temperature is also kept in hundredths of celcius for the fixed
+ * point PID.
+ * If voltage is maximal (i.e. ~=5V) it means that the thermistor is not
+ * connected and regulation and heating is stopped until reconnection.
  */
 double Rims::getTempPV()
 {
-	double tempPV = NCTHERM;
+	if(not _thermSamplesReady) _resetThermSamples();
+	_processValFix = NCTHERM*100L;
 	_ncTherm = true;
-	int curTempADC = analogRead(_analogPinPV);
-	if(curTempADC < 1021)  // connected thermistor
+	if(_thermSamplesReady)  // connected thermistor
 	{
 		_ncTherm = false;
-		double vin = ((double)curTempADC)/1024.0;
-		double resTherm = (_res1*vin)/(1.0-vin);
-		double logResTherm = log(resTherm);
-		double invKelvin = _steinhartCoefs[0]+\
-						_steinhartCoefs[1]*logResTherm+\
-						_steinhartCoefs[2]*pow(logResTherm,2)+\
-						_steinhartCoefs[3]*pow(logResTherm,3);
-		tempPV = (1/invKelvin)-273.15+_fineTuneTemp;
+		_processValFix = _adcToTemp(_thermSum) + _fineTuneTemp;
 	}
-	return tempPV;
+	return _processValFix/100.0;
+}
+
+/*!
+ * \brief Add a thermistor ADC reading to the ring buffer.
+ *
+ * Task run every THERMSAMPLEPERIOD mSec. A reading above THERMADCMAX
+ * (thermistor not connected) discards the buffer so that no mean mixes
+ * disconnected and connected readings.
+ */
+void Rims::_sampleTherm()
+{
+	if(not _thermSamplesReady) return;
+	unsigned int adc = AdcScan::read(_analogPinPV);
+	if(adc > THERMADCMAX)
+	{
+		_thermSamplesReady = false;
+		return;
+	}
+	_thermSum += adc - _thermSamples[_thermSampleIndex];
+	_thermSamples[_thermSampleIndex] = adc;
+	if(++_thermSampleIndex >= THERMOVERSAMPLES) _thermSampleIndex = 0;
+}
+
+/*!
+ * \brief Fill the thermistor ring buffer with a single ADC reading.
+ */
+void Rims::_resetThermSamples()
+{
+	unsigned int adc = AdcScan::read(_analogPinPV);
+	_thermSamplesReady = (adc <= THERMADCMAX);
+	for(byte i=0;i<THERMOVERSAMPLES;i++) _thermSamples[i] = adc;
+	_thermSum = adc * THERMOVERSAMPLES;
+	_thermSampleIndex = 0;
+}
+
+/*!
+ * \brief Steinhart-hart temperature of the thermistor divider.
+ * 
+ * Used to build the thermistor table. Not meant to be called at
+ * each sample : log() and pow() are slow on AVR.
+ * 
+ * \param adc : float. ADC value, between 0 and 1024 (excl.)
+ * \param steinhartCoefs : float[4]. See setThermistor().
+ * \param res1 : float. In ohm.
+ * \return double : temperature in celcius.
+ */
+double Rims::thermistorTemp(float adc, float steinhartCoefs[], float res1)
+{
+	double vin = ((double)adc)/1024.0;
+	double resTherm = (res1*vin)/(1.0-vin);
+	double logResTherm = log(resTherm);
+	double invKelvin = steinhartCoefs[0]+\
+					   steinhartCoefs[1]*logResTherm+\
+					   steinhartCoefs[2]*pow(logResTherm,2)+\
+					   steinhartCoefs[3]*pow(logResTherm,3);
+	return (1/invKelvin)-273.15;
+}
+
+/*!
+ * \brief Fill the SRAM thermistor table from the Steinhart-hart
+ *        coefficients. Temperatures are kept in hundredths of celcius.
+ */
+void Rims::_buildThermTable()
+{
+	for(int i=0;i<THERMTABLESIZE;i++)
+	{
+		double temp = floor(100*thermistorTemp(i*THERMTABLESTEP,
+		                                       _steinhartCoefs,_res1)+0.5);
+		if(not(temp > -32768)) temp = -32768; // also catches nan
+		else if(temp > 32767) temp = 32767;
+		_thermTable[i] = (int16_t)temp;
+	}
+}
+
+/*!
+ * \brief Temperature of an ADC value with the thermistor table.
+ * 
+ * Linear interpolation between table entries.
+ * 
+ * \param adcFixed : unsigned int. ADC value with THERMADCFRACBITS
+ *                   fractional bits, up to THERMADCMAX.
+ * \return long : temperature in hundredths of celcius (without fine tune).
+ */
+long Rims::_adcToTemp(unsigned int adcFixed)
+{
+	long temp0, temp1;
+	unsigned int span, index, frac;
+	if(_thermTablePGM != NULL)
+	{
+		span = (unsigned int)_thermTablePGMStep << THERMADCFRACBITS;
+		index = adcFixed / span;
+		frac = adcFixed % span;
+		temp0 = (int16_t)pgm_read_word(_thermTablePGM + index);
+		temp1 = frac ? (int16_t)pgm_read_word(_thermTablePGM + index + 1) \
+		             : temp0;
+	}
+	else
+	{
+		span = THERMTABLESTEP << THERMADCFRACBITS;
+		index = adcFixed / span;
+		frac = adcFixed % span;
+		temp0 = _thermTable[index];
+		temp1 = frac ? _thermTable[index + 1] : temp0;
+	}
+	return temp0 + ((temp1 - temp0)*(long)frac)/(long)span;
 }
 
 /*!
  * \brief Get flow from hall-effect flow sensor.
+ *
+ * Pulses counted since the oldest of FLOWWINDOWSLOTS snapshots (taken
+ * every FLOWWINDOW/FLOWWINDOWSLOTS mSec at most) are divided by the
+ * time between the last pulse of that snapshot and the last pulse.
+ * That is the mean of every pulse period over about FLOWWINDOW instead
+ * of a single period. If the last pulse is late, time up to now is
+ * used instead, so the flow goes down to 0 when the pump stops.
  */
 float Rims::getFlow()
 {
-	float flow;
-	if(g_flowCurTime == 0) flow = 0.0;
-	else if(micros() - g_flowCurTime >= 5e06) flow = 0.0;
-	else flow = (1e06 / (_flowFactor* (g_flowCurTime - g_flowLastTime)));
+	float flow = 0.0;
+	if(_interruptFlow != -1)
+	{
+		unsigned long pulses, lastPulse, now = micros();
+		_flowSnapshot(pulses,lastPulse);
+		byte slot = _flowSlot;
+		// oldest snapshot taken after a first pulse
+		for(byte i=0;i<FLOWWINDOWSLOTS and _flowPulses[slot]==0;i++)
+		{
+			slot = (slot + 1) % FLOWWINDOWSLOTS;
+		}
+		unsigned long windowPulses = pulses - _flowPulses[slot];
+		if(_flowPulses[slot] != 0 and windowPulses != 0)
+		{
+			unsigned long elapsed = lastPulse - _flowPulseTimes[slot];
+			if(now - lastPulse > elapsed / windowPulses)
+			{
+				elapsed = now - _flowPulseTimes[slot];
+			}
+			flow = (1e06 * windowPulses) / (_flowFactor * elapsed);
+		}
+		unsigned long curTime = millis();
+		if(curTime - _flowSlotTime >= FLOWWINDOW / FLOWWINDOWSLOTS)
+		{
+			_flowPulses[_flowSlot] = pulses;
+			_flowPulseTimes[_flowSlot] = lastPulse;
+			_flowSlot = (_flowSlot + 1) % FLOWWINDOWSLOTS;
+			_flowSlotTime = curTime;
+		}
+	}
 	_criticalFlow = (flow <= CRITICALFLOW);
 	return constrain(flow,0,99.99);
 }
 
+/*!
+ * \brief Pulse count and last pulse time of this instance interrupt.
+ *
+ * Copied again if a pulse came in meanwhile, instead of masking
+ * interrupts.
+ */
+void Rims::_flowSnapshot(unsigned long& pulses, unsigned long& lastPulse)
+{
+	byte sequence, interrupt = (byte)_interruptFlow;
+	do
+	{
+		sequence = g_flowSequence[interrupt];
+		pulses = g_flowPulses[interrupt];
+		lastPulse = g_flowLastPulse[interrupt];
+	}
+	while(sequence != g_flowSequence[interrupt]);
+}
+
 /*!
  * \brief Check if heater is powered or not.
  */
@@ -852,10 +2072,17 @@ void Rims::stopHeating(boolean state)
 	if(state == true)
 	{
 		_myPID.SetMode(MANUAL);
+		_myPIDFix.SetMode(MANUAL);
 		*(_controlValPtr) = 0;
+		_controlValFix = 0;
+		_currentTime = millis();
 		_refreshSSR();
 	}
-	else _myPID.SetMode(AUTOMATIC);
+	else
+	{
+		_myPID.SetMode(AUTOMATIC);
+		_myPIDFix.SetMode(AUTOMATIC);
+	}
 }
 
 /*
@@ -864,14 +2091,31 @@ ISR Definition
 ============================================================
 */
 /*!
- * \brief ISR for flow sensor.
+ * \brief Count a flow sensor pulse and keep its time.
+ * \param interruptFlow : byte. Interrupt number.
+ */
+inline void countFlowPulse(byte interruptFlow)
+{
+	g_flowLastPulse[interruptFlow] = micros();
+	g_flowPulses[interruptFlow]++;
+	g_flowSequence[interruptFlow]++;
+}
+
+/*!
+ * \brief ISR for flow sensor on interrupt 0.
  *
- * ISR is used as a software capture mode. Time values are store in 
- * g_flowLastTime and g_flowCurTime.
- * 
+ * ISR is used as a software capture mode. Pulse count and time are
+ * stored in g_flowPulses and g_flowLastPulse.
+ */
+void isrFlow0()
+{
+	countFlowPulse(0);
+}
+
+/*!
+ * \brief ISR for flow sensor on interrupt 1. See isrFlow0().
  */
-void isrFlow()
+void isrFlow1()
 {
-	g_flowLastTime = g_flowCurTime;
-	g_flowCurTime = micros();
+	countFlowPulse(1);
 }
@@ -27,13 +27,32 @@
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 ///\brief uncomment/comment to include/exclude flash memory
 //#define WITH_W25QFLASH                                          
+///\brief uncomment/comment to include/exclude loop timing probes
+///       (see Rims::printProfile())
+//#define WITH_PROFILER
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
-///\brief Sample time for PID. Same time used
-///       for LCD refresh rate and data log rate [mSec]
+///\brief Default sample time for PID, LCD refresh and data log,
+///       see Rims::setSampleTimes() [mSec]
 #define SAMPLETIME 1000
 ///\brief solid state relay window size [mSec]
 #define SSRWINDOWSIZE 5000
+///\brief SSR modulations of Rims::setSSRModulation()
+#define SSRWINDOW 0     /// one on-time block per SSRWINDOWSIZE
+#define SSRSIGMADELTA 1 /// on-time spread in mains cycles
+///\brief Default mains frequency of SSRSIGMADELTA [Hz]
+#define DEFAULTMAINSFREQ 60
+
+///\brief Columns of a gain table row : key, Kp, Ki, Kd, tauFilter
+///       (see Rims::setTuningTable())
+#define TUNINGCOLUMNS 5
+///\brief Keys of the gain table rows, see Rims::setTuningTable()
+#define GAINSCHEDVOLUME 0 /// mash water [L], asked at start
+#define GAINSCHEDFLOW 1   /// flow [L/min], each PID sample
+#define GAINSCHEDTEMP 2   /// process value [celcius], each PID sample
+///\brief Key change before the gains of GAINSCHEDFLOW/GAINSCHEDTEMP
+///       are interpolated again [key unit]
+#define GAINSCHEDDEADBAND 0.1
 
 ///\brief Default set point on UIRims [celcius]
 #define DEFAULTSP 68
@@ -46,6 +65,22 @@
 #define DEFAULTSTEINHART3 1e-7
 ///\brief [ohm]
 #define DEFAULTRES1 10000
+///\brief Highest ADC value read from a connected thermistor
+#define THERMADCMAX 1020
+///\brief ADC counts between two entries of the thermistor table built
+///       by setThermistor(). THERMADCMAX must be a multiple of it.
+#define THERMTABLESTEP 12
+///\brief Entries in the thermistor table built by setThermistor()
+#define THERMTABLESIZE (THERMADCMAX/THERMTABLESTEP+1)
+///\brief Fractional bits of ADC values converted by the thermistor
+///       table (values can come from oversampling)
+#define THERMADCFRACBITS 6
+///\brief Thermistor ADC readings summed for each temperature. Their
+///       sum is the mean with THERMADCFRACBITS fractional bits.
+#define THERMOVERSAMPLES (1 << THERMADCFRACBITS)
+///\brief Time between two thermistor ADC readings [mSec] (RimsIdent,
+///       Rims uses its PID sample time / THERMOVERSAMPLES)
+#define THERMSAMPLEPERIOD (SAMPLETIME/THERMOVERSAMPLES)
 
 ///\brief Max temperature variation from set 
 ///       point before stopping timer count down [celcius]
@@ -53,6 +88,51 @@
 ///\brief Time before tempScreen/timeFlowScreen 
 ///       is automatically shown[mSec]
 #define SCREENSWITCHTIME 10000 /// mSec
+///\brief Keypad reading period [mSec]
+#define KEYSPERIOD 20
+
+///\brief Tasks of the cooperative scheduler, see Rims::_addTask() : the
+///       9 of Rims::_initialize(), plus the flash and profiler ones
+#if defined(WITH_W25QFLASH) && defined(WITH_PROFILER)
+	#define TASKMAXQTY 11
+#elif defined(WITH_W25QFLASH) || defined(WITH_PROFILER)
+	#define TASKMAXQTY 10
+#else
+	#define TASKMAXQTY 9
+#endif
+///\brief Task ids of Rims::_addTask(), index of g_taskNames and
+///       g_taskPriorities
+#define TASKSSR         0
+#define TASKTIMER       1
+#define TASKTELEMETRY   2
+#define TASKMEM         3
+#define TASKLCD         4
+#define TASKTHERM       5
+#define TASKPID         6
+#define TASKDISPLAY     7
+#define TASKLOG         8
+#define TASKKEYS        9
+#define TASKPROFILER    10
+#define TASKIDENTSTEP   11 /// RimsIdent
+#define TASKIDENTSAMPLE 12 /// RimsIdent
+#define TASKIDENTKEYS   13 /// RimsIdent
+#define TASKIDQTY       14
+
+///\brief Profiler stages after the tasks (WITH_PROFILER)
+#define PROFILERPASS    TASKMAXQTY     /// whole _iterate() pass
+#define PROFILERTEMP    (TASKMAXQTY+1) /// getTempPV() of the PID task
+#define PROFILERCOMPUTE (TASKMAXQTY+2) /// PID Compute()
+#define PROFILERPUSH    (TASKMAXQTY+3) /// telemetry push()
+///\brief Serial command polling period (WITH_PROFILER) [mSec]
+#define PROFILERPERIOD 100
+
+///\brief Data log channels of setLogRate()
+#define LOGSERIAL 0
+#define LOGFLASH 1
+#define LOGCHANNELS 2
+///\brief The burst rate of setLogRate() lasts this long after a
+///       transient (temperature out of MAXTEMPVAR, RimsIdent step) [mSec]
+#define LOGBURSTTIME 60000
 
 /// \brief Default lower bound for accepted flow rate [L/min]
 #define DEFAULTFLOWLOWBOUND 3.0
@@ -61,36 +141,73 @@
 ///\brief If _stopOnCriticalFlow is activited, heater will be turn off
 ///       if flow is <= than this value.
 #define CRITICALFLOW 1.0
+///\brief External interrupts that can receive a flow sensor
+///       (one ISR each, see isrFlow0() and g_isrFlows)
+#define FLOWMAXINTERRUPTS 2
+///\brief Time span of the flow pulse counting window [mSec]
+#define FLOWWINDOW 2000
+///\brief Pulse count snapshots kept over FLOWWINDOW
+#define FLOWWINDOWSLOTS 4
 
-///\brief Flash mem address for table of starting addr. of brew sessions
-#define ADDRSESSIONTABLE	0x000000 // 1st sector
-///\brief Flash mem address for counting data in current brew session
-#define ADDRDATACOUNT		0x001000 // 2nd sector
-///\brief Flash mem starting address for all brew datas
-#define ADDRBREWDATA		0x002000 // 3rd sector
-///\brief Total bytes used per data point (at each second)
-#define BYTESPERDATA		18
+///\brief Flash mem page size, unit of buffered writes [bytes]
+#define MEMPAGESIZE			256
+///\brief Flash mem sector size, unit of erase [bytes]
+#define MEMSECTORSIZE		4096
+///\brief Pages in a sector
+#define MEMPAGESPERSECTOR	(MEMSECTORSIZE/MEMPAGESIZE)
+///\brief Pages of the circular brew data log (whole memory)
+#define MEMPAGEQTY			(MEMSIZEBYTES/MEMPAGESIZE)
+///\brief Sectors of the circular brew data log (whole memory)
+#define MEMSECTORQTY		(MEMSIZEBYTES/MEMSECTORSIZE)
+///\brief Format version of the log pages (first byte of each page)
+#define MEMPAGEFORMAT		0x02
+///\brief Page header : format, data point qty, set point,
+///       sequence number, brew session [bytes]
+#define MEMPAGEHEADER		10
+///\brief Fields of a data point : time, cv, pv, flow, timerRemaining
+#define MEMFIELDS			5
+///\brief Largest delta encoded data point (5 varints) [bytes]
+#define MEMMAXDELTASIZE		25
+///\brief Typical data points per page, for free space estimate
+#define MEMDATAPERPAGE		42
+///\brief Binary dump frame : raw page, see _memDumpBinary()
+#define MEMFRAMEPAGE		'P'
+///\brief Binary dump frame : end of session
+#define MEMFRAMEEND			'E'
 ///\brief Memory size in bytes (Winbond W25QW25Q80BV : 1 MByte)
 #define MEMSIZEBYTES		1048576
 
 #include "Arduino.h"
 #include "utility/UIRims.h"
 #include "utility/PID_v1mod.h"
+#include "utility/PID_v1fix.h"
+#include "utility/AdcScan.h"
+#include "utility/SsrTimer.h"
+#include "utility/Telemetry.h"
 
 
 #ifdef WITH_W25QFLASH
 	#include "utility/w25qflash.h"
 #endif
+#ifdef WITH_PROFILER
+	#include "utility/Profiler.h"
+	#if PROFILERPUSH >= PROFILERMAXSTAGES
+		#error "PROFILERMAXSTAGES too small for TASKMAXQTY"
+	#endif
+#endif
+
 
+extern const char g_csvHeader[] PROGMEM;
+extern const char* const g_taskNames[TASKIDQTY] PROGMEM;
+extern const byte g_taskPriorities[TASKIDQTY] PROGMEM;
 
-extern const char g_csvHeader[];
+class Rims;
+///\brief Task of the cooperative scheduler, see Rims::_addTask()
+typedef void (Rims::*RimsTask)();
 
 /*!
  * \brief Recirculation infusion mash system (RIMS) library for Arduino
  * \author Francis Gagnon 
- *
- * \bug Only one Rims (or child) instance is allowed with flow sensor
-        because of static method _isrFlowSensor()
  */
 
 class Rims
@@ -102,24 +219,51 @@ public:
 		 double* currentTemp, double* ssrControl, double* settedTemp);
 
 	void setThermistor(float steinhartCoefs[],float res1, float fineTune = 0);
+	void setThermistorTable(const int16_t tablePGM[], byte step = 1,
+							float fineTune = 0);
 	void setPinLED(byte pinLED);
 	void setInterruptFlow(byte interruptFlow, float flowFactor, 
 						  float lowBound = DEFAULTFLOWLOWBOUND, 
 						  float upBound = DEFAULTFLOWUPBOUND,
 					      boolean stopOnCriticalFlow = true);
 	void setHeaterPowerDetect(char pinHeaterVolt);
+	void setSSRModulation(byte modulation, byte mainsFreq = DEFAULTMAINSFREQ);
+	void setTelemetry(byte mode, unsigned long baud = TELEMETRYBAUD);
+	void setTelemetryFields(unsigned int fields);
+	unsigned int getTelemetryDropped();
+	void setLogRate(byte channel, byte decimation, byte burstDecimation = 1);
+	void setSampleTimes(unsigned int pidTime,
+	                    unsigned int displayTime = SAMPLETIME,
+	                    unsigned int logTime = SAMPLETIME);
+	
+	byte getTaskQty();
+	const __FlashStringHelper* getTaskName(byte task);
+#ifdef WITH_PROFILER
+	unsigned int getTaskMisses(byte task);
+	unsigned long getTaskMaxLate(byte task);
+#endif
 	
 	void setTuningPID(double Kp, double Ki, double Kd, double tauFilter,
-	                  int mashWaterQty = -1);
+	                  int mashWaterQty = -1, boolean fixedPoint = false);
+	void setTuningTable(const float tablePGM[][TUNINGCOLUMNS], byte rowQty,
+	                    byte scheduling = GAINSCHEDVOLUME,
+	                    boolean fixedPoint = false);
 #ifdef WITH_W25QFLASH
 	void setMemCSPin(byte csPin);
 	void checkMemAccessMode();
 #endif
+#ifdef WITH_PROFILER
+	void printProfile();
+	void resetProfile();
+#endif
 	
 	void run();
 	
 	double getTempPV();
 	float getFlow();
+	
+	static double thermistorTemp(float adc, float steinhartCoefs[],
+								 float res1);
 	boolean getHeaterVoltage();
 	
 	void stopHeating(boolean state);
@@ -129,17 +273,55 @@ protected:
 	virtual void _initialize();
 	virtual void _iterate();
 	
+	void _clearTasks();
+	void _addTask(RimsTask task, byte id, unsigned long period,
+				  unsigned long phase);
+	void _taskPID();
+	void _taskLog();
+	void _taskKeys();
+	void _taskTimer();
+	void _taskTelemetry();
+	void _taskLCD();
+#ifdef WITH_W25QFLASH
+	void _taskMem();
+#endif
+#ifdef WITH_PROFILER
+	void _taskProfiler();
+#endif
+	
+	void _scheduleGains(float key, boolean transfer);
 	void _refreshTimer(boolean verifyTemp = true);
 	void _refreshDisplay();
 	void _refreshSSR();
+	void _refreshSSRWindow();
+	void _logDataPoint(unsigned long time);
+	void _buildThermTable();
+	void _flowSnapshot(unsigned long& pulses, unsigned long& lastPulse);
+	void _sampleTherm();
+	void _resetThermSamples();
+	long _adcToTemp(unsigned int adcFixed);
 #ifdef WITH_W25QFLASH
 	unsigned int  _memCountSessions();
-	unsigned long _memCountSessionData();
 	void          _memInit(float sp);
-	void          _memAddBrewData(float time, unsigned int cv,
-								  float pv, float flow,
-								  float timerRemaining);
+	void          _memAddBrewData(unsigned long time, unsigned int cv,
+								  long pv, float flow,
+								  unsigned long timerRemaining);
+	void          _memPutKeyframe(const long values[]);
+	void          _memCommitPage();
+	static byte*  _memPutDelta(byte* dst, long value);
+	static long   _memGetDelta(const byte** src, const byte* end);
+	static void   _memPutLE(byte* dst, long value, byte size);
+	static long   _memGetLE(const byte* src, byte size);
+	void          _memLoadLog();
+	byte          _memReadHeader(unsigned int page, unsigned long* seq,
+	                             unsigned int* session);
+	unsigned int  _memPageSession(unsigned int page);
+	unsigned int  _memFindSession(unsigned int session);
+	void          _memDropSector(unsigned int sector);
 	void          _memDumpBrewData();
+	void          _memDumpBinary();
+	static unsigned int _memSlipWrite(const byte* data, unsigned int n,
+	                                  unsigned int crc);
 	void          _memFreeSpace();
 	void          _memClearAll();
 #endif
@@ -149,13 +331,39 @@ private:
 	// ===GENERAL===
 	UIRims* _ui;
 	PIDmod _myPID;
+	PIDfix _myPIDFix;
 	byte _analogPinPV;
 	byte _pinCV;
 	byte _pinLED;
 	char _pinHeaterVolt;
+	byte _ssrModulation;      /// SSRWINDOW or SSRSIGMADELTA
+	byte _mainsFreq;          /// Hz
+	unsigned int _ssrAccumulator; /// SSRSIGMADELTA without SsrTimer [mSec]
+	int8_t _ssrChannel;       /// SsrTimer channel, -1 : loop refresh
 #ifdef WITH_W25QFLASH
 	W25QFlash _myMem;
 #endif
+	Telemetry _telemetry;
+#ifdef WITH_PROFILER
+	Profiler _profiler;
+#endif
+	
+	// ===SCHEDULER===
+	RimsTask _taskFns[TASKMAXQTY];
+	byte _taskIds[TASKMAXQTY];                /// TASKSSR, TASKPID...
+	unsigned long _taskPeriods[TASKMAXQTY];   /// mSec, 0 : every pass
+	unsigned long _taskNextTimes[TASKMAXQTY]; /// mSec
+#ifdef WITH_PROFILER
+	unsigned int _taskMisses[TASKMAXQTY];     /// periods skipped
+	unsigned long _taskMaxLates[TASKMAXQTY];  /// mSec
+#endif
+	byte _taskQty;
+	
+	// ===DATA LOG RATE===
+	byte _logDecimations[LOGCHANNELS];      /// data point every n samples
+	byte _logBurstDecimations[LOGCHANNELS]; /// same, after a transient
+	unsigned long _logTicks;                /// samples since start
+	unsigned long _logTransientTime;        /// mSec
 	
 	// ===STATE DATAS===
 	boolean _rimsInitialized;
@@ -170,16 +378,34 @@ private:
 	byte _pidQty;
 	byte _currentPID;
 	int _mashWaterValues[4];
+	boolean _fixedPIDs[4];
+	boolean _useFixedPID;
+	const float (*_tuningTablePGM)[TUNINGCOLUMNS]; /// NULL : setTuningPID()
+	byte _tuningRowQty;
+	byte _gainScheduling;   /// GAINSCHEDVOLUME, GAINSCHEDFLOW...
+	boolean _tableFixedPID;
+	float _mashWater;       /// [L], GAINSCHEDVOLUME
+	float _gainKey;         /// key of the gains in use
 	
 	// ===THERMISTOR===
 	float _steinhartCoefs[4];
 	float _res1;
-	float _fineTuneTemp;
+	long _fineTuneTemp;                  /// [celcius/100]
+	int16_t _thermTable[THERMTABLESIZE]; /// [celcius/100]
+	const int16_t* _thermTablePGM;       /// [celcius/100]
+	byte _thermTablePGMStep;
+	unsigned int _thermSamples[THERMOVERSAMPLES]; /// ADC ring buffer
+	unsigned int _thermSum;              /// sum of _thermSamples
+	byte _thermSampleIndex;
+	boolean _thermSamplesReady;
 	
 	// ===PID I/O===
 	double* _setPointPtr;
 	double* _processValPtr;
 	double* _controlValPtr; /// [0,SSRWINDOWSIZE]
+	long _setPointFix;      /// [celcius/100]
+	long _processValFix;    /// [celcius/100]
+	long _controlValFix;    /// [0,SSRWINDOWSIZE]
 	
 	// ===PID PARAMS===
 	double _kps[4];
@@ -197,18 +423,37 @@ private:
 	unsigned long _timerStopTime;			///mSec
 	unsigned long _timerStartTime;			///mSec
 	unsigned long _lastScreenSwitchTime;    ///mSec
-	unsigned long _lastTimePID;             ///mSec
+	unsigned long _lastTimePID;             ///mSec, last PID sample
+	unsigned int _pidSampleTime;            ///mSec, see setSampleTimes()
+	unsigned int _displayPeriod;            ///mSec
+	unsigned int _logPeriod;                ///mSec
 	boolean _sumStoppedTime;
 	boolean _timerElapsed;
 	
 	// ===FLOW SENSOR===
 	float _flowFactor; /// freq[Hz] = flowFactor * flow[L/min]
 	float _flow;
+	int8_t _interruptFlow;                          /// -1 : no flow sensor
+	unsigned long _flowPulses[FLOWWINDOWSLOTS];     /// pulse count snapshots
+	unsigned long _flowPulseTimes[FLOWWINDOWSLOTS]; /// last pulse [µSec]
+	unsigned long _flowSlotTime;                    /// mSec
+	byte _flowSlot;                                 /// oldest snapshot
 	
 #ifdef WITH_W25QFLASH
 	// ===FLASH MEM===
-	unsigned long _memNextAddr;
-	unsigned long _memDataQty;
+	unsigned int _memNextPage;   /// next page to program
+	unsigned int _memOldestPage; /// first page of the log
+	unsigned long _memNextSeq;   /// sequence number of _memNextPage
+	unsigned int _memSession;    /// newest brew session
+	unsigned int _memFirstSession; /// oldest brew session
+	unsigned int _memSessionQty;
+	boolean _memLogLoaded;       /// log located by _memLoadLog()
+	byte _memPage[MEMPAGESIZE];  /// page buffer
+	byte _memPageData;           /// data points in _memPage
+	unsigned int _memPageLen;    /// bytes used in _memPage, 0 : point held
+	int _memSetPoint;            /// [celcius/100]
+	long _memLastValues[MEMFIELDS]; /// last data point added
+	long _memLastTimeDelta;      /// mSec
 #endif
 	
 };
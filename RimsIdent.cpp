@@ -23,8 +23,11 @@ RimsIdent::RimsIdent(UIRimsIdent* uiRimsIdent, byte analogPinTherm,
 					 double* settedTemp)
 : Rims(uiRimsIdent, analogPinTherm, ssrPin, 
 	   currentTemp, ssrControl, settedTemp),
- _ui(uiRimsIdent)
+ _ui(uiRimsIdent), _autotuneRule(AUTOTUNEOFF),
+ _autotuneHysteresis(AUTOTUNEHYSTERESIS), _autotuneDone(false),
+ _ultimateGain(0), _ultimatePeriod(0)
 {
+	for(byte i=0;i<4;i++) _autotuneTunings[i] = 0;
 }
 
 /*!
@@ -43,12 +46,70 @@ RimsIdent::RimsIdent(UIRimsIdent* uiRimsIdent, byte analogPinTherm,
  * that information but there's a lot on information here :
  * http://www.controlguru.com/wp/p87.html
  *
+ * With setAutotune(), the set point is asked and the relay autotune
+ * runs instead (AUTOTUNELENGTH at most).
  */
 void RimsIdent::run()
 {
 	Rims::run();
 }
 
+/*!
+ * \brief Relay autotune (Astrom-Hagglund) instead of the step test.
+ *
+ * The SSR is switched between 100 % and 0 % around the set point asked
+ * at start, with hysteresis : 0 % once the temperature is above
+ * sp+hysteresis, 100 % once it is below sp-hysteresis. The temperature
+ * then oscillates at the ultimate period Pu, with an amplitude a (half
+ * peak to peak) that gives the ultimate gain :
+ * \f[
+ * K_{u}=\frac{4d}{\pi\sqrt{a^2-h^2}}
+ * \f]
+ * where d = SSRWINDOWSIZE/2 and h = hysteresis. Each cycle starts when
+ * the SSR goes back to 100 %. The result is taken when the last two
+ * cycles agree within AUTOTUNETOLERANCE (at least AUTOTUNEMINCYCLES
+ * cycles, AUTOTUNEMAXCYCLES at most), usually a few minutes. After
+ * AUTOTUNELENGTH, it ends without result.
+ *
+ * The gains of the rule (Ti = Kp/Ki, Td = Kd/Kp) are :
+ * - AUTOTUNEZN : Kp = 0.6 Ku, Ti = Pu/2, Td = Pu/8
+ * - AUTOTUNETL : Kp = Ku/2.2, Ti = 2.2 Pu, Td = Pu/6.3
+ * - AUTOTUNENOOVERSHOOT : Kp = 0.2 Ku, Ti = Pu/2, Td = Pu/3
+ *
+ * and tauFilter = Td/AUTOTUNEFILTERN. They are shown on the LCD, printed
+ * on the serial port as a setTuningPID() call, and given to a Rims
+ * instance by applyAutotune().
+ *
+ * \param rule : byte. AUTOTUNEZN, AUTOTUNETL, AUTOTUNENOOVERSHOOT or
+ *               AUTOTUNEOFF (step test).
+ * \param hysteresis : float (default=AUTOTUNEHYSTERESIS). [celcius].
+ *                     Above the temperature noise.
+ */
+void RimsIdent::setAutotune(byte rule, float hysteresis)
+{
+	_autotuneRule = rule;
+	_autotuneHysteresis = hysteresis;
+}
+
+/*!
+ * \brief Give the gains of the last relay autotune to a Rims instance
+ *        with Rims::setTuningPID().
+ * \param rims : Rims*. Regulator of the same RIMS.
+ * \param mashWaterQty : int (default=-1). See Rims::setTuningPID()
+ * \param fixedPoint : boolean (default=false). See Rims::setTuningPID()
+ * \return boolean : false if there's no result (autotune not done or
+ *                   not converged), rims is unchanged.
+ */
+boolean RimsIdent::applyAutotune(Rims* rims, int mashWaterQty,
+								 boolean fixedPoint)
+{
+	if(_ultimateGain <= 0) return false;
+	rims->setTuningPID(_autotuneTunings[0],_autotuneTunings[1],
+					   _autotuneTunings[2],_autotuneTunings[3],
+					   mashWaterQty,fixedPoint);
+	return true;
+}
+
 /*!
  * \brief Initialize RimsIdent before iteration
  */
@@ -56,10 +117,16 @@ void RimsIdent::_initialize()
 {
 	unsigned long currentTime;
 	_timerElapsed = false;
-	(*_setPointPtr) = 0.0;
 	// === OPEN SERIAL ===
 	_ui->showSerialWarning();
-	while(_ui->readKeysADC()==KEYNONE) continue;
+	while(_ui->readKeysADC()==KEYNONE) _ui->refreshLCD();
+	// === ASK SETPOINT ===
+	if(_autotuneRule != AUTOTUNEOFF)
+	{
+		if(*(_setPointPtr) <= 0) *(_setPointPtr) = DEFAULTSP;
+		*(_setPointPtr) = _ui->askSetPoint(*(_setPointPtr));
+	}
+	else (*_setPointPtr) = 0.0;
 	// === PUMP SWITCHING ===
 	_ui->showPumpWarning();
 	_currentTime = millis();
@@ -72,10 +139,11 @@ void RimsIdent::_initialize()
 			_ui->setFlow(this->getFlow(),false);
 			lastFlowRefresh = _currentTime;
 		}
+		_ui->refreshLCD();
 	}
 	// === HEATER SWITCHING ===
 	_ui->showHeaterWarning();
-	while(_ui->readKeysADC()==KEYNONE) continue;
+	while(_ui->readKeysADC()==KEYNONE) _ui->refreshLCD();
 	_rimsInitialized = true;
 	stopHeating(false);
 #ifdef WITH_W25QFLASH
@@ -83,69 +151,202 @@ void RimsIdent::_initialize()
 	if(_memConnected) _memInit(*_setPointPtr);
 #endif
 	// === IDENTIFICATION TESTS ===
-	Serial.println(g_csvHeader);
+	_telemetry.printHeader();
+	_telemetry.reset();
+	_logTicks = 0;
+	_logTransientTime = millis();
 	_ui->showIdentScreen();
-	_settedTime = IDENTLENGTH; // 15 minutes
+	_settedTime = (_autotuneRule != AUTOTUNEOFF) ? AUTOTUNELENGTH : \
+	                                               IDENTLENGTH;
+	_autotuneDone = _cycleStarted = false;
+	_relayHigh = true;
+	_cycleQty = 0;
+	_ultimateGain = _ultimatePeriod = 0;
 	_sumStoppedTime = false;
 	currentTime = millis();
 	_totalStoppedTime = _windowStartTime = currentTime;
 	_runningTime = 0;
-	_lastTimeSerial = currentTime - IDENTSAMPLETIME;
+	_resetThermSamples();
+	// === TASKS ===
+	_clearTasks();
+	_addTask(static_cast<RimsTask>(&RimsIdent::_taskStep),TASKIDENTSTEP,0,0);
+	_addTask(&Rims::_refreshSSR,TASKSSR,0,0);
+	_addTask(&Rims::_taskTelemetry,TASKTELEMETRY,0,0);
+#ifdef WITH_W25QFLASH
+	_addTask(&Rims::_taskMem,TASKMEM,0,0);
+#endif
+	_addTask(&Rims::_taskLCD,TASKLCD,0,0);
+	_addTask(&Rims::_sampleTherm,TASKTHERM,THERMSAMPLEPERIOD,0);
+	_addTask(static_cast<RimsTask>(&RimsIdent::_taskSample),
+			 TASKIDENTSAMPLE,IDENTSAMPLETIME,0);
+	_addTask(static_cast<RimsTask>(&RimsIdent::_taskKeys),
+			 TASKIDENTKEYS,KEYSPERIOD,0);
 }
 
 /*!
- * \brief Iteration for RimsIdent instance
+ * \brief Task : time elapsed, then the SSR step of this time (step
+ *        test).
  */
-void RimsIdent::_iterate()
+void RimsIdent::_taskStep()
 {
+	double lastCV = *(_controlValPtr);
 	_refreshTimer(false);
-	if(not _timerElapsed)
+	if(_timerElapsed)
 	{
-		if(_runningTime >= STEP3TIME) *(_controlValPtr) = STEP3VALUE;
-		else if(_runningTime >= STEP2TIME) *(_controlValPtr) = STEP2VALUE;
-		else if(_runningTime >= STEP1TIME) *(_controlValPtr) = STEP1VALUE;
-		if(_currentTime - _lastTimeSerial >= IDENTSAMPLETIME)
+		stopHeating(true);
+		if(_autotuneRule != AUTOTUNEOFF and not _autotuneDone)
 		{
-			*(_processValPtr) = this->getTempPV();
-			_flow = this->getFlow();
-#ifdef WITH_W25QFLASH
-			if(_memConnected)
+			_endAutotune(false);
+		}
+		return;
+	}
+	if(_autotuneRule != AUTOTUNEOFF) return; // see _relayStep()
+	if(_runningTime >= STEP3TIME) *(_controlValPtr) = STEP3VALUE;
+	else if(_runningTime >= STEP2TIME) *(_controlValPtr) = STEP2VALUE;
+	else if(_runningTime >= STEP1TIME) *(_controlValPtr) = STEP1VALUE;
+	if(*(_controlValPtr) != lastCV) _logTransientTime = _currentTime;
+}
+
+/*!
+ * \brief Task : read temperature and flow, data point until the end
+ *        of the identification.
+ */
+void RimsIdent::_taskSample()
+{
+	*(_processValPtr) = this->getTempPV();
+	_flow = this->getFlow();
+	if(_autotuneRule != AUTOTUNEOFF and not _timerElapsed) _relayStep();
+	if(not _timerElapsed) _logDataPoint(_runningTime);
+	if(_autotuneDone) // result on the LCD
+	{
+		_buzzerState = not _buzzerState;
+		_ui->ring(_buzzerState);
+		_ui->lcdLight(_buzzerState);
+		return;
+	}
+	_refreshDisplay();
+	if(not _timerElapsed) _ui->setIdentCV(*(_controlValPtr),SSRWINDOWSIZE);
+}
+
+/*!
+ * \brief Relay of the autotune at each sample, and measure of its
+ *        cycles (see setAutotune()).
+ */
+void RimsIdent::_relayStep()
+{
+	double pv = *(_processValPtr), sp = *(_setPointPtr);
+	float periodDiff, amplitudeDiff;
+	if(pv > _cycleMax) _cycleMax = pv;
+	if(pv < _cycleMin) _cycleMin = pv;
+	if(_relayHigh and pv > sp + _autotuneHysteresis)
+	{
+		_relayHigh = false;
+		_logTransientTime = _currentTime;
+	}
+	else if(not _relayHigh and pv < sp - _autotuneHysteresis)
+	{
+		_relayHigh = true;
+		_logTransientTime = _currentTime;
+		if(_cycleStarted)
+		{
+			_cyclePeriods[0] = _cyclePeriods[1];
+			_cycleAmplitudes[0] = _cycleAmplitudes[1];
+			_cyclePeriods[1] = (_runningTime - _cycleStartTime) / 1000.0;
+			_cycleAmplitudes[1] = (_cycleMax - _cycleMin) / 2;
+			_cycleQty++;
+		}
+		_cycleStarted = true;
+		_cycleStartTime = _runningTime;
+		_cycleMax = _cycleMin = pv;
+		if(_cycleQty >= AUTOTUNEMINCYCLES)
+		{
+			periodDiff = abs(_cyclePeriods[1] - _cyclePeriods[0]);
+			amplitudeDiff = abs(_cycleAmplitudes[1] - _cycleAmplitudes[0]);
+			if((periodDiff <= AUTOTUNETOLERANCE * _cyclePeriods[1] and \
+			    amplitudeDiff <= AUTOTUNETOLERANCE * _cycleAmplitudes[1]) \
+			   or _cycleQty >= AUTOTUNEMAXCYCLES)
 			{
-				_memAddBrewData((_currentTime-_rimsStartTime)/1000.0,
-								*(_controlValPtr),
-									*(_processValPtr),
-								_flow,
-								(_settedTime-_runningTime)/1000.0);
+				_endAutotune(true);
+				return;
 			}
-#endif
-			Serial.print((double)_runningTime/1000.0,3);	Serial.print(",");
-			Serial.print(*(_setPointPtr),1);				Serial.print(",");
-			Serial.print(*(_controlValPtr),0);				Serial.print(",");
-			Serial.print(*(_processValPtr),3);				Serial.print(",");
-			Serial.print(_flow,2);							Serial.print(",");
-			Serial.println((_settedTime-_runningTime)/1000.0,0);
-			_refreshDisplay();
-			_ui->setIdentCV(*(_controlValPtr),SSRWINDOWSIZE);
-			_lastTimeSerial += IDENTSAMPLETIME;
 		}
-		_refreshSSR();
 	}
-	else 
+	*(_controlValPtr) = _relayHigh ? SSRWINDOWSIZE : 0;
+}
+
+/*!
+ * \brief Stop the relay, compute the gains of the last two cycles with
+ *        the rule of setAutotune(), then show and print them.
+ * \param converged : boolean. false : time limit, no result.
+ */
+void RimsIdent::_endAutotune(boolean converged)
+{
+	float amplitude, relay = SSRWINDOWSIZE / 2.0, kp = 0, ti = 0, td = 0;
+	_autotuneDone = true;
+	_timerElapsed = true;
+	*(_controlValPtr) = 0;
+	stopHeating(true);
+	if(converged)
 	{
-		stopHeating(true);
-		if(_currentTime - _lastTimeSerial >= IDENTSAMPLETIME)
+		amplitude = (_cycleAmplitudes[0] + _cycleAmplitudes[1]) / 2;
+		_ultimatePeriod = (_cyclePeriods[0] + _cyclePeriods[1]) / 2;
+		if(amplitude > _autotuneHysteresis)
 		{
-			*(_processValPtr) = this->getTempPV();
-			_flow = this->getFlow();
-			_refreshDisplay();
-			_lastTimeSerial += IDENTSAMPLETIME;
+			amplitude = sqrt(amplitude * amplitude - \
+			                 _autotuneHysteresis * _autotuneHysteresis);
 		}
-		if(_ui->readKeysADC() == KEYSELECT)
+		_ultimateGain = 4 * relay / (PI * amplitude);
+		switch(_autotuneRule)
+		{
+			case AUTOTUNETL :
+				kp = _ultimateGain / 2.2;
+				ti = 2.2 * _ultimatePeriod;
+				td = _ultimatePeriod / 6.3;
+				break;
+			case AUTOTUNENOOVERSHOOT :
+				kp = 0.2 * _ultimateGain;
+				ti = _ultimatePeriod / 2;
+				td = _ultimatePeriod / 3;
+				break;
+			default :
+				kp = 0.6 * _ultimateGain;
+				ti = _ultimatePeriod / 2;
+				td = _ultimatePeriod / 8;
+				break;
+		}
+		_autotuneTunings[0] = kp;
+		_autotuneTunings[1] = kp / ti;
+		_autotuneTunings[2] = kp * td;
+		_autotuneTunings[3] = td / AUTOTUNEFILTERN;
+	}
+	_ui->showAutotuneResult(_ultimateGain,_ultimatePeriod);
+	// === SERIAL ===
+	if(_ultimateGain > 0)
+	{
+		Serial.print(F("setTuningPID("));
+		for(byte i=0;i<4;i++)
 		{
-			_ui->ring(false);
-			_ui->lcdLight(true);
-			_rimsInitialized = false;
+			Serial.print(_autotuneTunings[i],4);
+			Serial.print((i < 3) ? F(",") : F(")"));
 		}
+		Serial.print(F(" Ku="));
+		Serial.print(_ultimateGain);
+		Serial.print(F(" Pu="));
+		Serial.println(_ultimatePeriod);
+	}
+	else Serial.println(F("autotune: no convergence"));
+}
+
+/*!
+ * \brief Task : end of the identification once the timer is elapsed.
+ */
+void RimsIdent::_taskKeys()
+{
+	if(_timerElapsed and _ui->readKeysADC() == KEYSELECT)
+	{
+		_ui->ring(false);
+		_ui->lcdLight(true);
+		_rimsInitialized = false;
 	}
 }
 
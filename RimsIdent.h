@@ -22,6 +22,24 @@
 #define STEP3TIME 1200000
 #define STEP3VALUE 0					/// 0 %
 
+///\brief Tuning rules of the relay autotune, see RimsIdent::setAutotune()
+#define AUTOTUNEOFF 0         /// step test above, no relay
+#define AUTOTUNEZN 1          /// Ziegler-Nichols PID
+#define AUTOTUNETL 2          /// Tyreus-Luyben PID, more robust
+#define AUTOTUNENOOVERSHOOT 3 /// Ziegler-Nichols "no overshoot" PID
+///\brief Default relay hysteresis around the set point [celcius]
+#define AUTOTUNEHYSTERESIS 0.2
+///\brief The last two relay cycles must agree within this ratio
+///       (period and amplitude)
+#define AUTOTUNETOLERANCE 0.05
+///\brief Relay cycles measured at least and at most for a result
+#define AUTOTUNEMINCYCLES 3
+#define AUTOTUNEMAXCYCLES 10
+///\brief Time limit of the relay autotune [mSec]
+#define AUTOTUNELENGTH 900000
+///\brief Derivative filter of the autotune gains : tauFilter = Td/N
+#define AUTOTUNEFILTERN 10
+
 #include "Arduino.h"
 #include "Rims.h"
 #include "utility/UIRimsIdent.h"
@@ -37,6 +55,9 @@
  * If flash memory is correctly connected, the data will
  * be stored in the flash mem too. It last 30 min.
  *
+ * With setAutotune(), it runs a relay autotune instead, which computes
+ * the PID gains on the board, see setAutotune().
+ *
  * \author Francis Gagnon
  */
 class RimsIdent : public Rims
@@ -48,6 +69,12 @@ public:
 	
 	void run();
 	
+	void setAutotune(byte rule, float hysteresis = AUTOTUNEHYSTERESIS);
+	boolean applyAutotune(Rims* rims, int mashWaterQty = -1,
+	                      boolean fixedPoint = false);
+	float getUltimateGain() {return _ultimateGain;}
+	float getUltimatePeriod() {return _ultimatePeriod;}
+	
 	void setInterruptFlow(byte interruptFlow, float flowFactor, 
 						  float lowBound = -1,
 						  float upBound = 100,
@@ -56,13 +83,31 @@ public:
 protected : 
 
 	void _initialize();
-	void _iterate();
+	void _taskStep();
+	void _taskSample();
+	void _taskKeys();
+	void _relayStep();
+	void _endAutotune(boolean converged);
 	
 private :
 	
 	UIRimsIdent* _ui;
 	
-	unsigned long _lastTimeSerial;
+	// ===RELAY AUTOTUNE===
+	byte _autotuneRule;           /// AUTOTUNEOFF : step test
+	float _autotuneHysteresis;    /// celcius
+	boolean _autotuneDone;
+	boolean _relayHigh;           /// SSR at 100 %
+	boolean _cycleStarted;        /// first relay cycle begun
+	byte _cycleQty;               /// relay cycles measured
+	unsigned long _cycleStartTime; /// mSec, last switch to 100 %
+	double _cycleMax;             /// celcius, current cycle
+	double _cycleMin;             /// celcius
+	float _cyclePeriods[2];       /// sec, last two cycles
+	float _cycleAmplitudes[2];    /// celcius, half peak to peak
+	float _ultimateGain;          /// mSec/celcius, 0 : no result
+	float _ultimatePeriod;        /// sec
+	double _autotuneTunings[4];   /// Kp, Ki, Kd, tauFilter
 	
 };
 
@@ -14,6 +14,8 @@ void setup() {
   0.0006 , 0.0003 , -0.000007 , 0.0000003 
   };
   myIdent.setThermistor(steinhartCoefs,10000.0);
+  // relay autotune at the set point instead of the 30 min step test :
+  // myIdent.setAutotune(AUTOTUNETL);
 }
 void loop() {
   myIdent.run();
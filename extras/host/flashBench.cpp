@@ -0,0 +1,225 @@
+/*!
+ * \file flashBench.cpp
+ * \brief W25QFlash throughput on the virtual clock
+ *
+ * A W25QSim with typical W25Q80BV program and erase times is driven
+ * with the UNO HAL costs. The W25QFlash transfer paths are compared
+ * with the byte by byte paths it used before (Read 0x03, one
+ * SPI.transfer() per byte, status instruction sent at each poll) :
+ *
+ * - dump : whole memory read one page at a time, as
+ *   Rims::_memDumpBrewData() does, then in a single read()
+ * - log : whole memory programmed one page at a time, as
+ *   Rims::_memCommitPage() does (sector erases included)
+ * - records : 18 bytes writes across page boundaries
+ *
+ * Memory content is checked after each job. The exit status is 1 if
+ * it is wrong or if an instruction was ignored while the chip was busy.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Arduino.h"
+#include "HostHal.h"
+#include "SPI.h"
+#include "W25QSim.h"
+#include "w25qflash.h"
+
+namespace
+{
+
+const uint8_t g_pinCS = A5;
+
+/*!
+ * \brief W25QFlash transfers as they were : Read (0x03), one
+ *        SPI.transfer() per byte, status polled before every
+ *        instruction.
+ */
+class ByteFlash : public W25QFlash
+{
+public:
+	void waitFree()
+	{
+		_select();
+		while(_getStatus() & W25Q_MASK_BSY);
+		_deselect();
+	}
+
+	void read(unsigned long addr, byte buffer[], unsigned long n)
+	{
+		waitFree();
+		_select();
+		_sendCmdAddr(W25Q_READ,addr);
+		for(unsigned long i=0;i<n;i++) buffer[i] = SPI.transfer(0xFF);
+		_deselect();
+	}
+
+	void program(unsigned long addr, byte buffer[], unsigned long n)
+	{
+		waitFree();
+		setWriteEnable();
+		_select();
+		_sendCmdAddr(W25Q_PROG_PAGE,addr);
+		for(unsigned long i=0;i<n;i++)
+		{
+			if(not((addr+i) & 0xFF)) // new page
+			{
+				_deselect();
+				waitFree();
+				setWriteEnable();
+				_select();
+				_sendCmdAddr(W25Q_PROG_PAGE,addr+i);
+			}
+			SPI.transfer(buffer[i]);
+		}
+		_deselect();
+	}
+
+	void erase(unsigned long addr)
+	{
+		waitFree();
+		setWriteEnable();
+		_select();
+		_sendCmdAddr(W25Q_ERASE_SECTOR,addr);
+		_deselect();
+	}
+};
+
+unsigned g_failures = 0;
+byte g_page[W25QSIM_PAGESIZE];
+byte g_all[W25QSIM_SIZE];
+
+struct Result
+{
+	double seconds;
+	unsigned long spiBytes;
+	unsigned long statusPolls;
+	unsigned long violations;
+};
+
+template <class Flash, class Job>
+Result measure(W25QSim& sim, Flash& flash, Job job)
+{
+	sim.resetCounters();
+	SPI.hostResetCounters();
+	uint64_t start = hal::nowMicros();
+	job(flash);
+	flash.waitFree();
+	Result r = {(hal::nowMicros() - start) / 1e6, SPI.hostTransfers(),
+				sim.statusPolls(), sim.busyViolations()};
+	return r;
+}
+
+void print(const char* name, unsigned long bytes, const Result& before,
+		   const Result& after)
+{
+	printf("%-16s %8.2f s %8.1f kB/s %9lu SPI %7lu polls | "
+		   "%7.2f s %8.1f kB/s %9lu SPI %7lu polls  x%.1f\n",
+		   name, before.seconds, bytes / 1024.0 / before.seconds,
+		   before.spiBytes, before.statusPolls, after.seconds,
+		   bytes / 1024.0 / after.seconds, after.spiBytes,
+		   after.statusPolls, before.seconds / after.seconds);
+	if(before.violations or after.violations)
+	{
+		printf("  instructions ignored while busy : %lu / %lu\n",
+			   before.violations, after.violations);
+		g_failures++;
+	}
+}
+
+/*!
+ * \brief n bytes of data repeat the first period bytes of g_page.
+ */
+void check(const char* name, const byte* data, unsigned long n,
+		   unsigned long period)
+{
+	for(unsigned long i=0;i<n;i++)
+	{
+		if(data[i] != g_page[i % period])
+		{
+			printf("  %s : wrong byte at 0x%05lX\n", name, i);
+			g_failures++;
+			return;
+		}
+	}
+}
+
+template <class Flash>
+void dumpPages(Flash& flash)
+{
+	for(unsigned long a=0;a<W25QSIM_SIZE;a+=W25QSIM_PAGESIZE)
+	{
+		flash.read(a, g_all + a, W25QSIM_PAGESIZE);
+	}
+}
+
+template <class Flash>
+void dumpAll(Flash& flash)
+{
+	flash.read(0, g_all, W25QSIM_SIZE);
+}
+
+template <class Flash>
+void logPages(Flash& flash)
+{
+	for(unsigned long a=0;a<W25QSIM_SIZE;a+=W25QSIM_PAGESIZE)
+	{
+		if(a % W25QSIM_SECTORSIZE == 0) flash.erase(a);
+		flash.program(a, g_page, W25QSIM_PAGESIZE);
+	}
+}
+
+template <class Flash>
+void logRecords(Flash& flash)
+{
+	for(unsigned long a=0;a+18<=W25QSIM_SECTORSIZE*16;a+=18)
+	{
+		flash.program(a, g_page, 18);
+	}
+}
+
+}
+
+int main()
+{
+	W25QSim sim;
+	sim.setTiming(true);
+	hal::attachSpiDevice(g_pinCS, &sim);
+	ByteFlash before;
+	W25QFlash after;
+	before.setCSPin(g_pinCS);
+	after.setCSPin(g_pinCS);
+	for(unsigned i=0;i<sizeof(g_page);i++) g_page[i] = i;
+
+	printf("UNO costs, W25Q80BV typical timing (1 MByte)\n");
+	printf("%-16s %40s | %40s\n", "", "byte by byte", "W25QFlash");
+	const unsigned long recordBytes = W25QSIM_SECTORSIZE*16/18*18;
+	Result b = measure(sim, before, logPages<ByteFlash>);
+	check("log (byte by byte)", sim.data(), W25QSIM_SIZE, W25QSIM_PAGESIZE);
+	Result a = measure(sim, after, logPages<W25QFlash>);
+	check("log", sim.data(), W25QSIM_SIZE, W25QSIM_PAGESIZE);
+	print("log 256 B pages", W25QSIM_SIZE, b, a);
+	b = measure(sim, before, dumpPages<ByteFlash>);
+	check("dump (byte by byte)", g_all, W25QSIM_SIZE, W25QSIM_PAGESIZE);
+	memset(g_all, 0, sizeof(g_all));
+	a = measure(sim, after, dumpPages<W25QFlash>);
+	check("dump", g_all, W25QSIM_SIZE, W25QSIM_PAGESIZE);
+	print("dump 256 B pages", W25QSIM_SIZE, b, a);
+	memset(g_all, 0, sizeof(g_all));
+	b = measure(sim, before, dumpAll<ByteFlash>);
+	check("dump 1 read (byte by byte)", g_all, W25QSIM_SIZE,
+		  W25QSIM_PAGESIZE);
+	memset(g_all, 0, sizeof(g_all));
+	a = measure(sim, after, dumpAll<W25QFlash>);
+	check("dump 1 read", g_all, W25QSIM_SIZE, W25QSIM_PAGESIZE);
+	print("dump 1 read", W25QSIM_SIZE, b, a);
+	sim.eraseAll();
+	b = measure(sim, before, logRecords<ByteFlash>);
+	check("records (byte by byte)", sim.data(), recordBytes, 18);
+	sim.eraseAll();
+	a = measure(sim, after, logRecords<W25QFlash>);
+	check("records", sim.data(), recordBytes, 18);
+	print("18 B records", W25QSIM_SECTORSIZE*16, b, a);
+	return g_failures ? 1 : 0;
+}
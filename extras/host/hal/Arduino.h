@@ -0,0 +1,109 @@
+/*!
+ * \file Arduino.h
+ * \brief Host stand-in for the Arduino core (API of Arduino 1.0.x)
+ *
+ * Only what the Rims library and its examples use is provided.
+ * See HostHal.h for the simulation control interface.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <cmath>
+
+#include "binary.h"
+
+using std::abs;
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef unsigned int word;
+
+///\brief Clock of the UNO, set by the Arduino IDE on the command line
+#ifndef F_CPU
+	#define F_CPU 16000000L
+#endif
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+static const uint8_t A0 = 14;
+static const uint8_t A1 = 15;
+static const uint8_t A2 = 16;
+static const uint8_t A3 = 17;
+static const uint8_t A4 = 18;
+static const uint8_t A5 = 19;
+
+#define constrain(amt,low,high) \
+	((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// === PROGMEM (flat memory on host) ===
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define pgm_read_float(addr) (*(const float*)(addr))
+#define pgm_read_ptr(addr) (*(const void* const*)(addr))
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+class __FlashStringHelper;
+#define F(string_literal) \
+	(reinterpret_cast<const __FlashStringHelper*>(string_literal))
+
+// === INTERRUPTS ===
+void interrupts();
+void noInterrupts();
+#define sei() interrupts()
+#define cli() noInterrupts()
+
+// === CORE FUNCTIONS ===
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+char* dtostrf(double val, signed char width, unsigned char prec, char* sout);
+
+#include "WString.h"
+#include "HardwareSerial.h"
+#include "HostHal.h"
+#include "AvrAdc.h"
+#include "AvrSpi.h"
+#include "AvrTimer1.h"
+
+#endif
@@ -0,0 +1,105 @@
+/*!
+ * \file AvrAdc.h
+ * \brief Host stand-in for the ATmega328 ADC registers and ADC_vect
+ *
+ * Only the single conversion mode is modelled : writing ADSC starts a
+ * conversion of the ADMUX channel that ends hal::CallCosts::adcConversion
+ * µSec later on the virtual clock, sets ADIF and runs ADC_vect if ADIE
+ * is set (or as soon as interrupts are enabled again). ADIF is cleared
+ * by writing a one or by running the vector. ADC is right adjusted
+ * (ADLAR ignored) and the reference selection is ignored.
+ *
+ * State after reset is the one left by the Arduino core init() :
+ * ADEN set, prescaler at 128.
+ */
+
+#ifndef AvrAdc_h
+#define AvrAdc_h
+
+#include <stdint.h>
+
+// === ADMUX ===
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define MUX3 3
+#define MUX2 2
+#define MUX1 1
+#define MUX0 0
+
+// === ADCSRA ===
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+
+// === INTERRUPT VECTOR ===
+#define ISR(vector) extern "C" void vector(void)
+#define ADC_vect hostAdcVect
+
+extern "C" void hostAdcVect(void);
+
+namespace hal
+{
+
+/*!
+ * \brief 8 bits I/O register with side effects on write.
+ */
+class AvrRegister8
+{
+public:
+	typedef uint8_t (*Reader)();
+	typedef void (*Writer)(uint8_t);
+
+	constexpr AvrRegister8(Reader reader, Writer writer)
+	: _reader(reader), _writer(writer) {}
+
+	operator uint8_t() const { return _reader(); }
+	AvrRegister8& operator=(uint8_t value) { _writer(value); return *this; }
+	AvrRegister8& operator|=(uint8_t value)
+	{
+		_writer(_reader() | value);
+		return *this;
+	}
+	AvrRegister8& operator&=(uint8_t value)
+	{
+		_writer(_reader() & value);
+		return *this;
+	}
+
+private:
+	Reader _reader;
+	Writer _writer;
+};
+
+/*!
+ * \brief 16 bits register, read-only without writer.
+ */
+class AvrRegister16
+{
+public:
+	typedef uint16_t (*Reader)();
+	typedef void (*Writer)(uint16_t);
+
+	constexpr AvrRegister16(Reader reader, Writer writer = nullptr)
+	: _reader(reader), _writer(writer) {}
+
+	operator uint16_t() const { return _reader(); }
+	AvrRegister16& operator=(uint16_t value) { _writer(value); return *this; }
+
+private:
+	Reader _reader;
+	Writer _writer;
+};
+
+}
+
+extern hal::AvrRegister8 ADMUX;
+extern hal::AvrRegister8 ADCSRA;
+extern const hal::AvrRegister16 ADC;
+
+#endif
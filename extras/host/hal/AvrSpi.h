@@ -0,0 +1,27 @@
+/*!
+ * \file AvrSpi.h
+ * \brief Host stand-in for the ATmega328 SPI data and status registers
+ *
+ * Writing SPDR shifts one byte with the device of the SPI bus (same
+ * routing as SPI.transfer()) in hal::CallCosts::spiRegister µSec, then
+ * sets SPIF. Reading SPDR returns the byte received and clears SPIF.
+ * SPCR is not modelled : the bus is the one set by SPI.begin().
+ */
+
+#ifndef AvrSpi_h
+#define AvrSpi_h
+
+#include "AvrAdc.h"
+
+// === SPSR ===
+#define SPIF 7
+#define WCOL 6
+#define SPI2X 0
+
+#define SPDR hostSPDR
+#define SPSR hostSPSR
+
+extern hal::AvrRegister8 hostSPDR;
+extern hal::AvrRegister8 hostSPSR;
+
+#endif
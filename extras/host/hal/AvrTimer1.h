@@ -0,0 +1,47 @@
+/*!
+ * \file AvrTimer1.h
+ * \brief Host stand-in for the ATmega328 Timer1 registers and
+ *        TIMER1_COMPA_vect
+ *
+ * Only the CTC mode with OCR1A as top (WGM12) is modelled : with a
+ * clock selected by CS12:0, a compare match happens every
+ * (OCR1A+1)*prescaler/16 µSec on the virtual clock (16 MHz), sets OCF1A
+ * and runs TIMER1_COMPA_vect if OCIE1A is set (or as soon as
+ * interrupts are enabled again). OCF1A is cleared by writing a one or
+ * by running the vector. Writing TCNT1 moves the next compare match.
+ * Output compare pins are not modelled.
+ */
+
+#ifndef AvrTimer1_h
+#define AvrTimer1_h
+
+#include "AvrAdc.h"
+
+// === TCCR1A ===
+#define WGM11 1
+#define WGM10 0
+
+// === TCCR1B ===
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+
+// === TIMSK1 and TIFR1 ===
+#define OCIE1A 1
+#define OCF1A 1
+
+// === INTERRUPT VECTOR ===
+#define TIMER1_COMPA_vect hostTimer1CompaVect
+
+extern "C" void hostTimer1CompaVect(void);
+
+extern hal::AvrRegister8 TCCR1A;
+extern hal::AvrRegister8 TCCR1B;
+extern hal::AvrRegister8 TIMSK1;
+extern hal::AvrRegister8 TIFR1;
+extern hal::AvrRegister16 OCR1A;
+extern hal::AvrRegister16 TCNT1;
+
+#endif
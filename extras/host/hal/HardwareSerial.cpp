@@ -0,0 +1,140 @@
+/*!
+ * \file HardwareSerial.cpp
+ * \brief Host stand-in for the Arduino HardwareSerial class
+ */
+
+#include <stdio.h>
+
+#include "Arduino.h"
+#include "HardwareSerial.h"
+
+HardwareSerial Serial;
+
+HardwareSerial::HardwareSerial()
+: _baud(0), _lastDrain(0), _drainCredit(0), _txPending(0),
+  _blockedMicros(0), _echo(false)
+{
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+	_baud = baud;
+	_lastDrain = hal::nowMicros();
+	_drainCredit = 0;
+	_txPending = 0;
+}
+
+void HardwareSerial::end()
+{
+	flush();
+	_baud = 0;
+}
+
+/*!
+ * \brief Back to power-on state, keeping nothing sent or received.
+ */
+void HardwareSerial::hostReset()
+{
+	_baud = 0;
+	_lastDrain = _drainCredit = 0;
+	_txPending = 0;
+	_blockedMicros = 0;
+	_output.clear();
+	_input.clear();
+}
+
+/*!
+ * \brief Queue bytes on the RX line. They become available once the
+ *        virtual clock reaches atMicros.
+ */
+void HardwareSerial::hostInput(const std::string& data, uint64_t atMicros)
+{
+	for(size_t i=0;i<data.size();i++)
+	{
+		_input.push_back(std::make_pair(atMicros, data[i]));
+	}
+}
+
+int HardwareSerial::available()
+{
+	if(hal::costs().serialPoll) hal::advanceMicros(hal::costs().serialPoll);
+	int n = 0;
+	uint64_t now = hal::nowMicros();
+	for(size_t i=0;i<_input.size() and _input[i].first <= now;i++) n++;
+	return n;
+}
+
+int HardwareSerial::peek()
+{
+	if(_input.empty() or _input.front().first > hal::nowMicros()) return -1;
+	return (unsigned char)_input.front().second;
+}
+
+int HardwareSerial::read()
+{
+	int c = peek();
+	if(c >= 0) _input.pop_front();
+	return c;
+}
+
+/*!
+ * \brief Wait for the TX buffer to be sent (Arduino >= 1.0 behavior).
+ */
+void HardwareSerial::flush()
+{
+	_drain();
+	if(_txPending and _baud)
+	{
+		uint64_t byteTime = 10000000ULL / _baud;
+		uint64_t wait = _txPending * byteTime - _drainCredit;
+		_blockedMicros += wait;
+		hal::advanceMicros(wait);
+		_drain();
+	}
+}
+
+/*!
+ * \brief Free slots of the TX buffer, one kept empty as in the AVR core.
+ */
+int HardwareSerial::availableForWrite()
+{
+	_drain();
+	return SERIAL_TX_BUFFER_SIZE - 1 - _txPending;
+}
+
+/*!
+ * \brief Queue one byte in the TX buffer. Block (on the virtual clock)
+ *        until a slot is free if the buffer is full.
+ */
+size_t HardwareSerial::write(uint8_t c)
+{
+	_output.push_back((char)c);
+	if(_echo) putchar(c);
+	if(_baud == 0) return 1;
+	_drain();
+	if(_txPending >= SERIAL_TX_BUFFER_SIZE)
+	{
+		uint64_t byteTime = 10000000ULL / _baud;
+		uint64_t wait = byteTime - _drainCredit;
+		_blockedMicros += wait;
+		hal::advanceMicros(wait);
+		_drain();
+	}
+	_txPending++;
+	return 1;
+}
+
+void HardwareSerial::_drain()
+{
+	uint64_t now = hal::nowMicros();
+	if(_baud == 0) return;
+	uint64_t byteTime = 10000000ULL / _baud; // 10 bits per byte
+	_drainCredit += now - _lastDrain;
+	_lastDrain = now;
+	while(_txPending and _drainCredit >= byteTime)
+	{
+		_txPending--;
+		_drainCredit -= byteTime;
+	}
+	if(not _txPending) _drainCredit = 0;
+}
@@ -0,0 +1,63 @@
+/*!
+ * \file HardwareSerial.h
+ * \brief Host stand-in for the Arduino HardwareSerial class
+ *
+ * Transmitted bytes are captured in a string. The 64 bytes TX buffer
+ * drains at the configured baud rate on the virtual clock, so a write
+ * on a full buffer blocks like it does on the board. Received bytes
+ * are injected by the harness, optionally at a given virtual time.
+ */
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+#include "Stream.h"
+
+///\brief Hardware TX ring buffer size of the Arduino core
+#define SERIAL_TX_BUFFER_SIZE 64
+
+class HardwareSerial : public Stream
+{
+public:
+	HardwareSerial();
+
+	void begin(unsigned long baud);
+	void end();
+
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+	virtual void flush();
+	virtual size_t write(uint8_t c);
+	using Print::write;
+	virtual int availableForWrite();
+	operator bool() { return true; }
+
+	// === HOST INTERFACE ===
+	void hostReset();
+	void hostInput(const std::string& data, uint64_t atMicros = 0);
+	const std::string& hostOutput() const { return _output; }
+	void hostClearOutput() { _output.clear(); }
+	void hostEcho(bool state) { _echo = state; }
+	unsigned long hostBlockedMicros() const { return _blockedMicros; }
+
+private:
+	void _drain();
+
+	unsigned long _baud;
+	uint64_t _lastDrain;
+	uint64_t _drainCredit;
+	unsigned int _txPending;
+	unsigned long _blockedMicros;
+	bool _echo;
+	std::string _output;
+	std::deque<std::pair<uint64_t, char> > _input;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,774 @@
+/*!
+ * \file HostHal.cpp
+ * \brief Arduino core functions and simulation control of the host HAL
+ */
+
+#include <stdio.h>
+
+#include "Arduino.h"
+#include "HostHal.h"
+
+namespace
+{
+
+const hal::CallCosts g_unoCosts = {
+	112,	// analogRead
+	5,		// digitalRead
+	5,		// digitalWrite
+	2,		// timeRead
+	250,	// lcdByte (4 bits mode LiquidCrystal)
+	2000,	// lcdClear
+	2,		// spiByte
+	1,		// spiRegister (8 bits at 8 MHz, next byte loaded meanwhile)
+	2,		// serialPoll
+	104		// adcConversion (13 ADC clocks at 125 kHz)
+};
+
+///\brief ADCSRA after the Arduino core init() : ADEN, prescaler 128
+#define ADCSRAINIT 0x87
+
+struct HalState
+{
+	uint64_t now;
+	uint64_t limit;
+	hal::CallCosts costs;
+	bool interruptsOn;
+	bool inIsr;
+	unsigned long analogReads;
+	uint8_t mode[HAL_PINQTY];
+	uint8_t level[HAL_PINQTY];
+	uint8_t input[HAL_PINQTY];
+	bool inputSet[HAL_PINQTY];
+	unsigned int toneFreq[HAL_PINQTY];
+	uint64_t toneEnd[HAL_PINQTY];
+	hal::PinListener listener[HAL_PINQTY];
+	hal::SpiDevice* spiDevice[HAL_PINQTY];
+	int analogValue[HAL_ANALOGQTY];
+	hal::AnalogSource analogSource[HAL_ANALOGQTY];
+	void (*isr[HAL_INTERRUPTQTY])(void);
+	bool isrPending[HAL_INTERRUPTQTY];
+	double pulsePeriod[HAL_INTERRUPTQTY];	// µSec, 0 = no pulse train
+	double nextPulse[HAL_INTERRUPTQTY];		// µSec
+	uint8_t admux;
+	uint8_t adcsra;
+	uint16_t adcData;
+	uint8_t adcChannel;						// latched at conversion start
+	uint64_t adcDone;						// µSec, end of conversion
+	bool adcPending;						// ADC_vect waiting for sei()
+	unsigned long adcConversions;
+	uint8_t tccr1a;
+	uint8_t tccr1b;
+	uint8_t timsk1;
+	uint8_t tifr1;
+	uint16_t ocr1a;
+	double timer1Period;					// µSec, 0 = stopped
+	double timer1Next;						// µSec, next compare match
+	bool timer1Pending;						// TIMER1_COMPA_vect waiting
+	unsigned long timer1Matches;
+};
+
+HalState g_hal;
+bool g_halInitialized = false;
+
+void initState()
+{
+	g_hal.now = 0;
+	g_hal.limit = 0;
+	g_hal.costs = g_unoCosts;
+	g_hal.interruptsOn = true;
+	g_hal.inIsr = false;
+	g_hal.analogReads = 0;
+	for(int i=0;i<HAL_PINQTY;i++)
+	{
+		g_hal.mode[i] = INPUT;
+		g_hal.level[i] = LOW;
+		g_hal.input[i] = LOW;
+		g_hal.inputSet[i] = false;
+		g_hal.toneFreq[i] = 0;
+		g_hal.toneEnd[i] = 0;
+		g_hal.listener[i] = hal::PinListener();
+		g_hal.spiDevice[i] = NULL;
+	}
+	for(int i=0;i<HAL_ANALOGQTY;i++)
+	{
+		g_hal.analogValue[i] = 1023; // floating keypad / NC thermistor
+		g_hal.analogSource[i] = hal::AnalogSource();
+	}
+	for(int i=0;i<HAL_INTERRUPTQTY;i++)
+	{
+		g_hal.isr[i] = NULL;
+		g_hal.isrPending[i] = false;
+		g_hal.pulsePeriod[i] = 0;
+		g_hal.nextPulse[i] = 0;
+	}
+	g_hal.admux = 0;
+	g_hal.adcsra = ADCSRAINIT;
+	g_hal.adcData = 0;
+	g_hal.adcChannel = 0;
+	g_hal.adcDone = 0;
+	g_hal.adcPending = false;
+	g_hal.adcConversions = 0;
+	g_hal.tccr1a = g_hal.tccr1b = g_hal.timsk1 = g_hal.tifr1 = 0;
+	g_hal.ocr1a = 0;
+	g_hal.timer1Period = g_hal.timer1Next = 0;
+	g_hal.timer1Pending = false;
+	g_hal.timer1Matches = 0;
+	g_halInitialized = true;
+}
+
+HalState& state()
+{
+	if(not g_halInitialized) initState();
+	return g_hal;
+}
+
+void spend(uint32_t us)
+{
+	if(us) hal::advanceMicros(us);
+}
+
+void runPendingIsrs();
+
+void runIsr(uint8_t interruptNum)
+{
+	HalState& s = state();
+	if(s.isr[interruptNum] == NULL) return;
+	if(not s.interruptsOn or s.inIsr)
+	{
+		s.isrPending[interruptNum] = true;
+		return;
+	}
+	s.inIsr = true;
+	s.interruptsOn = false;
+	s.isr[interruptNum]();
+	s.interruptsOn = true;
+	s.inIsr = false;
+	runPendingIsrs();
+}
+
+/*!
+ * \brief ADC_vect if ADIF and ADIE are set. The vector clears ADIF.
+ */
+void runAdcIsr()
+{
+	HalState& s = state();
+	if(not (s.adcsra & (1 << ADIF)) or not (s.adcsra & (1 << ADIE))) return;
+	if(not s.interruptsOn or s.inIsr)
+	{
+		s.adcPending = true;
+		return;
+	}
+	s.adcPending = false;
+	s.adcsra &= ~(1 << ADIF);
+	s.inIsr = true;
+	s.interruptsOn = false;
+	hostAdcVect();
+	s.interruptsOn = true;
+	s.inIsr = false;
+	runPendingIsrs();
+}
+
+/*!
+ * \brief TIMER1_COMPA_vect if OCF1A and OCIE1A are set. The vector
+ *        clears OCF1A.
+ */
+void runTimer1Isr()
+{
+	HalState& s = state();
+	if(not (s.tifr1 & (1 << OCF1A)) or not (s.timsk1 & (1 << OCIE1A))) return;
+	if(not s.interruptsOn or s.inIsr)
+	{
+		s.timer1Pending = true;
+		return;
+	}
+	s.timer1Pending = false;
+	s.tifr1 &= ~(1 << OCF1A);
+	s.inIsr = true;
+	s.interruptsOn = false;
+	hostTimer1CompaVect();
+	s.interruptsOn = true;
+	s.inIsr = false;
+	runPendingIsrs();
+}
+
+/*!
+ * \brief Interrupts that were flagged while disabled, as after reti
+ *        or sei().
+ */
+void runPendingIsrs()
+{
+	HalState& s = state();
+	if(s.inIsr or not s.interruptsOn) return;
+	for(uint8_t i=0;i<HAL_INTERRUPTQTY;i++)
+	{
+		if(s.isrPending[i])
+		{
+			s.isrPending[i] = false;
+			runIsr(i);
+		}
+	}
+	if(s.adcPending) runAdcIsr();
+	if(s.timer1Pending) runTimer1Isr();
+}
+
+int analogValue(uint8_t channel)
+{
+	HalState& s = state();
+	int value = s.analogValue[channel];
+	if(s.analogSource[channel]) value = s.analogSource[channel]();
+	return constrain(value,0,1023);
+}
+
+void completeConversion()
+{
+	HalState& s = state();
+	s.adcData = (s.adcChannel < HAL_ANALOGQTY) ? analogValue(s.adcChannel)
+	                                           : 0;
+	s.adcConversions++;
+	s.adcsra &= ~(1 << ADSC);
+	s.adcsra |= (1 << ADIF);
+	runAdcIsr();
+}
+
+uint8_t readAdmux()
+{
+	return state().admux;
+}
+
+void writeAdmux(uint8_t value)
+{
+	state().admux = value;
+}
+
+/*!
+ * \brief Reading ADCSRA costs 1 µSec so that polling ADSC ends.
+ */
+uint8_t readAdcsra()
+{
+	spend(1);
+	return state().adcsra;
+}
+
+void writeAdcsra(uint8_t value)
+{
+	HalState& s = state();
+	uint8_t busy = s.adcsra & (1 << ADSC);
+	uint8_t flag = (value & (1 << ADIF)) ? 0 : (s.adcsra & (1 << ADIF));
+	s.adcsra = (value & ~((1 << ADIF) | (1 << ADSC))) | flag | busy;
+	if(not (s.adcsra & (1 << ADEN))) s.adcsra &= ~(1 << ADSC); // abort
+	else if((value & (1 << ADSC)) and not busy)
+	{
+		s.adcsra |= (1 << ADSC);
+		s.adcChannel = s.admux & 0x07;
+		s.adcDone = s.now + s.costs.adcConversion;
+	}
+	runAdcIsr();
+}
+
+uint16_t readAdc()
+{
+	return state().adcData;
+}
+
+/*!
+ * \brief Timer1 tick [µSec] of the CS12:0 clock select, 0 if stopped
+ *        (or external clock).
+ */
+double timer1Tick()
+{
+	static const double ticks[8] = {0, 1/16.0, 8/16.0, 64/16.0, 256/16.0,
+	                                1024/16.0, 0, 0};
+	return ticks[state().tccr1b & 0x07];
+}
+
+/*!
+ * \brief Counter value, 0 to OCR1A, deduced from the next compare match.
+ */
+uint16_t readTcnt1()
+{
+	HalState& s = state();
+	if(s.timer1Period == 0) return 0;
+	long count = s.ocr1a + 1 - (long)ceil((s.timer1Next - s.now) / timer1Tick());
+	return (count < 0) ? 0 : (uint16_t)count;
+}
+
+/*!
+ * \brief Schedule the next compare match from a counter value. Only
+ *        CTC mode 4 (top OCR1A) runs.
+ */
+void writeTcnt1(uint16_t value)
+{
+	HalState& s = state();
+	bool ctc = (s.tccr1b & ((1 << WGM13) | (1 << WGM12))) == (1 << WGM12) \
+	           and not (s.tccr1a & ((1 << WGM11) | (1 << WGM10)));
+	double tick = timer1Tick();
+	if(not ctc or tick == 0)
+	{
+		s.timer1Period = 0;
+		return;
+	}
+	s.timer1Period = (s.ocr1a + 1) * tick;
+	s.timer1Next = s.now + ((value <= s.ocr1a) ? s.ocr1a - value + 1
+	                                           : 65536 - value + s.ocr1a + 1) \
+	                       * tick;
+}
+
+uint8_t readTccr1a()
+{
+	return state().tccr1a;
+}
+
+void writeTccr1a(uint8_t value)
+{
+	uint16_t count = readTcnt1();
+	state().tccr1a = value;
+	writeTcnt1(count);
+}
+
+uint8_t readTccr1b()
+{
+	return state().tccr1b;
+}
+
+void writeTccr1b(uint8_t value)
+{
+	uint16_t count = readTcnt1();
+	state().tccr1b = value;
+	writeTcnt1(count);
+}
+
+uint8_t readTimsk1()
+{
+	return state().timsk1;
+}
+
+void writeTimsk1(uint8_t value)
+{
+	state().timsk1 = value;
+	runTimer1Isr();
+}
+
+uint8_t readTifr1()
+{
+	return state().tifr1;
+}
+
+void writeTifr1(uint8_t value)
+{
+	state().tifr1 &= ~value;
+	if(not (state().tifr1 & (1 << OCF1A))) state().timer1Pending = false;
+}
+
+uint16_t readOcr1a()
+{
+	return state().ocr1a;
+}
+
+void writeOcr1a(uint16_t value)
+{
+	uint16_t count = readTcnt1();
+	state().ocr1a = value;
+	writeTcnt1(count);
+}
+
+void timer1Match()
+{
+	HalState& s = state();
+	s.timer1Matches++;
+	s.tifr1 |= (1 << OCF1A);
+	runTimer1Isr();
+}
+
+}
+
+/*
+============================================================
+Simulation control
+============================================================
+*/
+namespace hal
+{
+
+/*!
+ * \brief Back to power-on state : time 0, default costs, no sources,
+ *        no listeners, no devices, no ISR.
+ */
+void reset()
+{
+	initState();
+	Serial.hostReset();
+}
+
+/*!
+ * \brief Virtual time spent by each HAL call. Modifiable.
+ */
+CallCosts& costs()
+{
+	return state().costs;
+}
+
+/*!
+ * \brief Costs suited for long process simulations.
+ *
+ * LCD, SPI and serial polling are free. ADC conversions, clock reads
+ * and pin writes are made expensive so that one Rims::_iterate() or
+ * RimsIdent::_iterate() pass moves the clock by 1 to 4 mSec : with the
+ * thermistor and keypad converted by AdcScan, a pass mostly pays for
+ * its millis() reads. That is still fine for a 5 sec SSR window and
+ * keeps a 90 min mash to a few million loop passes.
+ */
+void setFastCosts()
+{
+	CallCosts& c = costs();
+	c.analogRead = 1000;
+	c.adcConversion = 5000;
+	c.timeRead = 1000;
+	c.digitalWrite = 250;
+	c.digitalRead = 0;
+	c.lcdByte = c.lcdClear = c.spiByte = c.spiRegister = c.serialPoll = 0;
+}
+
+/*!
+ * \brief Throw hal::TimeLimitReached once virtual time reaches
+ *        limitMicros. 0 disables the limit.
+ */
+void setTimeLimit(uint64_t limitMicros)
+{
+	state().limit = limitMicros;
+}
+
+uint64_t nowMicros()
+{
+	return state().now;
+}
+
+void advanceMicros(uint64_t us)
+{
+	advanceTo(state().now + us);
+}
+
+/*!
+ * \brief Move the virtual clock to timeMicros, firing every scheduled
+ *        interrupt pulse and ending ADC conversions on its way.
+ */
+void advanceTo(uint64_t timeMicros)
+{
+	HalState& s = state();
+	if(timeMicros < s.now) return;
+	while(true)
+	{
+		bool pulseFound = false;
+		uint8_t first = 0;
+		for(uint8_t i=0;i<HAL_INTERRUPTQTY;i++)
+		{
+			if(s.pulsePeriod[i] > 0 and s.nextPulse[i] <= timeMicros and \
+			   (not pulseFound or s.nextPulse[i] < s.nextPulse[first]))
+			{
+				pulseFound = true;
+				first = i;
+			}
+		}
+		bool adcDone = (s.adcsra & (1 << ADSC)) and \
+		               s.adcDone <= timeMicros and \
+		               (not pulseFound or s.adcDone <= s.nextPulse[first]);
+		bool timer1Due = s.timer1Period > 0 and \
+		                   s.timer1Next <= timeMicros and \
+		                   (not adcDone or s.timer1Next < s.adcDone) and \
+		                   (not pulseFound or s.timer1Next < s.nextPulse[first]);
+		if(timer1Due)
+		{
+			if(s.timer1Next > s.now) s.now = (uint64_t)s.timer1Next;
+			s.timer1Next += s.timer1Period;
+			timer1Match();
+		}
+		else if(adcDone)
+		{
+			if(s.adcDone > s.now) s.now = s.adcDone;
+			completeConversion();
+		}
+		else if(pulseFound)
+		{
+			if(s.nextPulse[first] > s.now) s.now = s.nextPulse[first];
+			s.nextPulse[first] += s.pulsePeriod[first];
+			runIsr(first);
+		}
+		else break;
+	}
+	if(s.now < timeMicros) s.now = timeMicros;
+	if(s.limit and s.now >= s.limit and not s.inIsr) throw TimeLimitReached();
+}
+
+void setAnalogValue(uint8_t pin, int value)
+{
+	uint8_t channel = (pin >= A0) ? pin - A0 : pin;
+	state().analogValue[channel] = constrain(value,0,1023);
+	state().analogSource[channel] = AnalogSource();
+}
+
+/*!
+ * \brief Analog channel value computed at each analogRead() call.
+ *        Used to plug a process simulator or a keypad script.
+ */
+void setAnalogSource(uint8_t pin, AnalogSource source)
+{
+	uint8_t channel = (pin >= A0) ? pin - A0 : pin;
+	state().analogSource[channel] = source;
+}
+
+void setDigitalInput(uint8_t pin, uint8_t level)
+{
+	state().input[pin] = level;
+	state().inputSet[pin] = true;
+}
+
+uint8_t pinLevel(uint8_t pin)
+{
+	return state().level[pin];
+}
+
+uint8_t pinModeOf(uint8_t pin)
+{
+	return state().mode[pin];
+}
+
+/*!
+ * \brief Called on every digitalWrite() on pin, with the written level.
+ */
+void onPinWrite(uint8_t pin, PinListener listener)
+{
+	state().listener[pin] = listener;
+}
+
+unsigned int toneFrequency(uint8_t pin)
+{
+	HalState& s = state();
+	if(s.toneEnd[pin] and s.now >= s.toneEnd[pin]) s.toneFreq[pin] = 0;
+	return s.toneFreq[pin];
+}
+
+unsigned long analogReadCount()
+{
+	return state().analogReads;
+}
+
+/*!
+ * \brief Timer1 compare matches (see AvrTimer1.h).
+ */
+unsigned long timer1MatchCount()
+{
+	return state().timer1Matches;
+}
+
+/*!
+ * \brief Conversions started through the ADC registers (not by
+ *        analogRead()).
+ */
+unsigned long adcConversionCount()
+{
+	return state().adcConversions;
+}
+
+/*!
+ * \brief Fire the ISR attached to interruptNum now.
+ */
+void triggerInterrupt(uint8_t interruptNum)
+{
+	runIsr(interruptNum);
+}
+
+/*!
+ * \brief Fire the ISR attached to interruptNum periodically on the
+ *        virtual clock (flow sensor pulse train). 0 stops the train.
+ */
+void setInterruptFrequency(uint8_t interruptNum, double freqHz)
+{
+	HalState& s = state();
+	if(freqHz <= 0) s.pulsePeriod[interruptNum] = 0;
+	else
+	{
+		double period = 1e6 / freqHz;
+		if(s.pulsePeriod[interruptNum] == 0)
+		{
+			s.nextPulse[interruptNum] = s.now + period;
+		}
+		s.pulsePeriod[interruptNum] = period;
+	}
+}
+
+/*!
+ * \brief Connect an SPI device with chip select on csPin.
+ */
+void attachSpiDevice(uint8_t csPin, SpiDevice* device)
+{
+	state().spiDevice[csPin] = device;
+}
+
+SpiDevice* selectedSpiDevice()
+{
+	HalState& s = state();
+	for(int i=0;i<HAL_PINQTY;i++)
+	{
+		if(s.spiDevice[i] != NULL and s.mode[i] == OUTPUT and \
+		   s.level[i] == LOW) return s.spiDevice[i];
+	}
+	return NULL;
+}
+
+/*!
+ * \brief ADC value of the DFRobot LCD keypad shield for a key code
+ *        (KEYNONE=0, KEYUP=1, KEYDOWN=2, KEYLEFT=3, KEYRIGHT=4,
+ *        KEYSELECT=5 in UIRims.h).
+ */
+int keyADCValue(uint8_t key)
+{
+	static const int values[6] = {1023, 99, 255, 409, 0, 639};
+	return (key < 6) ? values[key] : 1023;
+}
+
+}
+
+/*
+============================================================
+Arduino core
+============================================================
+*/
+void interrupts()
+{
+	HalState& s = state();
+	if(s.inIsr) return;
+	s.interruptsOn = true;
+	runPendingIsrs();
+}
+
+void noInterrupts()
+{
+	if(not state().inIsr) state().interruptsOn = false;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	if(pin >= HAL_PINQTY) return;
+	HalState& s = state();
+	s.mode[pin] = (mode == INPUT_PULLUP) ? INPUT : mode;
+	if(mode == INPUT_PULLUP and not s.inputSet[pin]) s.input[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+	if(pin >= HAL_PINQTY) return;
+	HalState& s = state();
+	spend(s.costs.digitalWrite);
+	uint8_t level = val ? HIGH : LOW;
+	uint8_t lastLevel = s.level[pin];
+	s.level[pin] = level;
+	if(s.spiDevice[pin] != NULL and level != lastLevel)
+	{
+		(level == LOW) ? s.spiDevice[pin]->select() :
+		                 s.spiDevice[pin]->deselect();
+	}
+	if(s.listener[pin]) s.listener[pin](level);
+}
+
+int digitalRead(uint8_t pin)
+{
+	if(pin >= HAL_PINQTY) return LOW;
+	HalState& s = state();
+	spend(s.costs.digitalRead);
+	return (s.mode[pin] == OUTPUT) ? s.level[pin] : s.input[pin];
+}
+
+int analogRead(uint8_t pin)
+{
+	HalState& s = state();
+	uint8_t channel = (pin >= A0) ? pin - A0 : pin;
+	if(channel >= HAL_ANALOGQTY) return 0;
+	spend(s.costs.analogRead);
+	s.analogReads++;
+	return analogValue(channel);
+}
+
+unsigned long millis(void)
+{
+	spend(state().costs.timeRead);
+	return (unsigned long)(state().now / 1000);
+}
+
+unsigned long micros(void)
+{
+	spend(state().costs.timeRead);
+	return (unsigned long)state().now;
+}
+
+void delay(unsigned long ms)
+{
+	hal::advanceMicros((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	hal::advanceMicros(us);
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
+{
+	if(interruptNum < HAL_INTERRUPTQTY) state().isr[interruptNum] = userFunc;
+}
+
+void detachInterrupt(uint8_t interruptNum)
+{
+	if(interruptNum < HAL_INTERRUPTQTY) state().isr[interruptNum] = NULL;
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+	if(pin >= HAL_PINQTY) return;
+	HalState& s = state();
+	s.toneFreq[pin] = frequency;
+	s.toneEnd[pin] = duration ? s.now + (uint64_t)duration * 1000 : 0;
+}
+
+void noTone(uint8_t pin)
+{
+	if(pin < HAL_PINQTY) state().toneFreq[pin] = 0;
+}
+
+char* dtostrf(double val, signed char width, unsigned char prec, char* sout)
+{
+	sprintf(sout, "%*.*f", width, prec, val);
+	return sout;
+}
+
+/*
+============================================================
+ATmega328 ADC registers
+============================================================
+*/
+hal::AvrRegister8 ADMUX(readAdmux, writeAdmux);
+hal::AvrRegister8 ADCSRA(readAdcsra, writeAdcsra);
+const hal::AvrRegister16 ADC(readAdc);
+
+/*!
+ * \brief Default ADC_vect, replaced by a sketch or library ISR(ADC_vect).
+ */
+extern "C" void __attribute__((weak)) hostAdcVect(void)
+{
+}
+
+/*
+============================================================
+ATmega328 Timer1 registers
+============================================================
+*/
+hal::AvrRegister8 TCCR1A(readTccr1a, writeTccr1a);
+hal::AvrRegister8 TCCR1B(readTccr1b, writeTccr1b);
+hal::AvrRegister8 TIMSK1(readTimsk1, writeTimsk1);
+hal::AvrRegister8 TIFR1(readTifr1, writeTifr1);
+hal::AvrRegister16 OCR1A(readOcr1a, writeOcr1a);
+hal::AvrRegister16 TCNT1(readTcnt1, writeTcnt1);
+
+/*!
+ * \brief Default TIMER1_COMPA_vect, replaced by ISR(TIMER1_COMPA_vect).
+ */
+extern "C" void __attribute__((weak)) hostTimer1CompaVect(void)
+{
+}
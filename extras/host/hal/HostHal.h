@@ -0,0 +1,117 @@
+/*!
+ * \file HostHal.h
+ * \brief Control interface of the host (Linux) Arduino HAL stand-in
+ *
+ * The host HAL replaces the Arduino core so the Rims library can be
+ * compiled unmodified on a PC. Everything runs on a virtual clock :
+ * millis() and micros() only move forward when a HAL call is made
+ * (each call costs the time it would roughly take on an ATmega328 at
+ * 16 MHz, see hal::CallCosts) or when the harness calls
+ * hal::advanceMicros(). Analog inputs, digital inputs, interrupts and
+ * SPI devices are scripted from the harness through this interface.
+ */
+
+#ifndef HostHal_h
+#define HostHal_h
+
+#include <stdint.h>
+#include <functional>
+#include <stdexcept>
+
+namespace hal
+{
+
+///\brief Number of digital pins (Arduino UNO : 0-13 + A0-A5)
+#define HAL_PINQTY 20
+///\brief Number of external interrupts
+#define HAL_INTERRUPTQTY 2
+///\brief Analog channel count
+#define HAL_ANALOGQTY 6
+
+/*!
+ * \brief Virtual time spent by each HAL call [µSec]
+ *
+ * Defaults approximate an Arduino UNO. A harness that only cares about
+ * the process (not about loop timing) can raise them to make long
+ * simulations cheaper.
+ */
+struct CallCosts
+{
+	uint32_t analogRead;	///< one ADC conversion
+	uint32_t digitalRead;
+	uint32_t digitalWrite;
+	uint32_t timeRead;		///< millis() or micros()
+	uint32_t lcdByte;		///< one HD44780 data or command byte
+	uint32_t lcdClear;		///< extra time for clear() and home()
+	uint32_t spiByte;		///< one SPI.transfer() at SPI_CLOCK_DIV2
+	uint32_t spiRegister;	///< one byte written in SPDR (AvrSpi.h)
+	uint32_t serialPoll;	///< Serial.available(), Serial.read()
+	uint32_t adcConversion;	///< conversion started with ADSC (AvrAdc.h)
+};
+
+/*!
+ * \brief Thrown when virtual time reaches the limit set with
+ *        setTimeLimit(). Lets a harness end a sketch that never
+ *        returns (blocking dialogs, loop()).
+ */
+class TimeLimitReached : public std::runtime_error
+{
+public:
+	TimeLimitReached() : std::runtime_error("virtual time limit reached") {}
+};
+
+/*!
+ * \brief Device connected on the SPI bus.
+ *
+ * select()/deselect() follow the level written on the chip select pin
+ * given to attachSpiDevice().
+ */
+class SpiDevice
+{
+public:
+	virtual ~SpiDevice() {}
+	virtual void select() = 0;
+	virtual void deselect() = 0;
+	virtual uint8_t transfer(uint8_t data) = 0;
+};
+
+typedef std::function<int()> AnalogSource;
+typedef std::function<void(uint8_t level)> PinListener;
+
+// === SIMULATION CONTROL ===
+void reset();
+CallCosts& costs();
+void setFastCosts();
+void setTimeLimit(uint64_t limitMicros);
+
+// === VIRTUAL CLOCK ===
+uint64_t nowMicros();
+void advanceMicros(uint64_t us);
+void advanceTo(uint64_t timeMicros);
+
+// === PINS ===
+void setAnalogValue(uint8_t pin, int value);
+void setAnalogSource(uint8_t pin, AnalogSource source);
+void setDigitalInput(uint8_t pin, uint8_t level);
+uint8_t pinLevel(uint8_t pin);
+uint8_t pinModeOf(uint8_t pin);
+void onPinWrite(uint8_t pin, PinListener listener);
+unsigned int toneFrequency(uint8_t pin);
+unsigned long analogReadCount();
+unsigned long adcConversionCount();
+unsigned long timer1MatchCount();
+
+// === INTERRUPTS ===
+void triggerInterrupt(uint8_t interruptNum);
+void setInterruptFrequency(uint8_t interruptNum, double freqHz);
+
+// === SPI ===
+void attachSpiDevice(uint8_t csPin, SpiDevice* device);
+SpiDevice* selectedSpiDevice();
+
+// === KEYPAD (DFRobot LCD keypad shield divider) ===
+int keyADCValue(uint8_t key);
+
+}
+
+#endif
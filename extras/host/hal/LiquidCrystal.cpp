@@ -0,0 +1,117 @@
+/*!
+ * \file LiquidCrystal.cpp
+ * \brief Host stand-in for the Arduino LiquidCrystal library
+ */
+
+#include "Arduino.h"
+#include "LiquidCrystal.h"
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable,
+							 uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
+: _cols(16), _rows(2), _addr(0), _display(true), _blink(false),
+  _cursor(false), _dataBytes(0), _commandBytes(0)
+{
+	memset(_ddram, ' ', sizeof(_ddram));
+	memset(_cgram, 0, sizeof(_cgram));
+}
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
+							 uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
+: _cols(16), _rows(2), _addr(0), _display(true), _blink(false),
+  _cursor(false), _dataBytes(0), _commandBytes(0)
+{
+	memset(_ddram, ' ', sizeof(_ddram));
+	memset(_cgram, 0, sizeof(_cgram));
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows)
+{
+	_cols = cols;
+	_rows = rows;
+	_command(50000); // power-on delays of the real library
+	clear();
+}
+
+void LiquidCrystal::clear()
+{
+	_command(hal::costs().lcdClear);
+	memset(_ddram, ' ', sizeof(_ddram));
+	_addr = 0;
+}
+
+void LiquidCrystal::home()
+{
+	_command(hal::costs().lcdClear);
+	_addr = 0;
+}
+
+void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[])
+{
+	location &= 0x7;
+	_command();
+	for(int i=0;i<8;i++)
+	{
+		_cgram[location][i] = charmap[i];
+		_dataBytes++;
+		hal::advanceMicros(hal::costs().lcdByte);
+	}
+}
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row)
+{
+	_command();
+	if(row >= _rows) row = _rows - 1;
+	_addr = (row % 2) * HD44780_LINELENGTH + (col % HD44780_LINELENGTH);
+}
+
+size_t LiquidCrystal::write(uint8_t value)
+{
+	_dataBytes++;
+	hal::advanceMicros(hal::costs().lcdByte);
+	_ddram[_addr] = (char)value;
+	_addr = (_addr + 1) % (2 * HD44780_LINELENGTH);
+	return 1;
+}
+
+/*!
+ * \brief Character at col,row. Custom characters 0-7 are returned as
+ *        their code.
+ */
+char LiquidCrystal::hostCell(uint8_t col, uint8_t row) const
+{
+	return _ddram[(row % 2) * HD44780_LINELENGTH + col];
+}
+
+/*!
+ * \brief Visible part of a line, custom characters rendered as
+ *        '0'+code and 0xDF (degree sign) as '*'.
+ */
+std::string LiquidCrystal::hostLine(uint8_t row) const
+{
+	std::string line;
+	for(uint8_t col=0;col<_cols;col++)
+	{
+		unsigned char c = hostCell(col,row);
+		if(c < 8) line += (char)('0' + c);
+		else if(c == 0xDF) line += '*';
+		else if(c == 0x7E) line += '>';
+		else line += (char)c;
+	}
+	return line;
+}
+
+std::string LiquidCrystal::hostRender() const
+{
+	std::string res;
+	for(uint8_t row=0;row<_rows;row++)
+	{
+		res += '|' + hostLine(row) + "|\n";
+	}
+	return res;
+}
+
+void LiquidCrystal::_command(uint32_t extraCost)
+{
+	_commandBytes++;
+	hal::advanceMicros(hal::costs().lcdByte + extraCost);
+}
@@ -0,0 +1,70 @@
+/*!
+ * \file LiquidCrystal.h
+ * \brief Host stand-in for the Arduino LiquidCrystal library
+ *
+ * Models the HD44780 display RAM of a 2 lines display (40 cells per
+ * line, LCDCOLUMNS visible) in memory. Every byte sent to the
+ * controller costs hal::CallCosts::lcdByte on the virtual clock and is
+ * counted, so a harness can measure the UI traffic.
+ */
+
+#ifndef LiquidCrystal_h
+#define LiquidCrystal_h
+
+#include <stdint.h>
+#include <string>
+
+#include "Print.h"
+
+///\brief HD44780 display RAM cells per line
+#define HD44780_LINELENGTH 40
+
+class LiquidCrystal : public Print
+{
+public:
+	LiquidCrystal(uint8_t rs, uint8_t enable,
+				  uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+	LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
+				  uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+
+	void begin(uint8_t cols, uint8_t rows);
+	void clear();
+	void home();
+	void noDisplay() { _command(); _display = false; }
+	void display() { _command(); _display = true; }
+	void noBlink() { _command(); _blink = false; }
+	void blink() { _command(); _blink = true; }
+	void noCursor() { _command(); _cursor = false; }
+	void cursor() { _command(); _cursor = true; }
+	void createChar(uint8_t location, uint8_t charmap[]);
+	void setCursor(uint8_t col, uint8_t row);
+	virtual size_t write(uint8_t value);
+	using Print::write;
+
+	// === HOST INTERFACE ===
+	char hostCell(uint8_t col, uint8_t row) const;
+	std::string hostLine(uint8_t row) const;
+	std::string hostRender() const;
+	bool hostBlink() const { return _blink; }
+	uint8_t hostCursorCol() const { return _addr % HD44780_LINELENGTH; }
+	uint8_t hostCursorRow() const { return _addr / HD44780_LINELENGTH; }
+	unsigned long hostDataBytes() const { return _dataBytes; }
+	unsigned long hostCommandBytes() const { return _commandBytes; }
+	void hostResetCounters() { _dataBytes = _commandBytes = 0; }
+
+private:
+	void _command(uint32_t extraCost = 0);
+
+	uint8_t _cols;
+	uint8_t _rows;
+	uint8_t _addr;
+	bool _display;
+	bool _blink;
+	bool _cursor;
+	char _ddram[2 * HD44780_LINELENGTH];
+	uint8_t _cgram[8][8];
+	unsigned long _dataBytes;
+	unsigned long _commandBytes;
+};
+
+#endif
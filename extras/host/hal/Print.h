@@ -0,0 +1,56 @@
+/*!
+ * \file Print.h
+ * \brief Host stand-in for the Arduino Print class
+ *
+ * Number formatting follows Arduino 1.0.x Print.cpp so captured
+ * serial output matches what the board sends.
+ */
+
+#ifndef Print_h
+#define Print_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "WString.h"
+
+class __FlashStringHelper;
+
+class Print
+{
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t) = 0;
+	size_t write(const char* str);
+	virtual size_t write(const uint8_t* buffer, size_t size);
+
+	size_t print(const __FlashStringHelper* ifsh);
+	size_t print(const String& s);
+	size_t print(const char str[]);
+	size_t print(char c);
+	size_t print(unsigned char b, int base = 10);
+	size_t print(int n, int base = 10);
+	size_t print(unsigned int n, int base = 10);
+	size_t print(long n, int base = 10);
+	size_t print(unsigned long n, int base = 10);
+	size_t print(double n, int digits = 2);
+
+	size_t println(const __FlashStringHelper* ifsh);
+	size_t println(const String& s);
+	size_t println(const char str[]);
+	size_t println(char c);
+	size_t println(unsigned char b, int base = 10);
+	size_t println(int n, int base = 10);
+	size_t println(unsigned int n, int base = 10);
+	size_t println(long n, int base = 10);
+	size_t println(unsigned long n, int base = 10);
+	size_t println(double n, int digits = 2);
+	size_t println(void);
+
+private:
+	size_t _printNumber(unsigned long n, uint8_t base);
+	size_t _printFloat(double number, uint8_t digits);
+};
+
+#endif
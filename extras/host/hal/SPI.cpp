@@ -0,0 +1,70 @@
+/*!
+ * \file SPI.cpp
+ * \brief Host stand-in for the Arduino SPI library
+ */
+
+#include "Arduino.h"
+#include "SPI.h"
+
+SPIClass SPI;
+
+namespace
+{
+unsigned long g_spiTransfers = 0;
+uint8_t g_spdr = 0xFF;
+uint8_t g_spsr = 0;
+
+uint8_t shift(uint8_t data)
+{
+	g_spiTransfers++;
+	hal::SpiDevice* device = hal::selectedSpiDevice();
+	return (device != NULL) ? device->transfer(data) : 0xFF;
+}
+
+uint8_t readSpdr()
+{
+	g_spsr &= ~(1 << SPIF);
+	return g_spdr;
+}
+
+void writeSpdr(uint8_t value)
+{
+	hal::advanceMicros(hal::costs().spiRegister);
+	g_spdr = shift(value);
+	g_spsr |= (1 << SPIF);
+}
+
+uint8_t readSpsr()
+{
+	return g_spsr;
+}
+
+void writeSpsr(uint8_t value)
+{
+	g_spsr = (g_spsr & (1 << SPIF)) | (value & (1 << SPI2X));
+}
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+	hal::advanceMicros(hal::costs().spiByte);
+	return shift(data);
+}
+
+unsigned long SPIClass::hostTransfers()
+{
+	return g_spiTransfers;
+}
+
+void SPIClass::hostResetCounters()
+{
+	g_spiTransfers = 0;
+}
+
+/*
+============================================================
+ATmega328 SPI registers
+============================================================
+*/
+hal::AvrRegister8 hostSPDR(readSpdr, writeSpdr);
+hal::AvrRegister8 hostSPSR(readSpsr, writeSpsr);
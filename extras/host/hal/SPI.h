@@ -0,0 +1,46 @@
+/*!
+ * \file SPI.h
+ * \brief Host stand-in for the Arduino SPI library
+ *
+ * Transfers are routed to the hal::SpiDevice whose chip select pin is
+ * currently LOW. With no device selected, the bus reads 0xFF. Bytes
+ * written in SPDR (AvrSpi.h) take the same route and are counted by
+ * hostTransfers() too.
+ */
+
+#ifndef SPI_h
+#define SPI_h
+
+#include <stdint.h>
+
+#define SPI_CLOCK_DIV4 0x00
+#define SPI_CLOCK_DIV16 0x01
+#define SPI_CLOCK_DIV64 0x02
+#define SPI_CLOCK_DIV128 0x03
+#define SPI_CLOCK_DIV2 0x04
+#define SPI_CLOCK_DIV8 0x05
+#define SPI_CLOCK_DIV32 0x06
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPIClass
+{
+public:
+	static uint8_t transfer(uint8_t data);
+	static void begin() {}
+	static void end() {}
+	static void setBitOrder(uint8_t) {}
+	static void setDataMode(uint8_t) {}
+	static void setClockDivider(uint8_t) {}
+
+	// === HOST INTERFACE ===
+	static unsigned long hostTransfers();
+	static void hostResetCounters();
+};
+
+extern SPIClass SPI;
+
+#endif
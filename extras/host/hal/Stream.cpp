@@ -0,0 +1,102 @@
+/*!
+ * \file Stream.cpp
+ * \brief Host stand-in for the Arduino Stream class (subset)
+ */
+
+#include "Arduino.h"
+#include "Stream.h"
+
+int Stream::_timedRead()
+{
+	unsigned long startMillis = millis();
+	do
+	{
+		if(available()) return read();
+		hal::advanceMicros(100);
+	}
+	while(millis() - startMillis < _timeout);
+	return -1;
+}
+
+int Stream::_timedPeek()
+{
+	unsigned long startMillis = millis();
+	do
+	{
+		if(available()) return peek();
+		hal::advanceMicros(100);
+	}
+	while(millis() - startMillis < _timeout);
+	return -1;
+}
+
+int Stream::_peekNextDigit()
+{
+	int c;
+	while(true)
+	{
+		c = _timedPeek();
+		if(c < 0) return c;
+		if(c == '-') return c;
+		if(c >= '0' and c <= '9') return c;
+		read();
+	}
+}
+
+/*!
+ * \brief Same behavior as Arduino 1.0.x : skip non digits, return
+ *        0 on timeout.
+ */
+long Stream::parseInt()
+{
+	bool isNegative = false;
+	long value = 0;
+	int c = _peekNextDigit();
+	if(c < 0) return 0;
+	do
+	{
+		if(c == '-') isNegative = true;
+		else if(c >= '0' and c <= '9') value = value * 10 + c - '0';
+		read();
+		c = _timedPeek();
+	}
+	while((c >= '0' and c <= '9') or c == '-');
+	return isNegative ? -value : value;
+}
+
+float Stream::parseFloat()
+{
+	bool isNegative = false, isFraction = false;
+	long value = 0;
+	float fraction = 1.0;
+	int c = _peekNextDigit();
+	if(c < 0) return 0;
+	do
+	{
+		if(c == '-') isNegative = true;
+		else if(c == '.') isFraction = true;
+		else if(c >= '0' and c <= '9')
+		{
+			value = value * 10 + c - '0';
+			if(isFraction) fraction *= 0.1;
+		}
+		read();
+		c = _timedPeek();
+	}
+	while((c >= '0' and c <= '9') or c == '.' or c == '-');
+	if(isNegative) value = -value;
+	return isFraction ? value * fraction : value;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length)
+{
+	size_t count = 0;
+	while(count < length)
+	{
+		int c = _timedRead();
+		if(c < 0) break;
+		*buffer++ = (char)c;
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,34 @@
+/*!
+ * \file Stream.h
+ * \brief Host stand-in for the Arduino Stream class (subset)
+ */
+
+#ifndef Stream_h
+#define Stream_h
+
+#include "Print.h"
+
+class Stream : public Print
+{
+public:
+	Stream() : _timeout(1000) {}
+
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	virtual void flush() = 0;
+
+	void setTimeout(unsigned long timeout) { _timeout = timeout; }
+	long parseInt();
+	float parseFloat();
+	size_t readBytes(char* buffer, size_t length);
+
+protected:
+	int _timedRead();
+	int _timedPeek();
+	int _peekNextDigit();
+
+	unsigned long _timeout;
+};
+
+#endif
@@ -0,0 +1,160 @@
+/*!
+ * \file W25QSim.cpp
+ * \brief Simulated Winbond W25Q80BV SPI flash for the host HAL
+ */
+
+#include <string.h>
+
+#include "W25QSim.h"
+
+#define SIM_READID   0x90
+#define SIM_WEN      0x06
+#define SIM_WDI      0x04
+#define SIM_READ     0x03
+#define SIM_FASTREAD 0x0B
+#define SIM_PROG     0x02
+#define SIM_ERASE4K  0x20
+#define SIM_ERASE32K 0x52
+#define SIM_ERASE64K 0xD8
+#define SIM_ERASECHIP 0xC7
+#define SIM_SR_READ1 0x05
+#define SIM_SR_READ2 0x35
+
+W25QSim::W25QSim(uint32_t size)
+: _mem(size, 0xFF), _selected(false), _writeEnabled(false),
+  _timing(false), _ignored(false), _busyUntil(0),
+  _cmd(0), _count(0), _addr(0)
+{
+	resetCounters();
+}
+
+void W25QSim::eraseAll()
+{
+	memset(&_mem[0], 0xFF, _mem.size());
+}
+
+void W25QSim::resetCounters()
+{
+	_programCmds = _eraseCmds = _readCmds = 0;
+	_bytesRead = _bytesProgrammed = _statusPolls = 0;
+	_busyViolations = 0;
+}
+
+bool W25QSim::busy() const
+{
+	return _timing and hal::nowMicros() < _busyUntil;
+}
+
+void W25QSim::select()
+{
+	_selected = true;
+	_ignored = false;
+	_count = 0;
+	_addr = 0;
+}
+
+/*!
+ * \brief End of instruction : erase and program are executed (or
+ *        finished) when chip select goes high.
+ */
+void W25QSim::deselect()
+{
+	if(_selected and _count > 0 and not _ignored) _execute();
+	_selected = false;
+}
+
+uint8_t W25QSim::transfer(uint8_t data)
+{
+	uint8_t res = 0xFF;
+	if(not _selected or _ignored) return res;
+	if(_count == 0)
+	{
+		_cmd = data;
+		if(busy() and _cmd != SIM_SR_READ1 and _cmd != SIM_SR_READ2)
+		{
+			_ignored = true;
+			_busyViolations++;
+			return res;
+		}
+		if(_cmd == SIM_READ or _cmd == SIM_FASTREAD or \
+		   _cmd == SIM_READID) _readCmds++;
+		if(_cmd == SIM_SR_READ1) _statusPolls++;
+	}
+	else if(_count <= 3 and _cmd != SIM_SR_READ1 and _cmd != SIM_SR_READ2)
+	{
+		_addr = (_addr << 8) | data;
+		if(_count == 3) _addr %= _mem.size();
+	}
+	else
+	{
+		switch(_cmd)
+		{
+		case SIM_READID:
+			res = ((_count - 4) % 2 == 0) ? 0xEF : 0x13;
+			break;
+		case SIM_FASTREAD:
+			if(_count == 4) break; // dummy byte
+			// fall through
+		case SIM_READ:
+			res = _mem[_addr];
+			_addr = (_addr + 1) % _mem.size();
+			_bytesRead++;
+			break;
+		case SIM_PROG:
+			if(_writeEnabled)
+			{
+				uint32_t page = _addr & ~(uint32_t)(W25QSIM_PAGESIZE - 1);
+				_mem[_addr] &= data;
+				_addr = page | ((_addr + 1) & (W25QSIM_PAGESIZE - 1));
+				_bytesProgrammed++;
+			}
+			break;
+		case SIM_SR_READ1: // sent again and again while selected
+			res = (_writeEnabled ? 0x02 : 0x00) | (busy() ? 0x01 : 0x00);
+			break;
+		case SIM_SR_READ2:
+			res = 0x00;
+			break;
+		}
+	}
+	_count++;
+	return res;
+}
+
+void W25QSim::_execute()
+{
+	uint32_t eraseSize = 0;
+	switch(_cmd)
+	{
+	case SIM_WEN:
+		_writeEnabled = true;
+		break;
+	case SIM_WDI:
+		_writeEnabled = false;
+		break;
+	case SIM_PROG:
+		if(_writeEnabled and _count > 4)
+		{
+			_programCmds++;
+			_busyUntil = hal::nowMicros() + W25QSIM_TPP;
+		}
+		_writeEnabled = false;
+		break;
+	case SIM_ERASE4K: eraseSize = 4096; break;
+	case SIM_ERASE32K: eraseSize = 32768; break;
+	case SIM_ERASE64K: eraseSize = 65536; break;
+	case SIM_ERASECHIP: eraseSize = _mem.size(); _addr = 0; break;
+	}
+	if(eraseSize and _writeEnabled and \
+	   (_cmd == SIM_ERASECHIP or _count >= 4))
+	{
+		uint32_t start = _addr & ~(eraseSize - 1);
+		memset(&_mem[start], 0xFF, eraseSize);
+		_eraseCmds++;
+		_busyUntil = hal::nowMicros() + \
+		             (eraseSize == 4096 ? W25QSIM_TSE :
+		              eraseSize == 32768 ? W25QSIM_TBE32 :
+		              eraseSize == 65536 ? W25QSIM_TBE64 : W25QSIM_TCE);
+		_writeEnabled = false;
+	}
+}
@@ -0,0 +1,82 @@
+/*!
+ * \file W25QSim.h
+ * \brief Simulated Winbond W25Q80BV SPI flash for the host HAL
+ *
+ * Implements the instructions used by W25QFlash with the real flash
+ * semantics : programming can only clear bits, a page program wraps
+ * inside its 256 bytes page, program and erase need write enable.
+ *
+ * With setTiming(true), program and erase take their typical W25Q80BV
+ * time on the virtual clock. BUSY is then set in the status register
+ * and every instruction but status reads is ignored (and counted by
+ * busyViolations()). Polling BUSY needs HAL calls that cost time (UNO
+ * costs), otherwise the clock never reaches the end of the operation.
+ */
+
+#ifndef W25QSim_h
+#define W25QSim_h
+
+#include <stdint.h>
+#include <vector>
+
+#include "HostHal.h"
+
+///\brief W25Q80BV size [bytes]
+#define W25QSIM_SIZE 1048576
+#define W25QSIM_PAGESIZE 256
+#define W25QSIM_SECTORSIZE 4096
+///\brief Typical busy time of page program, erases [µSec]
+#define W25QSIM_TPP 700
+#define W25QSIM_TSE 30000
+#define W25QSIM_TBE32 120000
+#define W25QSIM_TBE64 150000
+#define W25QSIM_TCE 2000000
+
+class W25QSim : public hal::SpiDevice
+{
+public:
+	W25QSim(uint32_t size = W25QSIM_SIZE);
+
+	virtual void select();
+	virtual void deselect();
+	virtual uint8_t transfer(uint8_t data);
+
+	// === HOST INTERFACE ===
+	uint8_t* data() { return &_mem[0]; }
+	uint32_t size() const { return _mem.size(); }
+	void eraseAll();
+	void setTiming(bool realistic) { _timing = realistic; }
+	bool busy() const;
+
+	unsigned long programCmds() const { return _programCmds; }
+	unsigned long eraseCmds() const { return _eraseCmds; }
+	unsigned long readCmds() const { return _readCmds; }
+	unsigned long bytesRead() const { return _bytesRead; }
+	unsigned long bytesProgrammed() const { return _bytesProgrammed; }
+	unsigned long statusPolls() const { return _statusPolls; }
+	unsigned long busyViolations() const { return _busyViolations; }
+	void resetCounters();
+
+private:
+	void _execute();
+
+	std::vector<uint8_t> _mem;
+	bool _selected;
+	bool _writeEnabled;
+	bool _timing;
+	bool _ignored;			///< instruction sent while busy
+	uint64_t _busyUntil;	///< µSec
+	uint8_t _cmd;
+	uint32_t _count;
+	uint32_t _addr;
+
+	unsigned long _programCmds;
+	unsigned long _eraseCmds;
+	unsigned long _readCmds;
+	unsigned long _bytesRead;
+	unsigned long _bytesProgrammed;
+	unsigned long _statusPolls;
+	unsigned long _busyViolations;
+};
+
+#endif
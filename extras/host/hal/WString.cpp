@@ -0,0 +1,66 @@
+/*!
+ * \file WString.cpp
+ * \brief Host stand-in for the Arduino String class (subset)
+ */
+
+#include <stdlib.h>
+
+#include "WString.h"
+
+namespace
+{
+
+std::string toBase(unsigned long value, unsigned char base, bool negative)
+{
+	std::string res;
+	if(base < 2) base = 10;
+	do
+	{
+		unsigned char digit = value % base;
+		res.insert(res.begin(), digit < 10 ? '0' + digit : 'a' + digit - 10);
+		value /= base;
+	}
+	while(value);
+	if(negative) res.insert(res.begin(), '-');
+	return res;
+}
+
+}
+
+String::String(int value, unsigned char base)
+: _str(toBase(value < 0 and base == 10 ? -(long)value : (unsigned int)value,
+			  base, value < 0 and base == 10))
+{
+}
+
+String::String(unsigned int value, unsigned char base)
+: _str(toBase(value, base, false))
+{
+}
+
+String::String(long value, unsigned char base)
+: _str(toBase(value < 0 and base == 10 ? -value : (unsigned long)value,
+			  base, value < 0 and base == 10))
+{
+}
+
+String::String(unsigned long value, unsigned char base)
+: _str(toBase(value, base, false))
+{
+}
+
+void String::replace(char find, char replace)
+{
+	for(size_t i=0;i<_str.size();i++) if(_str[i] == find) _str[i] = replace;
+}
+
+void String::replace(const String& find, const String& replace)
+{
+	if(find._str.empty()) return;
+	size_t pos = 0;
+	while((pos = _str.find(find._str, pos)) != std::string::npos)
+	{
+		_str.replace(pos, find._str.size(), replace._str);
+		pos += replace._str.size();
+	}
+}
@@ -0,0 +1,43 @@
+/*!
+ * \file WString.h
+ * \brief Host stand-in for the Arduino String class (subset)
+ */
+
+#ifndef WString_h
+#define WString_h
+
+#include <string>
+
+class String
+{
+public:
+	String(const char* cstr = "") : _str(cstr ? cstr : "") {}
+	String(const std::string& str) : _str(str) {}
+	String(char c) : _str(1, c) {}
+	String(int value, unsigned char base = 10);
+	String(unsigned int value, unsigned char base = 10);
+	String(long value, unsigned char base = 10);
+	String(unsigned long value, unsigned char base = 10);
+
+	unsigned int length() const { return _str.length(); }
+	const char* c_str() const { return _str.c_str(); }
+	char charAt(unsigned int index) const { return _str.at(index); }
+	char operator[](unsigned int index) const { return _str.at(index); }
+
+	void replace(char find, char replace);
+	void replace(const String& find, const String& replace);
+
+	String& operator+=(const String& rhs) { _str += rhs._str; return *this; }
+	String& operator+=(const char* rhs) { _str += rhs; return *this; }
+	String& operator+=(char rhs) { _str += rhs; return *this; }
+	friend String operator+(const String& lhs, const String& rhs)
+	{ return String(lhs._str + rhs._str); }
+
+	bool operator==(const String& rhs) const { return _str == rhs._str; }
+	bool operator!=(const String& rhs) const { return _str != rhs._str; }
+
+private:
+	std::string _str;
+};
+
+#endif
@@ -0,0 +1,260 @@
+/*!
+ * \file memDump.cpp
+ * \brief Decode the binary dump of a brew session to CSV
+ *
+ *     ./memDump capture.bin [capture2.bin ...] > session.csv
+ *
+ * A capture is what the serial port received after choosing <5>
+ * (binary dump brew session data) in Rims::checkMemAccessMode(). Text
+ * around the SLIP frames is ignored. Pages are decoded as
+ * Rims::_memDumpBrewData() does and printed with the g_csvHeader
+ * columns. A capture of the TELEMETRYBINARY stream (see
+ * Rims::setTelemetry()) is decoded the same way, one line per frame.
+ *
+ * Frames with a bad CRC are dropped : the pages missing are listed on
+ * stderr with the first page to ask for again. Captures of a resumed
+ * dump are given after the first one, pages are merged by offset.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <map>
+#include <vector>
+
+#include "Rims.h"
+
+namespace
+{
+
+///\brief Same as g_memKeyframeSizes of Rims.cpp [bytes]
+const byte g_keyframeSizes[MEMFIELDS] = {4,2,2,2,4};
+const size_t g_pageFrameSize = 3 + MEMPAGESIZE + 2;
+const size_t g_endFrameSize = 3 + 2;
+
+/*!
+ * \brief Page decoding functions of the library.
+ */
+class RimsMem : public Rims
+{
+public:
+	using Rims::_memGetDelta;
+	using Rims::_memGetLE;
+};
+
+typedef std::vector<byte> Frame;
+
+/*!
+ * \brief Split a capture in unescaped SLIP frames.
+ */
+std::vector<Frame> readFrames(FILE* file)
+{
+	std::vector<Frame> frames(1);
+	bool escaped = false;
+	int c;
+	while((c = fgetc(file)) != EOF)
+	{
+		if(c == SLIPEND)
+		{
+			if(not frames.back().empty()) frames.push_back(Frame());
+		}
+		else if(c == SLIPESC) escaped = true;
+		else
+		{
+			if(escaped and c == SLIPESCEND) c = SLIPEND;
+			else if(escaped and c == SLIPESCESC) c = SLIPESC;
+			escaped = false;
+			frames.back().push_back((byte)c);
+		}
+	}
+	frames.pop_back(); // empty, or text after the last frame
+	return frames;
+}
+
+bool crcValid(const Frame& frame)
+{
+	unsigned int crc = 0xFFFF;
+	for(size_t i=0;i+2<frame.size();i++) crc = Telemetry::crc16(crc,frame[i]);
+	return crc == (unsigned int)RimsMem::_memGetLE(&frame[frame.size()-2],2) \
+	              % 65536;
+}
+
+void printPage(const byte* page)
+{
+	long values[MEMFIELDS] = {0}, timeDelta = 0;
+	const byte *data = page + MEMPAGEHEADER, *dataEnd = page + MEMPAGESIZE;
+	int sp = (int)RimsMem::_memGetLE(page+2,2);
+	byte recordQty = page[1];
+	if(page[0] != MEMPAGEFORMAT or recordQty == 0xFF) return;
+	for(byte i=0;i<recordQty;i++)
+	{
+		for(byte field=0;field<MEMFIELDS;field++)
+		{
+			if(i == 0) // keyframe
+			{
+				values[field] = RimsMem::_memGetLE(data,g_keyframeSizes[field]);
+				data += g_keyframeSizes[field];
+			}
+			else if(field == 0) // time
+			{
+				timeDelta += RimsMem::_memGetDelta(&data,dataEnd);
+				values[0] += timeDelta;
+			}
+			else values[field] += RimsMem::_memGetDelta(&data,dataEnd);
+		}
+		if(data > dataEnd) break; // corrupted page
+		printf("%.3f,%.1f,%ld,%.2f,%.2f,%ld\n", values[0]/1000.0, sp/100.0,
+			   values[1], values[2]/100.0, values[3]/100.0, values[4]);
+	}
+}
+
+/*!
+ * \brief Fields of a binary telemetry frame, 0 if it's not one.
+ */
+unsigned int telemetryFields(const Frame& frame)
+{
+	size_t size = 5 + 2;
+	unsigned int fields;
+	if(frame.size() < size or frame[0] != TELEMETRYFRAME) return 0;
+	fields = frame[3] | (frame[4] << 8);
+	for(byte field=0;field<TELEMETRYFIELDQTY;field++)
+	{
+		if(fields & (1 << field)) size += g_telemetrySizes[field];
+	}
+	return (frame.size() == size) ? fields : 0;
+}
+
+void printTelemetryHeader(unsigned int fields)
+{
+	const char* separator = "";
+	for(byte field=0;field<TELEMETRYFIELDQTY;field++)
+	{
+		if(not(fields & (1 << field))) continue;
+		printf("%s%s", separator, g_telemetryNames[field]);
+		separator = ",";
+	}
+	printf("\n");
+}
+
+void printTelemetry(const Frame& frame)
+{
+	const byte* data = &frame[5];
+	unsigned int fields = telemetryFields(frame);
+	const char* separator = "";
+	long value;
+	double scale;
+	for(byte field=0;field<TELEMETRYFIELDQTY;field++)
+	{
+		if(not(fields & (1 << field))) continue;
+		value = RimsMem::_memGetLE(data,g_telemetrySizes[field]);
+		data += g_telemetrySizes[field];
+		if(field == 0) value &= 0xFFFFFFFFL; // time is unsigned
+		scale = pow(10.0, g_telemetryDecimals[field]);
+		printf("%s%.*f", separator, g_telemetryPrintDecimals[field],
+			   value / scale);
+		separator = ",";
+	}
+	printf("\n");
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::map<unsigned int, Frame> pages;
+	std::vector<Frame> telemetry;
+	long pageQty = -1;
+	unsigned long badFrames = 0;
+	if(argc < 2)
+	{
+		fprintf(stderr, "usage: %s capture.bin [capture2.bin ...]\n", argv[0]);
+		return 1;
+	}
+	for(int i=1;i<argc;i++)
+	{
+		FILE* file = fopen(argv[i], "rb");
+		if(file == NULL)
+		{
+			fprintf(stderr, "cannot open %s\n", argv[i]);
+			return 1;
+		}
+		std::vector<Frame> frames = readFrames(file);
+		fclose(file);
+		for(size_t k=0;k<frames.size();k++)
+		{
+			const Frame& frame = frames[k];
+			bool pageFrame = (frame.size() == g_pageFrameSize and \
+			                  frame[0] == MEMFRAMEPAGE);
+			bool endFrame = (frame.size() == g_endFrameSize and \
+			                 frame[0] == MEMFRAMEEND);
+			bool telemetryFrame = (telemetryFields(frame) != 0);
+			if(not pageFrame and not endFrame and not telemetryFrame)
+			{
+				continue; // menu text
+			}
+			if(not crcValid(frame))
+			{
+				badFrames++;
+				continue;
+			}
+			if(telemetryFrame)
+			{
+				telemetry.push_back(frame);
+				continue;
+			}
+			unsigned int offset = RimsMem::_memGetLE(&frame[1],2) % 65536;
+			if(endFrame) pageQty = offset;
+			else pages[offset] = Frame(frame.begin() + 3, frame.end() - 2);
+		}
+	}
+
+	if(not telemetry.empty())
+	{
+		unsigned int fields = 0;
+		for(size_t k=0;k<telemetry.size();k++)
+		{
+			if(telemetryFields(telemetry[k]) != fields) // new header
+			{
+				fields = telemetryFields(telemetry[k]);
+				printTelemetryHeader(fields);
+			}
+			printTelemetry(telemetry[k]);
+		}
+		// dropped count of the last frame, data points lost on the board
+		fprintf(stderr, "%lu telemetry frames, %lu bad frames, "
+				"%ld dropped by the board\n",
+				(unsigned long)telemetry.size(), badFrames,
+				RimsMem::_memGetLE(&telemetry.back()[1],2) & 0xFFFF);
+		return badFrames ? 2 : 0;
+	}
+	printf("%s\n", g_csvHeader);
+	std::map<unsigned int, Frame>::const_iterator it;
+	for(it=pages.begin();it!=pages.end();++it) printPage(&it->second[0]);
+
+	// === MISSING PAGES ===
+	// Pages not committed (power cut) are never sent : a missing page
+	// is only sure to be lost when a bad frame was received.
+	long firstMissing = -1;
+	unsigned long missing = 0;
+	long last = (pageQty >= 0) ? pageQty : \
+	            (pages.empty() ? 0 : (long)pages.rbegin()->first + 1);
+	for(long offset=0;offset<last;offset++)
+	{
+		if(pages.count(offset)) continue;
+		if(firstMissing < 0) firstMissing = offset;
+		missing++;
+	}
+	fprintf(stderr, "%lu pages, %lu bad frames, %lu pages missing\n",
+			(unsigned long)pages.size(), badFrames, missing);
+	if(pageQty < 0)
+	{
+		fprintf(stderr, "end of session not received, resume at page %ld\n",
+				firstMissing >= 0 ? firstMissing : last);
+		return 2;
+	}
+	if(badFrames > 0 and firstMissing >= 0)
+	{
+		fprintf(stderr, "resume at page %ld\n", firstMissing);
+		return 2;
+	}
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*!
+ * \file pidCheck.cpp
+ * \brief PIDfix against PIDmod on the same process values
+ *
+ *     ./pidCheck [Kp,Ki,Kd,Tf]...
+ *
+ * Both controllers are set as Rims::_initialize() does (SAMPLETIME,
+ * output in [0,SSRWINDOWSIZE]) and computed at each sample with the
+ * same process value, in hundredths of celcius as Rims reads it. The
+ * process value comes from a first order heater driven by PIDmod, with
+ * a small deterministic noise, from ambient to DEFAULTSP. The sample
+ * time jitters by a few milliseconds, as the timeChange given by
+ * Rims::_taskPID() does.
+ *
+ * The largest |PIDfix - PIDmod| output is printed for each tuning
+ * (default : the rimsBasic example tuning and the autotune gains of the
+ * default plant). The exit status is 1 if it is more than one output
+ * unit (mSec of SSR on-time). The integral gain of PIDfix is Q16.16 :
+ * its rounding is up to about 4/Ki units at full output, so a Ki below
+ * 5 per celcius (at SAMPLETIME) can go past one unit.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "Rims.h"
+
+namespace
+{
+
+struct Tuning
+{
+	double kp, ki, kd, tauFilter;
+};
+
+///\brief rimsBasic example, then rimsSim --autotune zn, tl and noos gains
+const Tuning g_defaultTunings[] = {
+	{2000, 5, -150000, 80},
+	{1765.6655, 150.2694, 5186.6426, 0.2937},
+	{1337.6254, 25.8728, 4989.5552, 0.3730},
+	{588.5552, 50.0898, 4610.3491, 0.7833},
+	{3000, 10, 0, 0},
+};
+
+const double g_ambient = 20;		///< [celcius]
+const double g_fullHeatRise = 90;	///< steady state rise at 100 % [celcius]
+const double g_tau = 300;			///< heater time constant [sec]
+const int g_samples = 3600;
+
+/*!
+ * \brief Largest |PIDfix - PIDmod| output over the run.
+ */
+double maxDifference(const Tuning& tuning)
+{
+	double input = 0, output = 0, setPoint = DEFAULTSP;
+	long inputFix = 0, outputFix = 0, setPointFix = 100L * DEFAULTSP;
+	PIDmod pid(&input, &output, &setPoint, 0, 0, 0, DIRECT);
+	PIDfix pidFix(&inputFix, &outputFix, &setPointFix, 0, 0, 0, DIRECT);
+	pid.SetSampleTime(SAMPLETIME);
+	pid.SetOutputLimits(0, SSRWINDOWSIZE);
+	pidFix.SetSampleTime(SAMPLETIME);
+	pidFix.SetOutputLimits(0, SSRWINDOWSIZE);
+	pid.SetTunings(tuning.kp, tuning.ki, tuning.kd);
+	pid.SetDerivativeFilter(tuning.tauFilter);
+	pidFix.SetTunings(tuning.kp, tuning.ki, tuning.kd);
+	pidFix.SetDerivativeFilter(tuning.tauFilter);
+	double temp = g_ambient, maxDiff = 0;
+	unsigned long seed = 1;
+	inputFix = (long)floor(100 * temp + 0.5);
+	input = inputFix / 100.0;
+	pid.SetMode(AUTOMATIC);
+	pidFix.SetMode(AUTOMATIC);
+	for(int k=0;k<g_samples;k++)
+	{
+		seed = seed * 1103515245UL + 12345UL;
+		unsigned long timeChange = SAMPLETIME + (seed >> 16) % 5;
+		double noise = (double)((seed >> 8) % 11) / 100.0 - 0.05;
+		double heat = output / SSRWINDOWSIZE * g_fullHeatRise;
+		temp += (heat - (temp - g_ambient)) * timeChange / 1000.0 / g_tau;
+		inputFix = (long)floor(100 * (temp + noise) + 0.5);
+		input = inputFix / 100.0;
+		pid.Compute(timeChange);
+		pidFix.Compute(timeChange);
+		maxDiff = std::max(maxDiff, fabs(outputFix - output));
+	}
+	return maxDiff;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<Tuning> tunings;
+	for(int i=1;i<argc;i++)
+	{
+		Tuning tuning = {0, 0, 0, 0};
+		if(sscanf(argv[i], "%lf,%lf,%lf,%lf", &tuning.kp, &tuning.ki,
+				  &tuning.kd, &tuning.tauFilter) < 3)
+		{
+			fprintf(stderr, "usage: %s [Kp,Ki,Kd,Tf]...\n", argv[0]);
+			return 1;
+		}
+		tunings.push_back(tuning);
+	}
+	if(tunings.empty())
+	{
+		tunings.assign(g_defaultTunings, g_defaultTunings + \
+					   sizeof(g_defaultTunings) / sizeof(Tuning));
+	}
+	bool pass = true;
+	for(size_t i=0;i<tunings.size();i++)
+	{
+		double diff = maxDifference(tunings[i]);
+		printf("Kp %g, Ki %g, Kd %g, Tf %g : |PIDfix - PIDmod| <= %.3f\n",
+			   tunings[i].kp, tunings[i].ki, tunings[i].kd,
+			   tunings[i].tauFilter, diff);
+		if(diff > 1) pass = false;
+	}
+	return pass ? 0 : 1;
+}
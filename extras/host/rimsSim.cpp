@@ -0,0 +1,647 @@
+/*!
+ * \file rimsSim.cpp
+ * \brief Closed loop simulation of Rims (or RimsIdent) with RimsPlant
+ *
+ * Runs a complete mash (or the identification step test) on the
+ * virtual clock and prints regulation metrics. The 1 Hz trace of the
+ * run can be saved as CSV to compare tunings.
+ *
+ * Options :
+ * - --pid Kp,Ki,Kd,Tf[,vol] : PID slot given to Rims::setTuningPID()
+ *   (repeatable, default is the rimsBasic example tuning)
+ * - --select n : mash water slot picked in askMashWater() (default 0)
+ * - --sp C : temperature set point (default DEFAULTSP)
+ * - --minutes m : virtual time (default DEFAULTTIME + 15 min,
+ *   IDENTLENGTH + 1 min with --ident, AUTOTUNELENGTH + 1 min with
+ *   --autotune)
+ * - --fixed : fixed point PID (PIDfix) for all --pid slots
+ * - --ident : RimsIdent step test instead of regulation
+ * - --autotune zn|tl|noos[,hyst] : RimsIdent relay autotune at --sp
+ *   with this rule (RimsIdent::setAutotune()), the gains found are
+ *   printed, ready for --pid
+ * - --set name=value : plant parameter (see g_plantParamNames)
+ * - --csv file : 1 Hz trace (time,sp,cv,pv,tube,mash,flow)
+ * - --uno-costs : keep the UNO HAL call costs (slow, loop timing study)
+ * - --telemetry csv|binary|off : Rims::setTelemetry() mode
+ * - --serial file : serial output (binary telemetry is decoded by memDump)
+ * - --fields mask : Rims::setTelemetryFields() (e.g. 0x1FF, PID terms)
+ * - --rate channel,n[,burst] : Rims::setLogRate() (0 serial, 1 flash)
+ * - --ssr window|sigma[,hz] : Rims::setSSRModulation() (default window,
+ *   mains at DEFAULTMAINSFREQ)
+ * - --sample pid[,display,log] : Rims::setSampleTimes() [mSec]
+ * - --table key,Kp,Ki,Kd,Tf : gain table row of Rims::setTuningTable()
+ *   (repeatable, replaces --pid, sorted by key)
+ * - --schedule volume|flow|temp : key of the --table rows (default volume)
+ * - --volume L : mash water typed in askMashVolume() (default first
+ *   --table key), the plant volume is --set water=L
+ *
+ * rimsSimMem is the same simulation built with WITH_W25QFLASH : the
+ * session is logged in a simulated W25Q80BV (typical program and erase
+ * times, SPI at UNO speed) and flash usage is printed. rimsSimProf is
+ * built with WITH_PROFILER : Rims::printProfile() is printed at the
+ * end (run it with --uno-costs, micros() is slow with the fast costs).
+ *
+ * The longest loop pass after the last key press is printed, with
+ * the deadline misses of each task of the scheduler (rimsSimProf).
+ * The SSR on-time
+ * delivered after the last key press (LED pin) is compared with the
+ * one asked by the control value at each pass. The tube ripple is the
+ * peak to peak tube temperature over each SSRWINDOWSIZE span after
+ * heat up, sampled at 10 Hz.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "Arduino.h"
+#include "HostHal.h"
+#include "LiquidCrystal.h"
+#include "Rims.h"
+#include "RimsIdent.h"
+#include "KeypadScript.h"
+#include "RimsPlant.h"
+#ifdef WITH_W25QFLASH
+	#include "W25QSim.h"
+#endif
+
+namespace
+{
+
+const uint8_t g_pinKeys = 0;
+const uint8_t g_pinTherm = 1;
+const uint8_t g_pinLight = 10;
+const uint8_t g_pinSSR = 11;
+const uint8_t g_pinLED = 13;	// follows the SSR
+const uint8_t g_interruptFlow = 1;
+const uint8_t g_pinFlashCS = A5;
+const float g_flowFactor = 7.5;	// YF-S201 hall effect sensor
+float g_steinhartCoefs[4] = {0.0006, 0.0003, -0.000007, 0.0000003};
+const float g_res1 = 10000.0;
+
+struct PlantParamName
+{
+	const char* name;
+	double RimsPlantParams::*member;
+};
+
+const PlantParamName g_plantParamNames[] = {
+	{"heater", &RimsPlantParams::heaterPower},
+	{"tauHeater", &RimsPlantParams::tauHeater},
+	{"tube", &RimsPlantParams::tubeVolume},
+	{"tubeLoss", &RimsPlantParams::tubeLoss},
+	{"flow", &RimsPlantParams::flow},
+	{"supply", &RimsPlantParams::supplyVolume},
+	{"return", &RimsPlantParams::returnVolume},
+	{"water", &RimsPlantParams::mashWater},
+	{"grain", &RimsPlantParams::grainMass},
+	{"tun", &RimsPlantParams::tunHeatCap},
+	{"mashLoss", &RimsPlantParams::mashLoss},
+	{"ambient", &RimsPlantParams::ambientTemp},
+	{"initial", &RimsPlantParams::initialTemp},
+	{"tauSensor", &RimsPlantParams::tauSensor},
+	{"noise", &RimsPlantParams::adcNoise},
+	{"step", &RimsPlantParams::timeStep},
+};
+
+struct PidSlot
+{
+	double kp, ki, kd, tauFilter;
+	int mashWater;
+};
+
+///\brief Rows of --table
+const size_t g_tableMaxRows = 32;
+float g_table[g_tableMaxRows][TUNINGCOLUMNS];
+
+bool tableRowLess(const float* a, const float* b)
+{
+	return a[0] < b[0];
+}
+
+/*!
+ * \brief Key presses of UIRims::askMashVolume() from value to target :
+ *        tens, units, then tenths digit.
+ */
+double typeVolume(KeypadScript& keypad, double t, float value, float target)
+{
+	int from = (int)floor(value * 10 + 0.5), to = (int)floor(target * 10 + 0.5);
+	int digits[3] = {to / 100 - from / 100, (to / 10) % 10 - (from / 10) % 10,
+					 to % 10 - from % 10};
+	keypad.press(t += 0.5, KEYLEFT);
+	for(int d=0;d<3;d++)
+	{
+		if(d > 0) keypad.press(t += 0.5, KEYRIGHT);
+		for(int k=0;k<abs(digits[d]);k++)
+		{
+			keypad.press(t += 0.5, (digits[d] > 0) ? KEYUP : KEYDOWN);
+		}
+	}
+	return t + 0.5;
+}
+
+bool setPlantParam(RimsPlantParams& params, const char* arg)
+{
+	const char* equal = strchr(arg, '=');
+	if(equal == NULL) return false;
+	std::string name(arg, equal - arg);
+	for(size_t i=0;i<sizeof(g_plantParamNames)/sizeof(PlantParamName);i++)
+	{
+		if(name == g_plantParamNames[i].name)
+		{
+			params.*(g_plantParamNames[i].member) = atof(equal + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*!
+ * \brief Regulation metrics computed from the 1 Hz samples.
+ */
+struct Metrics
+{
+	double heatUpTime;		///< first |tube-sp| <= MAXTEMPVAR [sec]
+	double mashReachTime;	///< first mash >= sp-0.5 [sec]
+	double tubeOvershoot;	///< max tube-sp after heat up [celcius]
+	double mashOvershoot;	///< max mash-sp after heat up [celcius]
+	double tubeMax;			///< max tube temperature [celcius]
+	double tubeIAE;			///< integral |tube-sp| after heat up [celcius.min]
+	double mashIAE;			///< integral |mash-sp| after mash reach [celcius.min]
+	double cvVariation;		///< sum |cv(k)-cv(k-1)| / SSRWINDOWSIZE
+	double lastCV;
+};
+
+void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [--pid Kp,Ki,Kd,Tf[,vol]]... [--select n] "
+			"[--sp C] [--minutes m] [--fixed] [--ident] [--autotune zn|tl|noos[,hyst]] "
+			"[--set name=value]... "
+			"[--csv file] [--uno-costs] [--telemetry csv|binary|off] "
+			"[--serial file] [--fields mask] [--rate channel,n[,burst]]... "
+			"[--ssr window|sigma[,hz]] [--sample pid[,display,log]] "
+			"[--table key,Kp,Ki,Kd,Tf]... [--schedule volume|flow|temp] "
+			"[--volume L]\n",
+			name);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<PidSlot> pids;
+	RimsPlantParams params = defaultPlantParams();
+	int select = 0;
+	double setPoint = DEFAULTSP, minutes = -1;
+	bool ident = false, unoCosts = false, fixedPoint = false;
+	byte autotune = AUTOTUNEOFF;
+	float hysteresis = AUTOTUNEHYSTERESIS;
+	const char* csvPath = NULL;
+	const char* serialPath = NULL;
+	byte telemetry = TELEMETRYCSV;
+	unsigned int fields = TELEMETRYDEFAULTFIELDS;
+	int rates[LOGCHANNELS][2] = {{1, 1}, {1, 1}};
+	byte ssrModulation = SSRWINDOW;
+	int mainsFreq = DEFAULTMAINSFREQ;
+	unsigned int sampleTimes[3] = {SAMPLETIME, SAMPLETIME, SAMPLETIME};
+	size_t tableRows = 0;
+	byte scheduling = GAINSCHEDVOLUME;
+	double volume = -1;
+	for(int i=1;i<argc;i++)
+	{
+		bool hasValue = (i + 1 < argc);
+		if(not strcmp(argv[i], "--pid") and hasValue)
+		{
+			PidSlot slot = {0, 0, 0, 0, -1};
+			if(sscanf(argv[++i], "%lf,%lf,%lf,%lf,%d", &slot.kp, &slot.ki,
+					  &slot.kd, &slot.tauFilter, &slot.mashWater) < 4)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+			pids.push_back(slot);
+		}
+		else if(not strcmp(argv[i], "--select") and hasValue)
+		{
+			select = atoi(argv[++i]);
+		}
+		else if(not strcmp(argv[i], "--sp") and hasValue)
+		{
+			setPoint = atof(argv[++i]);
+		}
+		else if(not strcmp(argv[i], "--minutes") and hasValue)
+		{
+			minutes = atof(argv[++i]);
+		}
+		else if(not strcmp(argv[i], "--set") and hasValue)
+		{
+			if(not setPlantParam(params, argv[++i]))
+			{
+				fprintf(stderr, "unknown plant parameter %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if(not strcmp(argv[i], "--csv") and hasValue)
+		{
+			csvPath = argv[++i];
+		}
+		else if(not strcmp(argv[i], "--serial") and hasValue)
+		{
+			serialPath = argv[++i];
+		}
+		else if(not strcmp(argv[i], "--telemetry") and hasValue)
+		{
+			i++;
+			if(not strcmp(argv[i], "binary")) telemetry = TELEMETRYBINARY;
+			else if(not strcmp(argv[i], "off")) telemetry = TELEMETRYOFF;
+			else if(strcmp(argv[i], "csv"))
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(not strcmp(argv[i], "--fields") and hasValue)
+		{
+			fields = strtoul(argv[++i], NULL, 0);
+		}
+		else if(not strcmp(argv[i], "--rate") and hasValue)
+		{
+			int channel, n, burst = 1;
+			if(sscanf(argv[++i], "%d,%d,%d", &channel, &n, &burst) < 2 or \
+			   channel < 0 or channel >= LOGCHANNELS)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+			rates[channel][0] = n;
+			rates[channel][1] = burst;
+		}
+		else if(not strcmp(argv[i], "--ssr") and hasValue)
+		{
+			char mode[8] = "";
+			sscanf(argv[++i], "%7[a-z],%d", mode, &mainsFreq);
+			if(not strcmp(mode, "sigma")) ssrModulation = SSRSIGMADELTA;
+			else if(strcmp(mode, "window") or mainsFreq <= 0)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(not strcmp(argv[i], "--sample") and hasValue)
+		{
+			if(sscanf(argv[++i], "%u,%u,%u", &sampleTimes[0], &sampleTimes[1],
+					  &sampleTimes[2]) < 1)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(not strcmp(argv[i], "--table") and hasValue)
+		{
+			float* row = g_table[tableRows];
+			if(tableRows == g_tableMaxRows or \
+			   sscanf(argv[++i], "%f,%f,%f,%f,%f", &row[0], &row[1], &row[2],
+					  &row[3], &row[4]) < TUNINGCOLUMNS)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+			tableRows++;
+		}
+		else if(not strcmp(argv[i], "--schedule") and hasValue)
+		{
+			i++;
+			if(not strcmp(argv[i], "flow")) scheduling = GAINSCHEDFLOW;
+			else if(not strcmp(argv[i], "temp")) scheduling = GAINSCHEDTEMP;
+			else if(strcmp(argv[i], "volume"))
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(not strcmp(argv[i], "--volume") and hasValue)
+		{
+			volume = atof(argv[++i]);
+		}
+		else if(not strcmp(argv[i], "--ident")) ident = true;
+		else if(not strcmp(argv[i], "--autotune") and hasValue)
+		{
+			char rule[8] = "";
+			sscanf(argv[++i], "%7[a-z],%f", rule, &hysteresis);
+			if(not strcmp(rule, "zn")) autotune = AUTOTUNEZN;
+			else if(not strcmp(rule, "tl")) autotune = AUTOTUNETL;
+			else if(not strcmp(rule, "noos")) autotune = AUTOTUNENOOVERSHOOT;
+			else
+			{
+				usage(argv[0]);
+				return 1;
+			}
+			ident = true;
+		}
+		else if(not strcmp(argv[i], "--fixed")) fixedPoint = true;
+		else if(not strcmp(argv[i], "--uno-costs")) unoCosts = true;
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(pids.empty() and tableRows == 0)
+	{
+		PidSlot slot = {2000, 5, -150000, 80, 20};
+		pids.push_back(slot);
+	}
+	if(minutes < 0)
+	{
+		if(autotune != AUTOTUNEOFF) minutes = AUTOTUNELENGTH / 60000.0 + 1;
+		else minutes = ident ? IDENTLENGTH / 60000.0 + 1 : \
+		                       DEFAULTTIME / 60.0 + 15;
+	}
+
+	// === HAL AND PLANT ===
+	if(not unoCosts) hal::setFastCosts();
+	hal::setTimeLimit((uint64_t)(minutes * 60e6));
+	RimsPlant plant(params);
+	plant.setThermistor(g_steinhartCoefs, g_res1);
+	plant.attach(g_pinTherm, g_pinSSR, g_interruptFlow, g_flowFactor);
+
+	// === LIBRARY UNDER TEST ===
+	double currentTemp = 0, ssrControl = 0, settedTemp = 0;
+	LiquidCrystal lcd(8,9,4,5,6,7);
+	UIRimsIdent ui(&lcd, g_pinKeys, g_pinLight);
+	Rims* rims;
+	KeypadScript keypad;
+	if(ident)
+	{
+		RimsIdent* rimsIdent = new RimsIdent(&ui, g_pinTherm, g_pinSSR,
+											 &currentTemp, &ssrControl,
+											 &settedTemp);
+		rimsIdent->setAutotune(autotune, hysteresis);
+		rims = rimsIdent;
+		if(autotune != AUTOTUNEOFF)					// set point asked
+		{
+			keypad.parse("1:S,2:S,3:S,4:S");
+			settedTemp = setPoint;
+		}
+		else keypad.parse("1:S,2:S,3:S");
+	}
+	else
+	{
+		rims = new Rims(&ui, g_pinTherm, g_pinSSR,
+						&currentTemp, &ssrControl, &settedTemp);
+		for(size_t i=0;i<pids.size();i++)
+		{
+			rims->setTuningPID(pids[i].kp, pids[i].ki, pids[i].kd,
+							   pids[i].tauFilter, pids[i].mashWater,
+							   fixedPoint);
+		}
+		if(tableRows > 0)
+		{
+			float* rows[g_tableMaxRows];
+			float sorted[g_tableMaxRows][TUNINGCOLUMNS];
+			for(size_t r=0;r<tableRows;r++) rows[r] = g_table[r];
+			std::stable_sort(rows, rows + tableRows, tableRowLess);
+			for(size_t r=0;r<tableRows;r++)
+			{
+				memcpy(sorted[r], rows[r], sizeof(sorted[r]));
+			}
+			memcpy(g_table, sorted, sizeof(sorted));
+			rims->setTuningTable(g_table, tableRows, scheduling, fixedPoint);
+		}
+		double t = 1;
+		keypad.press(t++, KEYSELECT);					// set point
+		keypad.press(t++, KEYSELECT);					// timer
+		if(tableRows > 0)								// mash water
+		{
+			if(scheduling == GAINSCHEDVOLUME)
+			{
+				if(volume >= 0)
+				{
+					t = typeVolume(keypad, t, g_table[0][0], volume);
+				}
+				keypad.press(t++, KEYSELECT);
+			}
+		}
+		else if(pids.size() != 1)
+		{
+			for(int k=0;k<select;k++) keypad.press(t + 0.5 * (k + 1), KEYRIGHT);
+			t += 0.5 * (select + 1);
+			keypad.press(t++, KEYSELECT);
+		}
+		keypad.press(t++, KEYSELECT);					// pump warning
+		keypad.press(t++, KEYSELECT);					// heater warning
+		settedTemp = setPoint;
+	}
+	keypad.attach(g_pinKeys);
+	rims->setThermistor(g_steinhartCoefs, g_res1);
+	rims->setInterruptFlow(g_interruptFlow, g_flowFactor);
+	rims->setTelemetry(telemetry);
+	rims->setTelemetryFields(fields);
+	rims->setSSRModulation(ssrModulation, mainsFreq);
+	rims->setSampleTimes(sampleTimes[0], sampleTimes[1], sampleTimes[2]);
+	for(int k=0;k<LOGCHANNELS;k++)
+	{
+		rims->setLogRate(k, rates[k][0], rates[k][1]);
+	}
+#ifdef WITH_W25QFLASH
+	W25QSim flash;
+	flash.setTiming(true);
+	hal::costs().spiByte = 2;
+	hal::costs().spiRegister = 1;
+	hal::attachSpiDevice(g_pinFlashCS, &flash);
+	rims->setMemCSPin(g_pinFlashCS);
+#endif
+	Serial.begin(115200);
+
+	// === RUN ===
+	FILE* csv = (csvPath != NULL) ? fopen(csvPath, "w") : NULL;
+	if(csv != NULL) fprintf(csv, "time,sp,cv,pv,tube,mash,flow\n");
+	Metrics m = {-1, -1, -1e9, -1e9, -1e9, 0, 0, 0, 0};
+	uint64_t nextSample = (uint64_t)(keypad.lastPressTime() * 1e6);
+	uint64_t firstSample = nextSample;
+	unsigned long loops = 0;
+	uint64_t longestPass = 0;
+	double askedOnTime = 0, deliveredOnTime = 0; // µSec
+	uint64_t ledEdge = 0;
+	double spanMin = 1e9, spanMax = -1e9, rippleSum = 0, rippleMax = 0;
+	unsigned long rippleSpans = 0;
+	double autotuneTime = -1; // sec, after the last key press
+	uint64_t nextRipple = firstSample;
+	uint64_t spanEnd = firstSample + SSRWINDOWSIZE * 1000ULL;
+	hal::onPinWrite(g_pinLED, [&](uint8_t level) {
+		uint64_t now = hal::nowMicros();
+		bool ledOn = (ledEdge != 0);
+		if(ledOn and level == LOW)
+		{
+			deliveredOnTime += now - std::max(ledEdge, firstSample);
+			ledEdge = 0;
+		}
+		else if(not ledOn and level == HIGH) ledEdge = (now > 0) ? now : 1;
+	});
+	clock_t start = clock();
+	try
+	{
+		while(true)
+		{
+			uint64_t passStart = hal::nowMicros();
+			rims->run();
+			loops++;
+			if(passStart >= firstSample)
+			{
+				uint64_t pass = hal::nowMicros() - passStart;
+				if(pass > longestPass) longestPass = pass;
+				askedOnTime += std::min(ssrControl / SSRWINDOWSIZE, 1.0) * pass;
+			}
+			if(hal::nowMicros() >= nextRipple)
+			{
+				nextRipple += 100000;
+				plant.update();
+				if(m.heatUpTime >= 0)
+				{
+					spanMin = std::min(spanMin, plant.tubeTemp());
+					spanMax = std::max(spanMax, plant.tubeTemp());
+				}
+				if(hal::nowMicros() >= spanEnd)
+				{
+					spanEnd += SSRWINDOWSIZE * 1000ULL;
+					if(spanMax >= spanMin)
+					{
+						rippleSum += spanMax - spanMin;
+						rippleMax = std::max(rippleMax, spanMax - spanMin);
+						rippleSpans++;
+					}
+					spanMin = 1e9;
+					spanMax = -1e9;
+				}
+			}
+			if(hal::nowMicros() < nextSample) continue;
+			nextSample += 1000000;
+			plant.update();
+			double t = hal::nowMicros() / 1e6;
+			double sp = settedTemp;
+			double tube = plant.tubeTemp(), mash = plant.mashTemp();
+			if(csv != NULL)
+			{
+				fprintf(csv, "%.0f,%.1f,%.0f,%.3f,%.3f,%.3f,%.2f\n", t, sp,
+						ssrControl, currentTemp, tube, mash, plant.flow());
+			}
+			if(tube > m.tubeMax) m.tubeMax = tube;
+			m.cvVariation += fabs(ssrControl - m.lastCV) / SSRWINDOWSIZE;
+			m.lastCV = ssrControl;
+			if(m.heatUpTime < 0 and fabs(tube - sp) <= MAXTEMPVAR)
+			{
+				m.heatUpTime = t;
+			}
+			if(m.mashReachTime < 0 and mash >= sp - 0.5) m.mashReachTime = t;
+			if(autotuneTime < 0 and autotune != AUTOTUNEOFF and \
+			   static_cast<RimsIdent*>(rims)->getUltimateGain() > 0)
+			{
+				autotuneTime = t - firstSample / 1e6;
+			}
+			if(m.heatUpTime >= 0)
+			{
+				if(tube - sp > m.tubeOvershoot) m.tubeOvershoot = tube - sp;
+				if(mash - sp > m.mashOvershoot) m.mashOvershoot = mash - sp;
+				m.tubeIAE += fabs(tube - sp) / 60.0;
+			}
+			if(m.mashReachTime >= 0) m.mashIAE += fabs(mash - sp) / 60.0;
+		}
+	}
+	catch(const hal::TimeLimitReached&)
+	{
+	}
+	double hostSec = (double)(clock() - start) / CLOCKS_PER_SEC;
+	if(csv != NULL) fclose(csv);
+
+	printf("virtual time      : %.1f min\n", hal::nowMicros() / 60e6);
+	printf("host time         : %.3f s (%lu loop passes)\n", hostSec, loops);
+	printf("longest loop pass : %.2f ms\n", longestPass / 1e3);
+	printf("serial            : %lu bytes, blocked %lu us, "
+		   "%u data points dropped\n",
+		   (unsigned long)Serial.hostOutput().size(),
+		   Serial.hostBlockedMicros(), rims->getTelemetryDropped());
+	printf("LCD               : %lu data bytes, %lu commands\n",
+		   lcd.hostDataBytes(), lcd.hostCommandBytes());
+#ifdef WITH_PROFILER
+	for(byte k=0;k<rims->getTaskQty();k++)
+	{
+		printf("task %-12s : %u misses, %lu ms late at most\n",
+			   reinterpret_cast<const char*>(rims->getTaskName(k)),
+			   rims->getTaskMisses(k), rims->getTaskMaxLate(k));
+	}
+#endif
+	printf("ADC               : %lu analogRead(), %lu background\n",
+		   hal::analogReadCount(), hal::adcConversionCount());
+	if(ledEdge != 0)
+	{
+		deliveredOnTime += hal::nowMicros() - std::max(ledEdge, firstSample);
+	}
+	printf("SSR on-time       : %.3f s delivered, %.3f s asked (%+.2f %%)\n",
+		   deliveredOnTime / 1e6, askedOnTime / 1e6,
+		   askedOnTime ? 100 * (deliveredOnTime / askedOnTime - 1) : 0.0);
+	printf("heater energy     : %.3f kWh (%lu switches)\n",
+		   plant.heaterEnergy() / 3.6e6, plant.heaterSwitches());
+	printf("final tube/mash   : %.2f / %.2f C\n",
+		   plant.tubeTemp(), plant.mashTemp());
+	printf("tube max          : %.2f C\n", m.tubeMax);
+	printf("tube ripple       : %.3f C p-p mean, %.3f C max\n",
+		   rippleSpans ? rippleSum / rippleSpans : 0.0, rippleMax);
+	if(autotune != AUTOTUNEOFF)
+	{
+		RimsIdent* rimsIdent = static_cast<RimsIdent*>(rims);
+		const std::string& out = Serial.hostOutput();
+		size_t call = out.find("setTuningPID(");
+		printf("autotune          : ");
+		if(call == std::string::npos) printf("no convergence\n");
+		else
+		{
+			printf("%.0f s, Ku %.1f, Pu %.1f s\n", autotuneTime,
+				   rimsIdent->getUltimateGain(),
+				   rimsIdent->getUltimatePeriod());
+			printf("autotune gains    : %s\n",
+				   out.substr(call, out.find(')', call) + 1 - call).c_str());
+		}
+	}
+	if(not ident)
+	{
+		printf("heat up (tube)    : %.0f s\n", m.heatUpTime);
+		printf("mash reach sp-0.5 : %.0f s\n", m.mashReachTime);
+		printf("tube overshoot    : %.2f C\n", m.tubeOvershoot);
+		printf("mash overshoot    : %.2f C\n", m.mashOvershoot);
+		printf("tube IAE          : %.2f C.min\n", m.tubeIAE);
+		printf("mash IAE          : %.2f C.min\n", m.mashIAE);
+		printf("cv total variation: %.1f windows\n", m.cvVariation);
+	}
+#ifdef WITH_W25QFLASH
+	double points = (hal::nowMicros() - firstSample) / 1e6;
+	printf("flash log         : %lu program, %lu bytes "
+		   "(about %.1f bytes/data point)\n",
+		   flash.programCmds(), flash.bytesProgrammed(),
+		   flash.bytesProgrammed() / points);
+	printf("flash busy        : %lu status polls, %lu ignored instructions\n",
+		   flash.statusPolls(), flash.busyViolations());
+#endif
+#ifdef WITH_PROFILER
+	size_t profileStart = Serial.hostOutput().size();
+	hal::setTimeLimit(0);
+	rims->printProfile();
+	printf("\n");
+	fwrite(Serial.hostOutput().data() + profileStart, 1,
+		   Serial.hostOutput().size() - profileStart, stdout);
+#endif
+	if(serialPath != NULL)
+	{
+		FILE* serial = fopen(serialPath, "wb");
+		if(serial != NULL)
+		{
+			fwrite(Serial.hostOutput().data(), 1, Serial.hostOutput().size(),
+				   serial);
+			fclose(serial);
+		}
+	}
+	delete rims;
+	return 0;
+}
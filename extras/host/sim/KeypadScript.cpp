@@ -0,0 +1,81 @@
+/*!
+ * \file KeypadScript.cpp
+ * \brief Timed key presses on the LCD keypad shield analog pin
+ */
+
+#include <stdlib.h>
+#include <string>
+
+#include "Arduino.h"
+#include "HostHal.h"
+#include "KeypadScript.h"
+
+/*!
+ * \brief Hold key (KEYUP ... KEYSELECT codes of UIRims.h) at
+ *        timeSec for KEYPRESSLENGTH.
+ */
+void KeypadScript::press(double timeSec, uint8_t key)
+{
+	KeyPress keyPress;
+	keyPress.time = (uint64_t)(timeSec * 1e6);
+	keyPress.key = key;
+	_presses.push_back(keyPress);
+}
+
+/*!
+ * \brief Add presses from "t:K[,t:K...]", t in sec and K one of
+ *        U, D, L, R, S (up, down, left, right, select).
+ */
+void KeypadScript::parse(const char* script)
+{
+	static const char keyChars[] = "UDLRS";
+	std::string keys(script);
+	size_t pos = 0;
+	while(pos < keys.size())
+	{
+		size_t end = keys.find(',', pos);
+		if(end == std::string::npos) end = keys.size();
+		std::string item = keys.substr(pos, end - pos);
+		size_t colon = item.find(':');
+		if(colon != std::string::npos and colon + 1 < item.size())
+		{
+			const char* keyChar = strchr(keyChars, item[colon + 1]);
+			if(keyChar != NULL)
+			{
+				press(atof(item.c_str()), (keyChar - keyChars) + 1);
+			}
+		}
+		pos = end + 1;
+	}
+}
+
+void KeypadScript::attach(uint8_t pinKeysAnalog)
+{
+	hal::setAnalogSource(pinKeysAnalog, [this]() {
+		return this->adcValue();
+	});
+}
+
+int KeypadScript::adcValue() const
+{
+	uint64_t now = hal::nowMicros();
+	for(size_t i=0;i<_presses.size();i++)
+	{
+		if(now >= _presses[i].time and \
+		   now < _presses[i].time + KEYPRESSLENGTH)
+		{
+			return hal::keyADCValue(_presses[i].key);
+		}
+	}
+	return hal::keyADCValue(0);
+}
+
+double KeypadScript::lastPressTime() const
+{
+	uint64_t last = 0;
+	for(size_t i=0;i<_presses.size();i++)
+	{
+		if(_presses[i].time > last) last = _presses[i].time;
+	}
+	return last / 1e6;
+}
@@ -0,0 +1,37 @@
+/*!
+ * \file KeypadScript.h
+ * \brief Timed key presses on the LCD keypad shield analog pin
+ */
+
+#ifndef KeypadScript_h
+#define KeypadScript_h
+
+#include <stdint.h>
+#include <vector>
+
+///\brief Duration of a scripted key press [µSec]
+#define KEYPRESSLENGTH 200000
+
+class KeypadScript
+{
+public:
+	KeypadScript() {}
+
+	void clear() { _presses.clear(); }
+	void press(double timeSec, uint8_t key);
+	void parse(const char* script);
+	void attach(uint8_t pinKeysAnalog);
+
+	int adcValue() const;
+	double lastPressTime() const;
+
+private:
+	struct KeyPress
+	{
+		uint64_t time;	///< µSec
+		uint8_t key;
+	};
+	std::vector<KeyPress> _presses;
+};
+
+#endif
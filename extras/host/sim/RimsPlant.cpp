@@ -0,0 +1,261 @@
+/*!
+ * \file RimsPlant.cpp
+ * \brief Thermal model of a RIMS tube and mash tun for host simulations
+ */
+
+#include <math.h>
+
+#include "Arduino.h"
+#include "HostHal.h"
+#include "RimsPlant.h"
+
+///\brief Volumetric heat capacity of wort [J/(L K)]
+#define WORTHEATCAP 4186.0
+///\brief Specific heat of grain [J/(kg K)]
+#define GRAINHEATCAP 1700.0
+///\brief Longest transport delay kept in the delay lines [sec]
+#define MAXDEADTIME 120.0
+
+/*!
+ * \brief Default plant : 20 L batch, 5 kg grain, 2 kW heater,
+ *        0.5 L tube, 4 L/min, ~5 sec of dead time each way.
+ */
+RimsPlantParams defaultPlantParams()
+{
+	RimsPlantParams p;
+	p.heaterPower = 2000;
+	p.tauHeater = 4;
+	p.tubeVolume = 0.5;
+	p.tubeLoss = 0.5;
+	p.flow = 4;
+	p.supplyVolume = 0.35;
+	p.returnVolume = 0.3;
+	p.mashWater = 20;
+	p.grainMass = 5;
+	p.tunHeatCap = 2000;
+	p.mashLoss = 2.5;
+	p.ambientTemp = 20;
+	p.initialTemp = 64;
+	p.tauSensor = 3;
+	p.adcNoise = 0.5;
+	p.timeStep = 0.05;
+	return p;
+}
+
+RimsPlant::RimsPlant(const RimsPlantParams& params)
+: _p(params), _heaterPowerEff(0), _heaterEnergy(0),
+  _heaterOn(false), _heaterPowered(true),
+  _stepStart(hal::nowMicros()), _lastEdge(_stepStart), _onAccum(0),
+  _heaterSwitches(0), _lineHead(0), _interruptFlow(-1), _flowFactor(0),
+  _res1(10000), _fineTuneTemp(0), _adcValid(false), _noiseState(0x2545F491)
+{
+	_tubeTemp = _mashTemp = _sensorTemp = _p.initialTemp;
+	size_t lineLength = (size_t)(MAXDEADTIME / _p.timeStep) + 1;
+	_supplyLine.assign(lineLength, _p.initialTemp);
+	_returnLine.assign(lineLength, _p.initialTemp);
+	_steinhartCoefs[0] = 0.001;
+	_steinhartCoefs[1] = 0.0002;
+	_steinhartCoefs[2] = -4e-7;
+	_steinhartCoefs[3] = 1e-7;
+}
+
+/*!
+ * \brief Same thermistor parameters as given to Rims::setThermistor().
+ */
+void RimsPlant::setThermistor(const float steinhartCoefs[4], float res1,
+							  float fineTuneTemp)
+{
+	for(int i=0;i<4;i++) _steinhartCoefs[i] = steinhartCoefs[i];
+	_res1 = res1;
+	_fineTuneTemp = fineTuneTemp;
+	_adcValid = false;
+}
+
+/*!
+ * \brief Wire the model to the HAL pins used by a Rims instance.
+ *
+ * \param analogPinTherm : analog pin read as thermistor.
+ * \param ssrPin : heater is on while this pin is HIGH.
+ * \param interruptFlow : if >= 0, external interrupt that receives the
+ *                        flow sensor pulse train.
+ * \param flowFactor : freq[Hz] = flowFactor * flow[L/min]
+ */
+void RimsPlant::attach(uint8_t analogPinTherm, uint8_t ssrPin,
+					   int interruptFlow, float flowFactor)
+{
+	hal::setAnalogSource(analogPinTherm, [this]() {
+		return this->thermistorADC();
+	});
+	hal::onPinWrite(ssrPin, [this](uint8_t level) {
+		this->setHeater(level == HIGH);
+	});
+	_interruptFlow = interruptFlow;
+	_flowFactor = flowFactor;
+	setFlow(_p.flow);
+}
+
+/*!
+ * \brief Integrate the model up to the current virtual time.
+ */
+void RimsPlant::update()
+{
+	uint64_t now = hal::nowMicros();
+	uint64_t stepMicros = (uint64_t)(_p.timeStep * 1e6);
+	while(_stepStart + stepMicros <= now)
+	{
+		uint64_t stepEnd = _stepStart + stepMicros;
+		uint64_t onTime = _onAccum;
+		if(_heaterOn)
+		{
+			onTime += stepEnd - ((_lastEdge > _stepStart) ? _lastEdge
+			                                              : _stepStart);
+		}
+		_onAccum = 0;
+		_step(_p.timeStep, onTime / 1e6);
+		_stepStart = stepEnd;
+	}
+}
+
+/*!
+ * \brief Switch heater. On-time is accounted to the microsecond.
+ */
+void RimsPlant::setHeater(bool state)
+{
+	update();
+	if(state == _heaterOn) return;
+	uint64_t now = hal::nowMicros();
+	if(_heaterOn)
+	{
+		_onAccum += now - ((_lastEdge > _stepStart) ? _lastEdge
+		                                            : _stepStart);
+	}
+	_lastEdge = now;
+	_heaterOn = state;
+	_heaterSwitches++;
+}
+
+/*!
+ * \brief Change recirculation flow [L/min] and the flow sensor pulse
+ *        train accordingly.
+ */
+void RimsPlant::setFlow(double flow)
+{
+	update();
+	_p.flow = (flow > 0) ? flow : 0;
+	if(_interruptFlow >= 0)
+	{
+		hal::setInterruptFrequency(_interruptFlow, _flowFactor * _p.flow);
+	}
+}
+
+/*!
+ * \brief Breaker on/off : with no power, SSR state has no effect.
+ */
+void RimsPlant::setHeaterPowered(bool state)
+{
+	update();
+	_heaterPowered = state;
+}
+
+/*!
+ * \brief ADC count of the thermistor divider at the current virtual
+ *        time, i.e. inverse of Rims::getTempPV().
+ *
+ * The sensor temperature only moves once per model step while the
+ * ADC is scanned several times per step : the noiseless count is kept
+ * until it does.
+ */
+int RimsPlant::thermistorADC()
+{
+	update();
+	if(not _adcValid or _sensorTemp != _adcTemp)
+	{
+		double invKelvin = 1.0 / (_sensorTemp - _fineTuneTemp + 273.15);
+		double low = -10, high = 30, logRes = 0;
+		for(int i=0;i<48;i++) // steinhart-hart is increasing in ln(R)
+		{
+			logRes = 0.5 * (low + high);
+			double val = _steinhartCoefs[0] + _steinhartCoefs[1] * logRes + \
+						 _steinhartCoefs[2] * logRes * logRes + \
+						 _steinhartCoefs[3] * logRes * logRes * logRes;
+			if(val < invKelvin) low = logRes;
+			else high = logRes;
+		}
+		double res = exp(logRes);
+		_adcValue = 1024.0 * res / (res + _res1);
+		_adcTemp = _sensorTemp;
+		_adcValid = true;
+	}
+	double adc = _adcValue;
+	if(_p.adcNoise > 0) adc += _p.adcNoise * _gaussian();
+	return constrain((int)floor(adc), 0, 1023);
+}
+
+void RimsPlant::_step(double dt, double onTime)
+{
+	double powerCmd = _heaterPowered ? _p.heaterPower * onTime / dt : 0;
+	_heaterEnergy += powerCmd * dt;
+	if(_p.tauHeater > 0)
+	{
+		_heaterPowerEff += (powerCmd - _heaterPowerEff) * \
+						   (1.0 - exp(-dt / _p.tauHeater));
+	}
+	else _heaterPowerEff = powerCmd;
+
+	double flowHeat = WORTHEATCAP * _p.flow / 60.0; // [W/K]
+	double tubeHeatCap = WORTHEATCAP * _p.tubeVolume;
+	double mashHeatCap = WORTHEATCAP * _p.mashWater + \
+						 GRAINHEATCAP * _p.grainMass + _p.tunHeatCap;
+	double inletTemp = _delayed(_supplyLine, _p.supplyVolume);
+	double returnTemp = _delayed(_returnLine, _p.returnVolume);
+
+	double dTube = (_heaterPowerEff + flowHeat * (inletTemp - _tubeTemp) - \
+					_p.tubeLoss * (_tubeTemp - _p.ambientTemp)) / tubeHeatCap;
+	double dMash = (flowHeat * (returnTemp - _mashTemp) - \
+					_p.mashLoss * (_mashTemp - _p.ambientTemp)) / mashHeatCap;
+	_tubeTemp += dTube * dt;
+	_mashTemp += dMash * dt;
+	if(_p.tauSensor > 0)
+	{
+		_sensorTemp += (_tubeTemp - _sensorTemp) * \
+					   (1.0 - exp(-dt / _p.tauSensor));
+	}
+	else _sensorTemp = _tubeTemp;
+
+	_lineHead = (_lineHead + 1) % _supplyLine.size();
+	_supplyLine[_lineHead] = _mashTemp;
+	_returnLine[_lineHead] = _tubeTemp;
+}
+
+/*!
+ * \brief Value that entered the hose volume [L] ago at current flow.
+ */
+double RimsPlant::_delayed(const std::vector<double>& line,
+						   double volume) const
+{
+	size_t steps = line.size() - 1;
+	if(_p.flow > 0)
+	{
+		double delay = 60.0 * volume / _p.flow;
+		double delaySteps = delay / _p.timeStep;
+		if(delaySteps < steps) steps = (size_t)delaySteps;
+	}
+	return line[(_lineHead + line.size() - steps) % line.size()];
+}
+
+/*!
+ * \brief Standard normal sample (xorshift32 + Box-Muller),
+ *        deterministic from run to run.
+ */
+double RimsPlant::_gaussian()
+{
+	double u[2];
+	for(int i=0;i<2;i++)
+	{
+		_noiseState ^= _noiseState << 13;
+		_noiseState ^= _noiseState >> 17;
+		_noiseState ^= _noiseState << 5;
+		u[i] = (_noiseState + 1.0) / 4294967297.0;
+	}
+	return sqrt(-2.0 * log(u[0])) * cos(2.0 * PI * u[1]);
+}
@@ -0,0 +1,121 @@
+/*!
+ * \file RimsPlant.h
+ * \brief Thermal model of a RIMS tube and mash tun for host simulations
+ *
+ * Wort leaves the mash tun, travels through the supply hose (dead
+ * time), is heated in the RIMS tube and comes back to the mash through
+ * the return hose (dead time). The thermistor sits at the tube outlet
+ * behind a first order sensor lag. Heat losses to ambient are modeled
+ * for the tube and the tun.
+ *
+ * \f[
+ * \rho c V_t \dot{T}_t = P_h + \rho c F (T_{in}-T_t) - UA_t (T_t-T_a)
+ * \f]
+ * \f[
+ * C_m \dot{T}_m = \rho c F (T_{ret}-T_m) - UA_m (T_m-T_a)
+ * \f]
+ *
+ * The model is integrated on the hal virtual clock with a fixed step.
+ * It is wired to a Rims instance with attach() : the thermistor ADC
+ * channel reads the model and SSR pin writes switch the heater.
+ */
+
+#ifndef RimsPlant_h
+#define RimsPlant_h
+
+#include <stdint.h>
+#include <vector>
+
+/*!
+ * \brief Physical parameters. Defaults describe a 20 L batch with a
+ *        2 kW heater and 4 L/min recirculation.
+ */
+struct RimsPlantParams
+{
+	double heaterPower;		///< [W]
+	double tauHeater;		///< heater element lag [sec]
+	double tubeVolume;		///< [L]
+	double tubeLoss;		///< tube losses [W/K]
+	double flow;			///< recirculation [L/min]
+	double supplyVolume;	///< hose + pump volume, tun to tube [L]
+	double returnVolume;	///< hose volume, tube to tun [L]
+	double mashWater;		///< [L]
+	double grainMass;		///< [kg]
+	double tunHeatCap;		///< tun itself [J/K]
+	double mashLoss;		///< tun losses [W/K]
+	double ambientTemp;		///< [celcius]
+	double initialTemp;		///< mash and tube at start [celcius]
+	double tauSensor;		///< thermistor lag [sec]
+	double adcNoise;		///< ADC noise standard deviation [counts]
+	double timeStep;		///< integration step [sec]
+};
+
+RimsPlantParams defaultPlantParams();
+
+class RimsPlant
+{
+public:
+	RimsPlant(const RimsPlantParams& params = defaultPlantParams());
+
+	void setThermistor(const float steinhartCoefs[4], float res1,
+					   float fineTuneTemp = 0);
+	void attach(uint8_t analogPinTherm, uint8_t ssrPin,
+				int interruptFlow = -1, float flowFactor = 0);
+
+	void update();
+	void setHeater(bool state);
+	void setFlow(double flow);
+	void setHeaterPowered(bool state);
+
+	int thermistorADC();
+
+	const RimsPlantParams& params() const { return _p; }
+	double tubeTemp() const { return _tubeTemp; }
+	double mashTemp() const { return _mashTemp; }
+	double sensorTemp() const { return _sensorTemp; }
+	double heaterEnergy() const { return _heaterEnergy; } ///< [J]
+	double flow() const { return _p.flow; }
+	unsigned long heaterSwitches() const { return _heaterSwitches; }
+
+private:
+	void _step(double dt, double onTime);
+	double _delayed(const std::vector<double>& line, double volume) const;
+	double _gaussian();
+
+	RimsPlantParams _p;
+
+	// === STATE ===
+	double _tubeTemp;
+	double _mashTemp;
+	double _sensorTemp;
+	double _heaterPowerEff;
+	double _heaterEnergy;
+
+	// === HEATER SWITCHING (exact on-time inside a step) ===
+	bool _heaterOn;
+	bool _heaterPowered;
+	uint64_t _stepStart;		///< µSec
+	uint64_t _lastEdge;			///< µSec
+	uint64_t _onAccum;			///< µSec
+	unsigned long _heaterSwitches;
+
+	// === TRANSPORT DELAYS (one sample per step) ===
+	std::vector<double> _supplyLine;
+	std::vector<double> _returnLine;
+	size_t _lineHead;
+
+	// === FLOW SENSOR ===
+	int _interruptFlow;
+	float _flowFactor;
+
+	// === THERMISTOR ===
+	float _steinhartCoefs[4];
+	float _res1;
+	float _fineTuneTemp;
+	bool _adcValid;
+	double _adcTemp;			///< sensor temperature of _adcValue [C]
+	double _adcValue;			///< noiseless ADC count at _adcTemp
+	uint32_t _noiseState;
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*!
+ * \file sketchMain.cpp
+ * \brief Host main() running an Arduino sketch on the host HAL
+ *
+ * The sketch (.ino) is compiled as C++ and linked with this file.
+ * setup() is called once, then loop() until the virtual time limit.
+ *
+ * Options :
+ * - --minutes m : virtual time to run (default 2)
+ * - --keys t:K[,t:K...] : key presses at t sec. K is one of
+ *   U, D, L, R, S (up, down, left, right, select). Default is
+ *   "1:S,2:S,3:S,4:S" which accepts every setup dialog.
+ * - --adc pin=value : constant analog value (default thermistor
+ *   reading on A1 is 512)
+ * - --flow int=hz : pulse train on external interrupt int
+ * - --serial t:text : bytes sent to the sketch at t sec ('\\n' allowed)
+ * - --fast : use hal::setFastCosts()
+ * - --echo : print serial output while running
+ * - --lcd : print the LCD content at the end
+ * - --flash file : flash memory image loaded before setup() (if it
+ *   exists) and saved at the end, to keep brew sessions across runs
+ *
+ * Flash instruction counts are printed on stderr with the run summary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "HostHal.h"
+#include "LiquidCrystal.h"
+#include "KeypadScript.h"
+#include "W25QSim.h"
+
+void setup();
+void loop();
+
+///\brief LCD declared by every example sketch
+extern LiquidCrystal lcd;
+
+namespace
+{
+
+///\brief LCD keypad shield analog pin used by the examples
+const uint8_t g_keypadPin = 0;
+///\brief Flash chip select used by the rimsMem example
+const uint8_t g_flashCSPin = A5;
+
+KeypadScript g_keypad;
+
+std::string unescape(const std::string& text)
+{
+	std::string res;
+	for(size_t i=0;i<text.size();i++)
+	{
+		if(text[i] == '\\' and i + 1 < text.size() and text[i + 1] == 'n')
+		{
+			res += '\n';
+			i++;
+		}
+		else res += text[i];
+	}
+	return res;
+}
+
+void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [--minutes m] [--keys t:K,...] "
+			"[--adc pin=value] [--flow int=hz] [--serial t:text] "
+			"[--fast] [--echo] [--lcd] [--flash file]\n", name);
+}
+
+void loadFlash(W25QSim& flash, const char* fileName)
+{
+	FILE* file = fopen(fileName, "rb");
+	if(not file) return; // new image
+	size_t size = fread(flash.data(), 1, flash.size(), file);
+	fclose(file);
+	if(size != flash.size())
+	{
+		fprintf(stderr, "%s : truncated flash image\n", fileName);
+	}
+}
+
+void saveFlash(W25QSim& flash, const char* fileName)
+{
+	FILE* file = fopen(fileName, "wb");
+	if(not file or fwrite(flash.data(), 1, flash.size(), file) != flash.size())
+	{
+		fprintf(stderr, "%s : cannot save flash image\n", fileName);
+	}
+	if(file) fclose(file);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	double minutes = 2;
+	bool showLcd = false;
+	bool echo = false;
+	W25QSim flash;
+	const char* keys = "1:S,2:S,3:S,4:S";
+	const char* flashFile = NULL;
+	hal::setAnalogValue(A1, 512);
+	for(int i=1;i<argc;i++)
+	{
+		bool hasValue = (i + 1 < argc);
+		if(not strcmp(argv[i], "--minutes") and hasValue)
+		{
+			minutes = atof(argv[++i]);
+		}
+		else if(not strcmp(argv[i], "--keys") and hasValue)
+		{
+			keys = argv[++i];
+		}
+		else if(not strcmp(argv[i], "--adc") and hasValue)
+		{
+			int pin, value;
+			if(sscanf(argv[++i], "%d=%d", &pin, &value) == 2)
+			{
+				hal::setAnalogValue(pin, value);
+			}
+		}
+		else if(not strcmp(argv[i], "--flow") and hasValue)
+		{
+			int num;
+			double freq;
+			if(sscanf(argv[++i], "%d=%lf", &num, &freq) == 2)
+			{
+				hal::setInterruptFrequency(num, freq);
+			}
+		}
+		else if(not strcmp(argv[i], "--serial") and hasValue)
+		{
+			std::string item(argv[++i]);
+			size_t colon = item.find(':');
+			if(colon != std::string::npos)
+			{
+				Serial.hostInput(unescape(item.substr(colon + 1)),
+								 (uint64_t)(atof(item.c_str()) * 1e6));
+			}
+		}
+		else if(not strcmp(argv[i], "--fast")) hal::setFastCosts();
+		else if(not strcmp(argv[i], "--echo")) echo = true;
+		else if(not strcmp(argv[i], "--lcd")) showLcd = true;
+		else if(not strcmp(argv[i], "--flash") and hasValue)
+		{
+			flashFile = argv[++i];
+		}
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	Serial.hostEcho(echo);
+	g_keypad.parse(keys);
+	g_keypad.attach(g_keypadPin);
+	if(flashFile) loadFlash(flash, flashFile);
+	hal::attachSpiDevice(g_flashCSPin, &flash);
+	hal::setTimeLimit((uint64_t)(minutes * 60e6));
+
+	unsigned long loops = 0;
+	clock_t start = clock();
+	try
+	{
+		setup();
+		while(true)
+		{
+			loop();
+			loops++;
+		}
+	}
+	catch(const hal::TimeLimitReached&)
+	{
+	}
+	double hostSec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	if(showLcd) fputs(lcd.hostRender().c_str(), stdout);
+	else if(not echo) // binary dump bytes included
+	{
+		fwrite(Serial.hostOutput().data(), 1, Serial.hostOutput().size(),
+			   stdout);
+	}
+	fprintf(stderr, "virtual time %.1f s, %lu loop() calls, "
+			"host time %.3f s\n",
+			hal::nowMicros() / 1e6, loops, hostSec);
+	if(flash.programCmds() or flash.readCmds())
+	{
+		fprintf(stderr, "flash : %lu program (%lu bytes), %lu erase, "
+				"%lu read (%lu bytes), %lu status polls\n",
+				flash.programCmds(), flash.bytesProgrammed(),
+				flash.eraseCmds(), flash.readCmds(), flash.bytesRead(),
+				flash.statusPolls());
+	}
+	if(flashFile) saveFlash(flash, flashFile);
+	return 0;
+}
@@ -0,0 +1,21 @@
+# Run COMMAND (a ;-list) and check that the number captured by REGEX in
+# its output is at most MAX. Fails if the command fails or nothing
+# matches (e.g. "mash reach sp-0.5 : -1 s", never reached).
+#
+#   cmake "-DCOMMAND=rimsSim;--minutes;40" \
+#         "-DREGEX=mash reach sp-0.5 *: *([0-9]+) s" -DMAX=1800 \
+#         -P expectMax.cmake
+
+execute_process(COMMAND ${COMMAND}
+	OUTPUT_VARIABLE output
+	RESULT_VARIABLE result)
+message("${output}")
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "${COMMAND} failed (${result})")
+endif()
+if(NOT output MATCHES "${REGEX}")
+	message(FATAL_ERROR "no match for \"${REGEX}\"")
+endif()
+if(CMAKE_MATCH_1 GREATER MAX)
+	message(FATAL_ERROR "${CMAKE_MATCH_1} is above ${MAX}")
+endif()
@@ -0,0 +1,54 @@
+# Log a brew session in the flash image of the rimsMem example, dump it
+# through Rims::checkMemAccessMode() as ASCII (<1>) and as binary (<5>),
+# then check that memDump decodes the binary dump to the same lines.
+#
+#   cmake -DRIMSMEM=rimsMem -DMEMDUMP=memDump -DWORK_DIR=dir \
+#         -P memDumpRoundTrip.cmake
+#
+# The dumps run with the UNO costs : with the fast ones, the
+# while(not Serial.available()) of the menu doesn't move the clock.
+
+set(image ${WORK_DIR}/memDumpRoundTrip.img)
+file(REMOVE ${image})
+
+# 20 min session, setup dialogs accepted by the default keys
+execute_process(COMMAND ${RIMSMEM} --fast --minutes 20 --flash ${image}
+	OUTPUT_QUIET
+	RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "session run failed (${result})")
+endif()
+
+# KEYSELECT held at setup : memory access menu, session 1
+execute_process(COMMAND ${RIMSMEM} --minutes 1 --flash ${image} --keys 0:S
+		--serial "1:1\\n1\\n" --serial "30:4\\n"
+	OUTPUT_FILE ${WORK_DIR}/memDumpRoundTrip.txt
+	RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "ASCII dump failed (${result})")
+endif()
+execute_process(COMMAND ${RIMSMEM} --minutes 1 --flash ${image} --keys 0:S
+		--serial "1:5\\n1\\n0\\n" --serial "30:4\\n"
+	OUTPUT_FILE ${WORK_DIR}/memDumpRoundTrip.bin
+	RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "binary dump failed (${result})")
+endif()
+execute_process(COMMAND ${MEMDUMP} ${WORK_DIR}/memDumpRoundTrip.bin
+	OUTPUT_FILE ${WORK_DIR}/memDumpRoundTrip.csv
+	RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "memDump failed (${result})")
+endif()
+
+file(STRINGS ${WORK_DIR}/memDumpRoundTrip.txt ascii REGEX "^[0-9]+\\.[0-9]+,")
+file(STRINGS ${WORK_DIR}/memDumpRoundTrip.csv decoded REGEX "^[0-9]+\\.[0-9]+,")
+string(REPLACE "\r" "" ascii "${ascii}")
+list(LENGTH ascii lines)
+message("${lines} data lines")
+if(lines LESS 1000)
+	message(FATAL_ERROR "ASCII dump too short")
+endif()
+if(NOT ascii STREQUAL decoded)
+	message(FATAL_ERROR "memDump output differs from the ASCII dump")
+endif()
@@ -0,0 +1,49 @@
+/*!
+ * \file thermTable.cpp
+ * \brief Generate a PROGMEM thermistor table for Rims::setThermistorTable()
+ *
+ *     ./thermTable C0 C1 C2 C3 res1 [step] > thermTable.h
+ *
+ * Temperatures are computed with Rims::thermistorTemp(), the same
+ * function used to build the SRAM table of Rims::setThermistor().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "Rims.h"
+
+int main(int argc, char** argv)
+{
+	if(argc < 6)
+	{
+		fprintf(stderr, "usage: %s C0 C1 C2 C3 res1 [step]\n", argv[0]);
+		return 1;
+	}
+	float steinhartCoefs[4];
+	for(int i=0;i<4;i++) steinhartCoefs[i] = atof(argv[i + 1]);
+	float res1 = atof(argv[5]);
+	int step = (argc > 6) ? atoi(argv[6]) : 1;
+	if(step < 1 or step > 255 or THERMADCMAX % step)
+	{
+		fprintf(stderr, "step must divide %d\n", THERMADCMAX);
+		return 1;
+	}
+	printf("// Thermistor table for Rims::setThermistorTable(thermTable,%d)\n",
+		   step);
+	printf("// C = {%g, %g, %g, %g}, res1 = %g ohm\n", steinhartCoefs[0],
+		   steinhartCoefs[1], steinhartCoefs[2], steinhartCoefs[3], res1);
+	printf("// [celcius/100] for ADC = 0, %d, ..., %d\n\n", step, THERMADCMAX);
+	printf("const int16_t thermTable[%d] PROGMEM = {", THERMADCMAX / step + 1);
+	for(int i=0;i<=THERMADCMAX/step;i++)
+	{
+		double temp = floor(100 * Rims::thermistorTemp(i * step,
+								steinhartCoefs, res1) + 0.5);
+		if(not(temp > -32768)) temp = -32768;
+		else if(temp > 32767) temp = 32767;
+		printf("%s%s%d", i ? "," : "", (i % 10) ? " " : "\n\t", (int)temp);
+	}
+	printf("\n};\n");
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*!
+ * \file AdcScan.cpp
+ * \brief AdcScan class definition
+ */
+
+#include "Arduino.h"
+#include "AdcScan.h"
+
+#if defined(ADC_vect) && defined(ADSC)
+	#define ADCSCAN_HW
+#endif
+
+byte AdcScan::_pins[ADCSCANMAXCHANNELS];
+byte AdcScan::_channelQty = 0;
+volatile unsigned int AdcScan::_values[ADCSCANMAXCHANNELS];
+volatile byte AdcScan::_sequences[ADCSCANMAXCHANNELS];
+volatile byte AdcScan::_currentChannel = 0;
+volatile boolean AdcScan::_started = false;
+
+/*!
+ * \brief Add an analog pin to the scan. Nothing is done if it's
+ *        already there.
+ * \param analogPin : byte. Same pin number as for analogRead().
+ * \return boolean : false if ADCSCANMAXCHANNELS pins are already scanned.
+ */
+boolean AdcScan::addChannel(byte analogPin)
+{
+	if(_channelOf(analogPin) != -1) return true;
+	if(_channelQty >= ADCSCANMAXCHANNELS) return false;
+	boolean wasStarted = _started;
+	stop();
+	_pins[_channelQty++] = analogPin;
+	if(wasStarted) start();
+	return true;
+}
+
+/*!
+ * \brief Start background conversions.
+ *
+ * Each pin is first read with analogRead() so that read() always
+ * returns a valid value.
+ */
+void AdcScan::start()
+{
+#ifdef ADCSCAN_HW
+	if(_started or _channelQty == 0) return;
+	for(byte i=0;i<_channelQty;i++)
+	{
+		_values[i] = analogRead(_pins[i]);
+		_sequences[i]++;
+	}
+	_currentChannel = 0;
+	_started = true;
+	ADCSRA |= (1 << ADIF); // clear flag left by stop()
+	_startConversion(0);
+#endif
+}
+
+/*!
+ * \brief Stop background conversions, e.g. before blocking dialogs
+ *        that use analogRead().
+ */
+void AdcScan::stop()
+{
+#ifdef ADCSCAN_HW
+	if(not _started) return;
+	_started = false; // ISR won't start another conversion
+	while(ADCSRA & (1 << ADSC));
+	ADCSRA &= ~(1 << ADIE);
+#endif
+}
+
+/*!
+ * \brief Latest value of an analog pin.
+ *
+ * If the pin is not scanned (or not started), the scan is paused for
+ * a normal analogRead().
+ *
+ * \param analogPin : byte. Same pin number as for analogRead().
+ * \return int : ADC value, between 0 and 1023.
+ */
+int AdcScan::read(byte analogPin)
+{
+#ifdef ADCSCAN_HW
+	if(_started)
+	{
+		int channel = _channelOf(analogPin);
+		int value;
+		if(channel != -1)
+		{
+			byte sequence;
+			do
+			{
+				sequence = _sequences[channel];
+				value = _values[channel];
+			}
+			while(sequence != _sequences[channel]);
+		}
+		else
+		{
+			stop();
+			value = analogRead(analogPin);
+			_started = true;
+			ADCSRA |= (1 << ADIF);
+			_startConversion(_currentChannel);
+		}
+		return value;
+	}
+#endif
+	return analogRead(analogPin);
+}
+
+/*!
+ * \brief Store the conversion result and start the next pin.
+ *        Called by ISR(ADC_vect) only.
+ */
+void AdcScan::isrConversionDone()
+{
+#ifdef ADCSCAN_HW
+	byte channel = _currentChannel;
+	_values[channel] = ADC;
+	_sequences[channel]++;
+	if(not _started) return;
+	if(++channel >= _channelQty) channel = 0;
+	_currentChannel = channel;
+	_startConversion(channel);
+#endif
+}
+
+/*!
+ * \return int : index of analogPin in the scan, -1 if not scanned.
+ */
+int AdcScan::_channelOf(byte analogPin)
+{
+	for(byte i=0;i<_channelQty;i++) if(_pins[i] == analogPin) return i;
+	return -1;
+}
+
+/*!
+ * \brief Select pin (as analogRead() does) and start its conversion
+ *        with the ADC complete interrupt enabled.
+ */
+void AdcScan::_startConversion(byte channel)
+{
+#ifdef ADCSCAN_HW
+	byte pin = _pins[channel];
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+	if(pin >= 54) pin -= 54;
+	ADCSRB = (ADCSRB & ~(1 << MUX5)) | (((pin >> 3) & 0x01) << MUX5);
+#else
+	if(pin >= 14) pin -= 14;
+#endif
+	ADMUX = (1 << REFS0) | (pin & 0x07);
+	ADCSRA |= (1 << ADSC) | (1 << ADIE);
+#endif
+}
+
+#ifdef ADCSCAN_HW
+/*!
+ * \brief ADC conversion complete ISR.
+ */
+ISR(ADC_vect)
+{
+	AdcScan::isrConversionDone();
+}
+#endif
@@ -0,0 +1,57 @@
+/*!
+ * \file AdcScan.h
+ * \brief AdcScan class declaration
+ */
+
+#ifndef AdcScan_h
+#define AdcScan_h
+
+///\brief Max analog pins converted in background by AdcScan
+#define ADCSCANMAXCHANNELS 4
+
+#include "Arduino.h"
+
+/*!
+ * \brief Background conversions of a few analog pins.
+ *
+ * Once started, the ADC complete interrupt stores the result of the
+ * current pin and starts the conversion of the next one, round-robin.
+ * read() then returns the latest value of a pin without waiting for
+ * the ~110 µSec of analogRead().
+ *
+ * Values are published with a sequence byte incremented by the ISR,
+ * read() copies a value again if the sequence changed meanwhile :
+ * no interrupt is ever masked.
+ *
+ * Only on AVR with the Arduino core default reference (AVcc). On
+ * other boards, read() is analogRead().
+ *
+ * \warning While started, analogRead() must not be called : read a
+ *          pin added with addChannel() or stop() first.
+ */
+class AdcScan
+{
+public:
+
+	static boolean addChannel(byte analogPin);
+	static void start();
+	static void stop();
+	static boolean started() { return _started; }
+	static int read(byte analogPin);
+
+	static void isrConversionDone();
+
+private:
+
+	static int _channelOf(byte analogPin);
+	static void _startConversion(byte channel);
+
+	static byte _pins[ADCSCANMAXCHANNELS];
+	static byte _channelQty;
+	static volatile unsigned int _values[ADCSCANMAXCHANNELS];
+	static volatile byte _sequences[ADCSCANMAXCHANNELS];
+	static volatile byte _currentChannel;
+	static volatile boolean _started;
+};
+
+#endif
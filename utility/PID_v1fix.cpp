@@ -0,0 +1,372 @@
+/**********************************************************************************************
+ * Arduino PIDfix Library - fixed-point twin of PIDmod
+ * based on PID Library by Brett Beauregard <br3ttb@gmail.com> brettbeauregard.com
+ * and PIDmod
+ * This Library is licensed under a GPLv3 License
+ **********************************************************************************************/
+
+#if ARDUINO >= 100
+  #include "Arduino.h"
+#else
+  #include "WProgram.h"
+#endif
+
+#include <PID_v1fix.h>
+
+/*Constructor (...)*********************************************************
+ *    Same as PIDmod but Input, Output and Setpoint are long.
+ ***************************************************************************/
+PIDfix::PIDfix(long* Input, long* Output, long* Setpoint,
+        double Kp, double Ki, double Kd, int ControllerDirection)
+{
+    myOutput = Output;
+    myInput = Input;
+    mySetpoint = Setpoint;
+	inAuto = false;
+	controllerDirection = DIRECT;
+	PTerm = DTerm = lastError = 0;
+
+	PIDfix::SetOutputLimits(0, 255);
+	PIDfix::SetDerivativeFilter(0);
+    SampleTime = 100;
+
+    PIDfix::SetControllerDirection(ControllerDirection);
+    PIDfix::SetTunings(Kp, Ki, Kd);
+}
+
+
+/* Compute() **********************************************************************
+ *   Same algorithm as PIDmod::Compute() (derivative filtering, integration
+ *   clamping, no time check up, elapsed time compensation) with Q16.16
+ *   arithmetic. The derivative filter is written y += (1-a)*(x-y) with
+ *   1-a in Q0.32 (in Q16.16, a filter of 80 samples would be off by
+ *   about 0.06 % of its time constant) and the 16 bits dropped from y
+ *   carried to the next sample, so small steps aren't lost. With a
+ *   timeChange that isn't SampleTime, 1-a is moved along its slope
+ *   around one sample instead of calling exp() (see StepFrac()).
+ **********************************************************************************/
+bool PIDfix::Compute(unsigned long timeChange)
+{
+   if(!inAuto) return false;
+      /*Compute all the working error variables*/
+	  long input = *myInput;
+      long error = constrain(*mySetpoint - input, -32767L, 32767L) * PIDFIX_ONE;
+	  long kiError = MulQ16(ki, error);
+      long dInput = constrain(input - lastInput, -32767L, 32767L) * PIDFIX_ONE;
+	  unsigned long beta = filterCst;
+	  if(timeChange != 0 and timeChange != SampleTime)
+	  {
+		  if(timeChange > 32767) timeChange = 32767;
+		  long ratio = (long)((timeChange << 16) / SampleTime);
+		  kiError = MulQ16(kiError, ratio);
+		  dInput = MulQ16(dInput, (long)((SampleTime << 16) / timeChange));
+		  if(beta > 0)
+		  {
+			  beta = (ratio < 2 * PIDFIX_ONE) ? \
+			         StepFrac(beta, filterSlope, ratio - PIDFIX_ONE) : \
+			         ScaleFrac(beta, ratio);
+		  }
+	  }
+	  if(not clamp) ITerm = AddSat(ITerm, kiError);
+
+	  /*Derivative filtering*/
+	  if(beta > 0)
+	  {
+		  long delta = AddSat(dInput, -lastFilterOutput);
+		  unsigned int low;
+		  long step = MulFrac(delta, beta, &low);
+		  long residue = (delta < 0) ? (long)filterResidue - (long)low
+		                             : (long)filterResidue + (long)low;
+		  if(residue < 0) { step--; residue += 0x10000L; }
+		  else if(residue > 0xFFFFL) { step++; residue -= 0x10000L; }
+		  filterResidue = (unsigned int)residue;
+		  dInput = AddSat(lastFilterOutput, step);
+	  }
+	  lastFilterOutput = dInput;
+
+      /*Compute PID Output*/
+      PTerm = MulQ16(kp, error);
+      DTerm = -MulQ16(kd, dInput);
+      long output = AddSat(AddSat(PTerm, ITerm), DTerm);
+	  long outputSat = constrain(output, outMin, outMax);
+
+	  /*Integrator clamping*/
+	  clamp = (SIGN(output) == SIGN(kiError)) and \
+			   (output != outputSat);
+
+	  *myOutput = (outputSat + (PIDFIX_ONE / 2)) / PIDFIX_ONE;
+
+      /*Remember some variables for next time*/
+      lastInput = input;
+      lastError = error;
+	  return true;
+}
+
+/* MulQ16(...) ****************************************************************
+ * Q16.16 product, rounded, saturated to +/-0x7FFFFFFF. Built from four
+ * 16x16->32 bits products (hardware assisted on AVR), no 64 bits math.
+ ******************************************************************************/
+long PIDfix::MulQ16(long a, long b)
+{
+   boolean negative = ((a < 0) != (b < 0));
+   unsigned long ua = (a < 0) ? (0UL - (unsigned long)a) : (unsigned long)a;
+   unsigned long ub = (b < 0) ? (0UL - (unsigned long)b) : (unsigned long)b;
+   unsigned long ah = ua >> 16, al = ua & 0xFFFF;
+   unsigned long bh = ub >> 16, bl = ub & 0xFFFF;
+   unsigned long res, part;
+
+   part = ah * bh;
+   if(part > 0x7FFF) return negative ? -0x7FFFFFFFL : 0x7FFFFFFFL;
+   res = part << 16;
+   part = ah * bl;
+   res += part;
+   if(res < part) return negative ? -0x7FFFFFFFL : 0x7FFFFFFFL;
+   part = al * bh;
+   res += part;
+   if(res < part) return negative ? -0x7FFFFFFFL : 0x7FFFFFFFL;
+   part = (((al * bl) >> 15) + 1) >> 1;
+   res += part;
+   if(res < part or res > 0x7FFFFFFFUL)
+   {
+      return negative ? -0x7FFFFFFFL : 0x7FFFFFFFL;
+   }
+   return negative ? -(long)res : (long)res;
+}
+
+/* MulFrac(...) ***************************************************************
+ * Q16.16 times a Q0.32 fraction, truncated toward zero : the high half of
+ * the 64 bits product, from four 16x16->32 bits partial products, and
+ * the next 16 bits of its magnitude in low. No overflow since the
+ * fraction is below 1.
+ ******************************************************************************/
+long PIDfix::MulFrac(long a, unsigned long frac, unsigned int* low)
+{
+   unsigned long ua = (a < 0) ? (0UL - (unsigned long)a) : (unsigned long)a;
+   unsigned long ah = ua >> 16, al = ua & 0xFFFF;
+   unsigned long fh = frac >> 16, fl = frac & 0xFFFF;
+   unsigned long cross1 = ah * fl, cross2 = al * fh;
+   unsigned long mid = (cross1 & 0xFFFF) + (cross2 & 0xFFFF) + ((al * fl) >> 16);
+   unsigned long res = ah * fh + (cross1 >> 16) + (cross2 >> 16) + (mid >> 16);
+   *low = (unsigned int)(mid & 0xFFFF);
+   return (a < 0) ? -(long)res : (long)res;
+}
+
+/* ScaleFrac(...) *************************************************************
+ * Q0.32 fraction times a positive Q16.16 ratio. 0 when the product
+ * reaches 1, i.e. no filtering left.
+ ******************************************************************************/
+unsigned long PIDfix::ScaleFrac(unsigned long frac, long ratio)
+{
+   unsigned long ri = (unsigned long)ratio >> 16;
+   unsigned long rf = (unsigned long)ratio & 0xFFFF;
+   unsigned long res = (frac >> 16) * rf + (((frac & 0xFFFF) * rf) >> 16);
+   if(ri > 0)
+   {
+      if(frac > 0xFFFFFFFFUL / ri) return 0;
+      unsigned long part = frac * ri;
+      res += part;
+      if(res < part or res > 0xFFFFFFFFUL) return 0;
+   }
+   return res;
+}
+
+/* StepFrac(...) **************************************************************
+ * 1-a for a timeChange of (1+eps) samples, |eps| < 1 in Q16.16 :
+ * 1-a^(1+eps) ~ (1-a) + a.ln(1/a).eps, slope = a.ln(1/a) in Q0.32. Unlike
+ * (1-a)*(1+eps), this holds for filters faster than the sample too.
+ * 0 when the result reaches 1, i.e. no filtering left.
+ ******************************************************************************/
+unsigned long PIDfix::StepFrac(unsigned long frac, unsigned long slope, long eps)
+{
+   unsigned long ue = (eps < 0) ? (0UL - (unsigned long)eps) : (unsigned long)eps;
+   unsigned long step = (slope >> 16) * ue + (((slope & 0xFFFF) * ue) >> 16);
+   if(eps < 0) return (step >= frac) ? 1 : frac - step;
+   unsigned long res = frac + step;
+   return (res < step or res > 0xFFFFFFFFUL) ? 0 : res;
+}
+
+/* AddSat(...) ****************************************************************
+ * Sum saturated to the long range instead of wrapping.
+ ******************************************************************************/
+long PIDfix::AddSat(long a, long b)
+{
+   long res = (long)((unsigned long)a + (unsigned long)b);
+   if(a > 0 and b > 0 and res < 0) return 0x7FFFFFFFL;
+   if(a < 0 and b < 0 and res >= 0) return -0x7FFFFFFFL;
+   return res;
+}
+
+/* ToQ16(...) *****************************************************************
+ * double to Q16.16, saturated. Only used when parameters change.
+ ******************************************************************************/
+long PIDfix::ToQ16(double value)
+{
+   double res = floor(value * PIDFIX_ONE + 0.5);
+   if(res >= 2147483647.0) return 0x7FFFFFFFL;
+   if(res <= -2147483647.0) return -0x7FFFFFFFL;
+   return (long)res;
+}
+
+/* SetFilterCst(...) **********************************************************
+ * 1-a in Q0.32 (0 for no filter) and its slope for StepFrac(), from the
+ * time constant [sec]. Only used when parameters change.
+ ******************************************************************************/
+void PIDfix::SetFilterCst(double tauFilter)
+{
+   filterCst = filterSlope = 0;
+   if(tauFilter <= 0) return;
+   double x = SampleTime / (tauFilter * 1000.0);
+   double alpha = exp(-x);
+   double res = floor((1.0 - alpha) * 4294967296.0 + 0.5);
+   if(res >= 4294967295.0) return;
+   filterCst = (res < 1.0) ? 1 : (unsigned long)res;
+   filterSlope = (unsigned long)floor(alpha * x * 4294967296.0 + 0.5);
+}
+
+/* FromQ16(...) ***************************************************************
+ * Q16.16 to integer, rounded half away from zero.
+ ******************************************************************************/
+long PIDfix::FromQ16(long value)
+{
+   unsigned long absValue = (value < 0) ? (0UL - (unsigned long)value)
+                                        : (unsigned long)value;
+   absValue = (absValue + (PIDFIX_ONE / 2)) / PIDFIX_ONE;
+   return (value < 0) ? -(long)absValue : (long)absValue;
+}
+
+/* SetTunings(...)*************************************************************
+ * Gains are given per celcius (per PIDFIX_INPUTSCALE Input units) like
+ * PIDmod and converted here to Q16.16 per Input unit.
+ ******************************************************************************/
+void PIDfix::SetTunings(double Kp, double Ki, double Kd)
+{
+   dispKp = Kp; dispKi = Ki; dispKd = Kd;
+
+   double SampleTimeInSec = ((double)SampleTime)/1000;
+   double way = (controllerDirection == REVERSE) ? -1.0 : 1.0;
+   kp = ToQ16(way * Kp / PIDFIX_INPUTSCALE);
+   ki = ToQ16(way * Ki * SampleTimeInSec / PIDFIX_INPUTSCALE);
+   kd = ToQ16(way * Kd / SampleTimeInSec / PIDFIX_INPUTSCALE);
+}
+
+/* SetDerivativeFilter(...)****************************************************
+ * Set time constant in second of the low pass derivative filter.
+ ******************************************************************************/
+void PIDfix::SetDerivativeFilter(double tauFilter)
+{
+	dispTauFilter = tauFilter;
+	PIDfix::SetFilterCst(tauFilter);
+	lastFilterOutput = 0;
+	filterResidue = 0;
+}
+
+/* TransferTunings(...)********************************************************
+ * Gain scheduling, same as PIDmod::TransferTunings() : the filter state
+ * is kept and the integral takes the difference of the proportional and
+ * derivative terms.
+ ******************************************************************************/
+void PIDfix::TransferTunings(double Kp, double Ki, double Kd, double tauFilter)
+{
+   PIDfix::SetTunings(Kp, Ki, Kd);
+   dispTauFilter = tauFilter;
+   PIDfix::SetFilterCst(tauFilter);
+   if(inAuto)
+   {
+      long oldTerms = AddSat(PTerm, DTerm);
+      PTerm = MulQ16(kp, lastError);
+      DTerm = -MulQ16(kd, lastFilterOutput);
+      ITerm = AddSat(ITerm, AddSat(oldTerms, -AddSat(PTerm, DTerm)));
+   }
+}
+
+/* SetSampleTime(...) *********************************************************
+ * sets the period, in Milliseconds, at which the calculation is performed.
+ * Gains and filter constant are recomputed from the user values to keep
+ * their precision.
+ ******************************************************************************/
+void PIDfix::SetSampleTime(int NewSampleTime)
+{
+   if (NewSampleTime > 0)
+   {
+      SampleTime = (unsigned long)NewSampleTime;
+      PIDfix::SetTunings(dispKp, dispKi, dispKd);
+      PIDfix::SetFilterCst(dispTauFilter);
+   }
+}
+
+/* SetOutputLimits(...)****************************************************
+ * Output range, in Output units.
+ **************************************************************************/
+void PIDfix::SetOutputLimits(double Min, double Max)
+{
+   if(Min >= Max) return;
+   outMin = ToQ16(Min);
+   outMax = ToQ16(Max);
+
+   if(inAuto)
+   {
+	   if(*myOutput > (long)Max) *myOutput = (long)Max;
+	   else if(*myOutput < (long)Min) *myOutput = (long)Min;
+
+	   if(ITerm > outMax) ITerm= outMax;
+	   else if(ITerm < outMin) ITerm= outMin;
+   }
+}
+
+/* SetMode(...)****************************************************************
+ * Allows the controller Mode to be set to manual (0) or Automatic (non-zero)
+ * when the transition from manual to auto occurs, the controller is
+ * automatically initialized
+ ******************************************************************************/
+void PIDfix::SetMode(int Mode)
+{
+    bool newAuto = (Mode == AUTOMATIC);
+    if(newAuto == !inAuto)
+    {  /*we just went from manual to auto*/
+        PIDfix::Initialize();
+    }
+    inAuto = newAuto;
+}
+
+/* Initialize()****************************************************************
+ *	bumpless transfer from manual to automatic mode.
+ ******************************************************************************/
+void PIDfix::Initialize()
+{
+   ITerm = constrain(*myOutput, -32767L, 32767L) * PIDFIX_ONE;
+   clamp = true;
+   lastInput = *myInput;
+   lastFilterOutput = 0;
+   filterResidue = 0;
+   lastError = PTerm = DTerm = 0;
+   if(ITerm > outMax) ITerm = outMax;
+   else if(ITerm < outMin) ITerm = outMin;
+}
+
+/* SetControllerDirection(...)*************************************************
+ * DIRECT (+Output leads to +Input) or REVERSE acting process.
+ ******************************************************************************/
+void PIDfix::SetControllerDirection(int Direction)
+{
+   if(inAuto && Direction !=controllerDirection)
+   {
+	  kp = (0 - kp);
+      ki = (0 - ki);
+      kd = (0 - kd);
+   }
+   controllerDirection = Direction;
+}
+
+/* Status Funcions*************************************************************
+ * Just because you set the Kp=-1 doesn't mean it actually happened.  these
+ * functions query the internal state of the PID.  they're here for display
+ * purposes.
+ ******************************************************************************/
+double PIDfix::GetKp(){ return  dispKp; }
+double PIDfix::GetKi(){ return  dispKi;}
+double PIDfix::GetKd(){ return  dispKd;}
+int PIDfix::GetMode(){ return  inAuto ? AUTOMATIC : MANUAL;}
+int PIDfix::GetDirection(){ return controllerDirection;}
+long PIDfix::GetPTerm(){ return FromQ16(PTerm);}
+long PIDfix::GetITerm(){ return FromQ16(ITerm);}
+long PIDfix::GetDTerm(){ return FromQ16(DTerm);}
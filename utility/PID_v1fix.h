@@ -0,0 +1,109 @@
+#ifndef PID_v1fix_h
+#define PID_v1fix_h
+
+#include "PID_v1mod.h"
+
+///\brief Input and Setpoint of PIDfix are in 1/PIDFIX_INPUTSCALE units
+///       (hundredths of celcius for Rims)
+#define PIDFIX_INPUTSCALE 100
+///\brief 1.0 in Q16.16 format
+#define PIDFIX_ONE 65536L
+
+/* PIDfix ******************************************************************
+ * Fixed-point twin of PIDmod. Same parallel algorithm,
+ * same derivative filter and same integration clamping, but Compute()
+ * only uses 32 bits integers, i.e. no software emulated float on AVR.
+ *
+ * - Input and Setpoint : long, in 1/PIDFIX_INPUTSCALE units.
+ *   |Setpoint - Input| must stay below 32768.
+ * - Output : long, rounded to the unit (mSec for Rims).
+ * - Internally, gains, integral term, filter state and output are
+ *   Q16.16 (16 fractional bits). Products saturate instead of wrapping,
+ *   so a term can't exceed +/-32767 output units. The derivative filter
+ *   constant is Q0.32, so slow filters keep their time constant.
+ ***************************************************************************/
+class PIDfix
+{
+
+
+  public:
+
+  //commonly used functions **************************************************************************
+    PIDfix(long*, long*, long*,           // * constructor.  links the PID to the Input, Output, and
+        double, double, double, int);     //   Setpoint.  Initial tuning parameters are also set here
+
+    void SetMode(int Mode);               // * sets PID to either Manual (0) or Auto (non-0)
+
+    bool Compute(unsigned long = 0);      // * performs the PID calculation, in fixed point.
+                                          //   Like PIDmod, the sample time is handled by
+                                          //   the caller, which can give the time elapsed
+                                          //   since the last call [mSec].
+
+    void SetOutputLimits(double, double); //clamps the output to a specific range.
+
+
+  //available but not commonly used functions ********************************************************
+    void SetTunings(double, double,       // * Same units as PIDmod::SetTunings (per Input unit
+                    double);              //   times PIDFIX_INPUTSCALE, i.e. per celcius for Rims).
+                                          //   Conversion to Q16.16 is done here, not in Compute().
+    void SetDerivativeFilter(double);     // * first-order lowpass filter on derivative part,
+                                          //   time constant in [sec].
+    void TransferTunings(double, double,  // * SetTunings() and SetDerivativeFilter() in
+                         double, double); //   AUTOMATIC mode without a bump (see PIDmod)
+    void SetControllerDirection(int);     // * DIRECT or REVERSE
+    void SetSampleTime(int);              // * [mSec]
+
+
+
+  //Display functions ****************************************************************
+    double GetKp();
+    double GetKi();
+    double GetKd();
+    int GetMode();
+    int GetDirection();
+    long GetPTerm();                      // * Terms of the last Compute(), rounded
+    long GetITerm();                      //   to Output units
+    long GetDTerm();
+
+    static long MulQ16(long, long);       // * saturated Q16.16 product, 16x16 bits partial products
+
+  private:
+    void Initialize();
+    void SetFilterCst(double);
+    static long AddSat(long, long);
+    static long MulFrac(long, unsigned long, unsigned int*);
+    static unsigned long StepFrac(unsigned long, unsigned long, long);
+    static unsigned long ScaleFrac(unsigned long, long);
+    static long ToQ16(double);
+    static long FromQ16(long);
+
+    double dispKp;
+    double dispKi;
+    double dispKd;
+    double dispTauFilter;       // * [sec]
+
+    long kp;                    // * Q16.16, per Input unit
+    long ki;                    // * Q16.16, per Input unit, times sample time
+    long kd;                    // * Q16.16, per Input unit, divided by sample time
+    unsigned long filterCst;    // * 1-a, Q0.32 in (0,1), 0 : no filter
+    unsigned long filterSlope;  // * a.ln(1/a), Q0.32
+
+    int controllerDirection;
+
+    long *myInput;
+    long *myOutput;
+    long *mySetpoint;
+
+    boolean clamp;
+
+    long ITerm, lastInput;      // * ITerm Q16.16, lastInput in Input units
+    long lastFilterOutput;      // * Q16.16
+    unsigned int filterResidue; // * next 16 bits of lastFilterOutput
+    long PTerm, DTerm;          // * Q16.16
+    long lastError;             // * Q16.16
+
+    unsigned long SampleTime;
+    long outMin, outMax;        // * Q16.16
+    bool inAuto;
+};
+#endif
@@ -25,6 +25,7 @@ PIDmod::PIDmod(double* Input, double* Output, double* Setpoint,
     myInput = Input;
     mySetpoint = Setpoint;
 	inAuto = false;
+	PTerm = DTerm = lastError = 0;
 	
 	PIDmod::SetOutputLimits(0, 255);				//default output limit corresponds to 
 												//the arduino pwm limits
@@ -50,9 +51,11 @@ PIDmod::PIDmod(double* Input, double* Output, double* Setpoint,
 // - Removed time check up
 // - Added derivative filtering
 // - Integration clamping
+// - Elapsed time compensation : with timeChange given and not
+//   SampleTime, integral and derivative use the time really elapsed.
 // Implemented outside this library.
 // WARNING WARNING WARNING
-bool PIDmod::Compute()
+bool PIDmod::Compute(unsigned long timeChange)
 {
    if(!inAuto) return false;
 //    unsigned long now = millis();
@@ -63,15 +66,25 @@ bool PIDmod::Compute()
 	  double input = *myInput;
       double error = *mySetpoint - input;
 	  double kiError = ki*error;
+      double dInput = (input - lastInput);
+	  double alpha = filterCst;
+	  if(timeChange != 0 and timeChange != SampleTime)
+	  {
+		  double ratio = (double)timeChange / SampleTime;
+		  kiError *= ratio;
+		  dInput /= ratio;       // slope per SampleTime
+		  if(tauFilterMs > 0) alpha = exp((-1.0)*timeChange/tauFilterMs);
+	  }
 	  if(not clamp) ITerm += kiError;
 	  
 	  /*Derivative filtering*/
-      double dInput = (input - lastInput);
-	  dInput = (1-filterCst)*dInput + filterCst * lastFilterOutput;
+	  dInput = (1-alpha)*dInput + alpha * lastFilterOutput;
 	  lastFilterOutput = dInput;
 	  
       /*Compute PID Output*/
-      double output = kp * error + ITerm- kd * dInput;
+      PTerm = kp * error;
+      DTerm = -kd * dInput;
+      double output = PTerm + ITerm + DTerm;
 	  double outputSat = constrain(output,outMin,outMax);
 	  
 	  /*Integrator clamping by Francis Gagnon*/
@@ -82,6 +95,7 @@ bool PIDmod::Compute()
 	  
       /*Remember some variables for next time*/
       lastInput = input;
+      lastError = error;
 //       lastTime += SampleTime;
 	  return true;
 //    }
@@ -116,6 +130,7 @@ void PIDmod::SetTunings(double Kp, double Ki, double Kd)
  ******************************************************************************/ 
 void PIDmod::SetDerivativeFilter(double tauFilter)
 {
+	tauFilterMs = (tauFilter>0) ? tauFilter*1000.0 : 0;
 	if(tauFilter>0)
 	{
 		filterCst = exp((-1.0)*SampleTime/(tauFilter*1000.0));
@@ -123,9 +138,30 @@ void PIDmod::SetDerivativeFilter(double tauFilter)
 	else filterCst = 0;
 	lastFilterOutput = 0;
 }
+
+/* TransferTunings(...)********************************************************
+ * Gain scheduling : new tunings and derivative filter time constant [sec]
+ * while the controller runs. The filter state is kept and the integral
+ * takes the difference of the proportional and derivative terms, so the
+ * output of the last Compute() is unchanged at the time of the transfer.
+ ******************************************************************************/
+void PIDmod::TransferTunings(double Kp, double Ki, double Kd, double tauFilter)
+{
+   PIDmod::SetTunings(Kp, Ki, Kd);
+   tauFilterMs = (tauFilter>0) ? tauFilter*1000.0 : 0;
+   filterCst = (tauFilter>0) ? exp((-1.0)*SampleTime/tauFilterMs) : 0;
+   if(inAuto)
+   {
+      double oldTerms = PTerm + DTerm;
+      PTerm = kp * lastError;
+      DTerm = -kd * lastFilterOutput;
+      ITerm += oldTerms - (PTerm + DTerm);
+   }
+}
   
 /* SetSampleTime(...) *********************************************************
  * sets the period, in Milliseconds, at which the calculation is performed	
+ * The derivative filter constant follows.
  ******************************************************************************/
 void PIDmod::SetSampleTime(int NewSampleTime)
 {
@@ -136,6 +172,7 @@ void PIDmod::SetSampleTime(int NewSampleTime)
       ki *= ratio;
       kd /= ratio;
       SampleTime = (unsigned long)NewSampleTime;
+      if(tauFilterMs > 0) filterCst = exp((-1.0)*SampleTime/tauFilterMs);
    }
 }
  
@@ -188,6 +225,7 @@ void PIDmod::Initialize()
    clamp = true;
    lastInput = *myInput;
    lastFilterOutput = 0;  // Francis Gagnon
+   lastError = PTerm = DTerm = 0;
    if(ITerm > outMax) ITerm = outMax;
    else if(ITerm < outMin) ITerm = outMin;
 }
@@ -219,4 +257,7 @@ double PIDmod::GetKi(){ return  dispKi;}
 double PIDmod::GetKd(){ return  dispKd;}
 int PIDmod::GetMode(){ return  inAuto ? AUTOMATIC : MANUAL;}
 int PIDmod::GetDirection(){ return controllerDirection;}
+double PIDmod::GetPTerm(){ return PTerm;}
+double PIDmod::GetITerm(){ return ITerm;}
+double PIDmod::GetDTerm(){ return DTerm;}
 
@@ -22,10 +22,12 @@ class PIDmod
 	
     void SetMode(int Mode);               // * sets PID to either Manual (0) or Auto (non-0)
 
-    bool Compute();                       // * performs the PID calculation.  it should be
+    bool Compute(unsigned long = 0);      // * performs the PID calculation.  it should be
                                           //   called every time loop() cycles. ON/OFF and
                                           //   calculation frequency can be set using SetMode
-                                          //   SetSampleTime respectively
+                                          //   SetSampleTime respectively. Optional : time elapsed
+                                          //   since the last call [mSec], integral and derivative
+                                          //   are scaled if it's not SampleTime
 
     void SetOutputLimits(double, double); //clamps the output to a specific range. 0-255 by default, but
 										  //it's likely the user will want to change this depending on
@@ -38,6 +40,10 @@ class PIDmod
                                           //   of changing tunings during runtime for Adaptive control
 	void SetDerivativeFilter(double);     // * Added by Francis Gagnon. Add a first-order
 	                                      //   lowpass filter to derivative part of given time constant [sec].
+	void TransferTunings(double, double,  // * SetTunings() and
+	                     double, double); //   SetDerivativeFilter() in AUTOMATIC mode without
+	                                      //   a bump : the integral absorbs the change of the
+	                                      //   proportional and derivative terms.
 	void SetControllerDirection(int);	  // * Sets the Direction, or "Action" of the controller. DIRECT
 										  //   means the output will increase when error is positive. REVERSE
 										  //   means the opposite.  it's very unlikely that this will be needed
@@ -53,6 +59,9 @@ class PIDmod
 	double GetKd();						  // where it's important to know what is actually 
 	int GetMode();						  //  inside the PID.
 	int GetDirection();					  //
+	double GetPTerm();					  // * Terms of the last Compute(), in Output
+	double GetITerm();					  //   units
+	double GetDTerm();					  //
 
   private:
 	void Initialize();
@@ -65,6 +74,7 @@ class PIDmod
     double ki;                  // * (I)ntegral Tuning Parameter
     double kd;                  // * (D)erivative Tuning Parameter
     double filterCst;           // * (1/N) Derivative filter constant (Francis Gagnon)
+    double tauFilterMs;         // * Derivative filter time constant [mSec]
 
 	int controllerDirection;
 
@@ -78,6 +88,8 @@ class PIDmod
 //	unsigned long lastTime;
 	double ITerm, lastInput;
 	double lastFilterOutput;      // Francis Gagnon
+	double PTerm, DTerm;
+	double lastError;
 
 	unsigned long SampleTime;
 	double outMin, outMax;
@@ -0,0 +1,117 @@
+/*!
+ * \file Profiler.cpp
+ * \brief Profiler class definition
+ */
+
+#include "Arduino.h"
+#include "Profiler.h"
+
+Profiler::Profiler()
+{
+	for(byte stage=0;stage<PROFILERMAXSTAGES;stage++) _names[stage] = NULL;
+	reset();
+}
+
+/*!
+ * \brief Clear the statistics of every stage (names are kept).
+ */
+void Profiler::reset()
+{
+	for(byte stage=0;stage<PROFILERMAXSTAGES;stage++)
+	{
+		_counts[stage] = _maxs[stage] = 0;
+		_mins[stage] = 0xFFFFFFFF;
+		_sums[stage] = 0;
+		_sumShifts[stage] = 0;
+		for(byte b=0;b<PROFILERBUCKETS;b++) _buckets[stage][b] = 0;
+	}
+}
+
+/*!
+ * \brief Name of a stage in print(). Stages without a name are not
+ *        printed.
+ * \param stage : byte. 0 to PROFILERMAXSTAGES-1
+ * \param name : const __FlashStringHelper*. F("name")
+ */
+void Profiler::setName(byte stage, const __FlashStringHelper* name)
+{
+	_names[stage] = name;
+}
+
+/*!
+ * \brief Add a run of a stage.
+ * \param stage : byte. 0 to PROFILERMAXSTAGES-1
+ * \param duration : unsigned long. micros() difference [µSec]
+ */
+void Profiler::add(byte stage, unsigned long duration)
+{
+	byte b = 0;
+	unsigned long t = duration >> PROFILERMINLOG2;
+	while(t > 0 and b < PROFILERBUCKETS-1)
+	{
+		t >>= 1;
+		b++;
+	}
+	if(_buckets[stage][b] == 0xFFFF) // keep the shape of the histogram
+	{
+		for(byte i=0;i<PROFILERBUCKETS;i++)
+		{
+			_buckets[stage][i] = (_buckets[stage][i] + 1) >> 1;
+		}
+	}
+	_buckets[stage][b]++;
+	if(_counts[stage] != 0xFFFFFFFF) _counts[stage]++;
+	t = duration >> _sumShifts[stage];
+	if(_sums[stage] > 0xFFFFFFFF - t) // keep the mean, drop a bit
+	{
+		_sums[stage] >>= 1;
+		_sumShifts[stage]++;
+		t = duration >> _sumShifts[stage];
+	}
+	_sums[stage] += t;
+	if(duration < _mins[stage]) _mins[stage] = duration;
+	if(duration > _maxs[stage]) _maxs[stage] = duration;
+}
+
+/*!
+ * \brief Mean duration of a stage [µSec]
+ */
+unsigned long Profiler::getMean(byte stage)
+{
+	if(_counts[stage] == 0) return 0;
+	return ((uint64_t)_sums[stage] << _sumShifts[stage]) / _counts[stage];
+}
+
+/*!
+ * \brief Print a CSV table, one line per named stage : runs, min,
+ *        mean and max [µSec], then the histogram buckets.
+ * \param out : Print&. Serial for instance.
+ */
+void Profiler::print(Print& out)
+{
+	byte stage, b;
+	out.print(F("stage,runs,min,mean,max,<"));
+	out.print(1UL << PROFILERMINLOG2);
+	for(b=1;b<PROFILERBUCKETS-1;b++)
+	{
+		out.print(F(",<"));
+		out.print(1UL << (PROFILERMINLOG2 + b));
+	}
+	out.print(F(",>="));
+	out.println(1UL << (PROFILERMINLOG2 + PROFILERBUCKETS - 2));
+	for(stage=0;stage<PROFILERMAXSTAGES;stage++)
+	{
+		if(_names[stage] == NULL) continue;
+		out.print(_names[stage]);             out.write(',');
+		out.print(_counts[stage]);            out.write(',');
+		out.print(_counts[stage] ? _mins[stage] : 0); out.write(',');
+		out.print(getMean(stage));            out.write(',');
+		out.print(_maxs[stage]);
+		for(b=0;b<PROFILERBUCKETS;b++)
+		{
+			out.write(',');
+			out.print(_buckets[stage][b]);
+		}
+		out.println();
+	}
+}
@@ -0,0 +1,62 @@
+/*!
+ * \file Profiler.h
+ * \brief Profiler class declaration
+ */
+
+#ifndef Profiler_h
+#define Profiler_h
+
+///\brief Stages timed by a Profiler : Rims needs TASKMAXQTY+4, 14
+///       without WITH_W25QFLASH
+#define PROFILERMAXSTAGES 15
+///\brief Histogram buckets of each stage : below 2^PROFILERMINLOG2
+///       µSec, then one per power of 2, the last one is open ended
+#define PROFILERBUCKETS 12
+#define PROFILERMINLOG2 4
+
+#include "Arduino.h"
+
+/*!
+ * \brief Timing statistics of a few loop stages.
+ *
+ * add() takes the duration of one run of a stage, measured with
+ * micros(), and keeps its min, max, mean and a log2 histogram (runs
+ * below 16 µSec, 16 to 32, 32 to 64... 16 mSec and more). Run counts
+ * saturate instead of wrapping, the buckets of a stage are halved
+ * when one of them is full (a bucket never goes back to 0). The sum
+ * behind the mean is halved, and its unit doubled, each time it would
+ * pass 2^32 (71 minutes of runs) : the mean only loses resolution.
+ * 43 bytes of RAM per stage on AVR.
+ */
+class Profiler
+{
+public:
+
+	Profiler();
+
+	void reset();
+	void setName(byte stage, const __FlashStringHelper* name);
+	void add(byte stage, unsigned long duration);
+	void print(Print& out);
+
+	unsigned long getCount(byte stage) {return _counts[stage];}
+	unsigned long getMin(byte stage) {return _mins[stage];}
+	unsigned long getMax(byte stage) {return _maxs[stage];}
+	unsigned long getMean(byte stage);
+	unsigned int getBucket(byte stage, byte bucket)
+	{
+		return _buckets[stage][bucket];
+	}
+
+private:
+
+	const __FlashStringHelper* _names[PROFILERMAXSTAGES];
+	unsigned long _counts[PROFILERMAXSTAGES];
+	unsigned long _mins[PROFILERMAXSTAGES];  // µSec
+	unsigned long _maxs[PROFILERMAXSTAGES];  // µSec
+	unsigned long _sums[PROFILERMAXSTAGES];  // 2^_sumShifts µSec
+	byte _sumShifts[PROFILERMAXSTAGES];
+	unsigned int _buckets[PROFILERMAXSTAGES][PROFILERBUCKETS];
+};
+
+#endif
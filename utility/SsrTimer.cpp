@@ -0,0 +1,161 @@
+/*!
+ * \file SsrTimer.cpp
+ * \brief SsrTimer class definition
+ */
+
+#include "Arduino.h"
+#include "SsrTimer.h"
+
+#if defined(TIMER1_COMPA_vect) && defined(WGM12)
+	#define SSRTIMER_HW
+#endif
+
+///\brief Timer1 at F_CPU/64, CTC mode : compare match every SSRTIMERTICK
+#define SSRTIMERTOP (F_CPU / 64 / 1000 * SSRTIMERTICK - 1)
+///\brief Same for one cycle of a mainsFreq Hz line
+#define SSRTIMERMAINSTOP(mainsFreq) (F_CPU / 64 / (mainsFreq) - 1)
+
+byte SsrTimer::_pinSSRs[SSRTIMERMAXCHANNELS];
+byte SsrTimer::_pinLEDs[SSRTIMERMAXCHANNELS];
+unsigned int SsrTimer::_windowSizes[SSRTIMERMAXCHANNELS];
+volatile unsigned int SsrTimer::_duties[SSRTIMERMAXCHANNELS][2];
+volatile byte SsrTimer::_dutySlots[SSRTIMERMAXCHANNELS];
+volatile unsigned int SsrTimer::_ticks[SSRTIMERMAXCHANNELS];
+volatile unsigned int SsrTimer::_accumulators[SSRTIMERMAXCHANNELS];
+volatile boolean SsrTimer::_ons[SSRTIMERMAXCHANNELS];
+volatile boolean SsrTimer::_attached[SSRTIMERMAXCHANNELS];
+byte SsrTimer::_mainsFreq = 0;
+byte SsrTimer::_channelQty = 0;
+
+/*!
+ * \brief Attach an SSR channel, with a window starting now and a duty
+ *        of 0. The interrupt is started with the first channel.
+ * \param pinSSR : byte. SSR pin
+ * \param pinLED : byte. LED pin, follows the SSR.
+ * \param windowSize : unsigned int. Time proportioning window [mSec]
+ * \param mainsFreq : byte. 0 for one on-time block per window, else
+ *                    50 or 60 [Hz] to spread the on-time in mains
+ *                    cycles.
+ * \return int8_t : channel for setDuty() and detach(), -1 if refused
+ *                  (no Timer1, no free channel or other modulation
+ *                  running).
+ */
+int8_t SsrTimer::attach(byte pinSSR, byte pinLED, unsigned int windowSize,
+                        byte mainsFreq)
+{
+#ifdef SSRTIMER_HW
+	byte channel;
+	if(_channelQty > 0 and mainsFreq != _mainsFreq) return -1;
+	for(channel=0;channel<SSRTIMERMAXCHANNELS;channel++)
+	{
+		if(not _attached[channel]) break;
+	}
+	if(channel == SSRTIMERMAXCHANNELS) return -1;
+	_pinSSRs[channel] = pinSSR;
+	_pinLEDs[channel] = pinLED;
+	_windowSizes[channel] = windowSize;
+	_duties[channel][0] = _duties[channel][1] = 0;
+	_ticks[channel] = _accumulators[channel] = 0;
+	_ons[channel] = false;
+	digitalWrite(pinSSR,LOW);
+	digitalWrite(pinLED,LOW);
+	_attached[channel] = true; // last : the ISR may read it from now
+	if(_channelQty++ == 0)
+	{
+		_mainsFreq = mainsFreq;
+		TCCR1A = 0;
+		TCCR1B = 0;
+		TCNT1 = 0;
+		OCR1A = mainsFreq ? SSRTIMERMAINSTOP(mainsFreq) : SSRTIMERTOP;
+		TIFR1 = (1 << OCF1A);
+		TIMSK1 = (1 << OCIE1A);
+		TCCR1B = (1 << WGM12) | (1 << CS11) | (1 << CS10); // F_CPU/64
+	}
+	return (int8_t)channel;
+#else
+	return -1;
+#endif
+}
+
+/*!
+ * \brief Detach a channel, its SSR and LED pins are set LOW. The
+ *        interrupt is stopped with the last channel.
+ * \param channel : int8_t. From attach(), -1 is ignored.
+ */
+void SsrTimer::detach(int8_t channel)
+{
+#ifdef SSRTIMER_HW
+	byte ch = (byte)channel;
+	if(channel < 0 or not _attached[ch]) return;
+	_attached[ch] = false;
+	if(--_channelQty == 0)
+	{
+		TIMSK1 = 0;
+		TCCR1B = 0;
+	}
+	_ons[ch] = false;
+	digitalWrite(_pinSSRs[ch],LOW);
+	digitalWrite(_pinLEDs[ch],LOW);
+#endif
+}
+
+/*!
+ * \brief Publish the on-time of the window of a channel, used from the
+ *        next tick.
+ * \param channel : int8_t. From attach()
+ * \param onTime : unsigned int. [mSec], windowSize or more : always ON
+ */
+void SsrTimer::setDuty(int8_t channel, unsigned int onTime)
+{
+	byte ch = (byte)channel;
+	byte slot = _dutySlots[ch] ^ 1;
+	_duties[ch][slot] = (onTime < _windowSizes[ch]) ? onTime : \
+	                                                  _windowSizes[ch];
+	_dutySlots[ch] = slot;
+}
+
+/*!
+ * \brief For each channel, switch the pins at the edges of the on-time
+ *        (window), or decide if this mains cycle is ON (sigma-delta).
+ *        Called by ISR(TIMER1_COMPA_vect) only.
+ */
+void SsrTimer::isrTick()
+{
+	for(byte ch=0;ch<SSRTIMERMAXCHANNELS;ch++)
+	{
+		if(not _attached[ch]) continue;
+		unsigned int duty = _duties[ch][_dutySlots[ch]];
+		boolean on;
+		if(_mainsFreq)
+		{
+			unsigned int accumulator = _accumulators[ch] + duty;
+			on = (accumulator >= _windowSizes[ch]);
+			if(on) accumulator -= _windowSizes[ch];
+			_accumulators[ch] = accumulator;
+		}
+		else
+		{
+			unsigned int tick = _ticks[ch];
+			on = (tick < duty);
+			tick += SSRTIMERTICK;
+			if(tick >= _windowSizes[ch]) tick = 0;
+			_ticks[ch] = tick;
+		}
+		if(on != _ons[ch])
+		{
+			digitalWrite(_pinSSRs[ch],on);
+			digitalWrite(_pinLEDs[ch],on);
+			_ons[ch] = on;
+		}
+	}
+}
+
+#ifdef SSRTIMER_HW
+/*!
+ * \brief Timer1 compare match A ISR.
+ */
+ISR(TIMER1_COMPA_vect)
+{
+	SsrTimer::isrTick();
+}
+#endif
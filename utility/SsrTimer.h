@@ -0,0 +1,73 @@
+/*!
+ * \file SsrTimer.h
+ * \brief SsrTimer class declaration
+ */
+
+#ifndef SsrTimer_h
+#define SsrTimer_h
+
+///\brief Period of the Timer1 interrupt, one SSR on-time step [mSec]
+///       (window modulation)
+#define SSRTIMERTICK 1
+///\brief SSR channels driven by the interrupt (one per Rims instance,
+///       e.g. an HLT loop and a RIMS loop on the same board)
+#define SSRTIMERMAXCHANNELS 2
+
+#include "Arduino.h"
+
+/*!
+ * \brief SSR time proportioning driven by the Timer1 compare interrupt.
+ *
+ * Each Rims instance attaches its own channel (SSR pin, LED pin and
+ * duty) and the same interrupt switches every channel. Once attached,
+ * the TIMER1_COMPA interrupt runs every SSRTIMERTICK mSec : the SSR and
+ * LED pins are HIGH for the first setDuty() mSec of each window of the
+ * channel, then LOW. A slow loop pass (LCD, serial, flash) doesn't
+ * stretch or cut the on-time anymore.
+ *
+ * Attached with a mains frequency, the interrupt runs once per mains
+ * cycle instead and the on-time is spread over the window (sigma-delta,
+ * or burst firing) : the duty is added to an accumulator at each cycle,
+ * the cycle is ON when it reaches the window size, which is then taken
+ * off. With a zero-cross SSR, a 40 % duty at 60 Hz is 2 cycles ON out
+ * of 5 instead of 2 sec ON then 3 sec OFF. The interrupt rate is set by
+ * the first channel attached : a channel asking for another modulation
+ * is refused, like a channel beyond SSRTIMERMAXCHANNELS.
+ *
+ * The duty is double-buffered : setDuty() writes the slot the ISR
+ * doesn't read, then switches slots with a single byte write. No
+ * interrupt is ever masked.
+ *
+ * Only on AVR with Timer1 (UNO, Mega...). On other boards, or when
+ * attach() refuses the channel, Rims refreshes the SSR from its loop.
+ *
+ * \warning While a channel is attached, Timer1 is taken : no
+ *          analogWrite() on pins 9 and 10 (UNO) and no Servo library.
+ */
+class SsrTimer
+{
+public:
+
+	static int8_t attach(byte pinSSR, byte pinLED, unsigned int windowSize,
+	                     byte mainsFreq = 0);
+	static void detach(int8_t channel);
+	static void setDuty(int8_t channel, unsigned int onTime);
+
+	static void isrTick();
+
+private:
+
+	static byte _pinSSRs[SSRTIMERMAXCHANNELS];
+	static byte _pinLEDs[SSRTIMERMAXCHANNELS];
+	static unsigned int _windowSizes[SSRTIMERMAXCHANNELS]; // mSec
+	static volatile unsigned int _duties[SSRTIMERMAXCHANNELS][2]; // mSec ON
+	static volatile byte _dutySlots[SSRTIMERMAXCHANNELS]; // read by the ISR
+	static volatile unsigned int _ticks[SSRTIMERMAXCHANNELS]; // in window
+	static volatile unsigned int _accumulators[SSRTIMERMAXCHANNELS]; // mSec
+	static volatile boolean _ons[SSRTIMERMAXCHANNELS];
+	static volatile boolean _attached[SSRTIMERMAXCHANNELS];
+	static byte _mainsFreq;              // of the running timer, 0 : window
+	static byte _channelQty;             // attached channels
+};
+
+#endif
@@ -0,0 +1,292 @@
+/*!
+ * \file Telemetry.cpp
+ * \brief Telemetry class definition
+ */
+
+#include "Arduino.h"
+#include "Telemetry.h"
+
+///\brief Largest formatted data point : CSV line (11 characters and a
+///       comma per field at most, then CR LF). An escaped frame is
+///       shorter (2*TELEMETRYMAXFRAME+2).
+#define TELEMETRYMAXPOINT (12*TELEMETRYFIELDQTY+2)
+
+#ifndef pgm_read_ptr
+///\brief avr-libc of IDE 1.0.x has no pgm_read_ptr, AVR pointers are words
+#define pgm_read_ptr(addr) ((const void*)pgm_read_word(addr))
+#endif
+
+const char g_telemetryTime[] PROGMEM = "time";
+const char g_telemetrySP[] PROGMEM = "sp";
+const char g_telemetryCV[] PROGMEM = "cv";
+const char g_telemetryPV[] PROGMEM = "pv";
+const char g_telemetryFlow[] PROGMEM = "flow";
+const char g_telemetryTimer[] PROGMEM = "timerRemaining";
+const char g_telemetryPTerm[] PROGMEM = "pTerm";
+const char g_telemetryITerm[] PROGMEM = "iTerm";
+const char g_telemetryDTerm[] PROGMEM = "dTerm";
+///\brief CSV column of each field
+const char* const g_telemetryNames[TELEMETRYFIELDQTY] PROGMEM = {
+	g_telemetryTime, g_telemetrySP, g_telemetryCV, g_telemetryPV,
+	g_telemetryFlow, g_telemetryTimer, g_telemetryPTerm, g_telemetryITerm,
+	g_telemetryDTerm};
+///\brief Size of each field in binary frames [bytes]
+const byte g_telemetrySizes[TELEMETRYFIELDQTY] PROGMEM = {4,2,2,2,2,4,4,4,4};
+///\brief Decimals of the fixed point value of each field
+const byte g_telemetryDecimals[TELEMETRYFIELDQTY] PROGMEM = \
+	{3,2,0,2,2,0,0,0,0};
+///\brief Decimals of each field in CSV lines
+const byte g_telemetryPrintDecimals[TELEMETRYFIELDQTY] PROGMEM = \
+	{3,1,0,3,2,0,0,0,0};
+
+byte Telemetry::_buffer[TELEMETRYBUFSIZE];
+byte Telemetry::_head = 0;
+byte Telemetry::_qty = 0;
+#ifndef TELEMETRYAVAILABLEFORWRITE
+unsigned int Telemetry::_byteTime;
+byte Telemetry::_txQueued = 0;
+unsigned long Telemetry::_lastDrain = 0;
+#endif
+
+Telemetry::Telemetry()
+: _mode(TELEMETRYCSV), _fields(TELEMETRYDEFAULTFIELDS), _dropped(0)
+{
+	setMode(TELEMETRYCSV);
+}
+
+/*!
+ * \brief Choose how data points are sent. Can be changed at any time,
+ *        data points already in the ring buffer are still sent.
+ * \param mode : byte. TELEMETRYCSV (default), TELEMETRYBINARY or
+ *               TELEMETRYOFF.
+ * \param baud : unsigned long (default=TELEMETRYBAUD). Same as given
+ *               to Serial.begin(), only used without
+ *               Serial.availableForWrite().
+ */
+void Telemetry::setMode(byte mode, unsigned long baud)
+{
+	_mode = mode;
+#ifndef TELEMETRYAVAILABLEFORWRITE
+	_byteTime = (10000000UL + baud - 1) / baud; // 10 bits per byte
+#endif
+}
+
+/*!
+ * \brief Print the CSV header line of the selected fields (blocking,
+ *        before reset()). Nothing with TELEMETRYBINARY or TELEMETRYOFF.
+ */
+void Telemetry::printHeader()
+{
+	byte field;
+	boolean first = true;
+	if(_mode != TELEMETRYCSV) return;
+	for(field=0;field<TELEMETRYFIELDQTY;field++)
+	{
+		if(not(_fields & (1 << field))) continue;
+		if(not first) Serial.write(',');
+		Serial.print((const __FlashStringHelper*) \
+		             pgm_read_ptr(&g_telemetryNames[field]));
+		first = false;
+	}
+	Serial.println();
+}
+
+/*!
+ * \brief Empty the ring buffer (shared). Without
+ *        Serial.availableForWrite(), the hardware TX buffer is assumed
+ *        full : call it right after the last Serial.print().
+ */
+void Telemetry::reset()
+{
+	_head = _qty = 0;
+	_dropped = 0;
+#ifndef TELEMETRYAVAILABLEFORWRITE
+	_txQueued = TELEMETRYTXBUFSIZE;
+	_lastDrain = micros();
+#endif
+}
+
+/*!
+ * \brief Format a data point in the ring buffer, selected fields
+ *        only (see setFields()).
+ *
+ * With TELEMETRYCSV, it's a line of the printHeader() columns, as
+ * Serial.print() would have written it (g_telemetryPrintDecimals). With
+ * TELEMETRYBINARY, it's a SLIP frame : TELEMETRYFRAME, data points
+ * dropped so far (2 bytes), fields selected (2 bytes), the value of
+ * each field selected (g_telemetrySizes), then a CRC16 (CCITT,
+ * initial value 0xFFFF) of the previous bytes. Values are little
+ * endian, signed except the CRC.
+ *
+ * \param values : long[TELEMETRYFIELDQTY]. Every field, fixed point
+ *                 with g_telemetryDecimals decimals.
+ * \return boolean : false if dropped, the ring buffer is full.
+ */
+boolean Telemetry::push(const long values[TELEMETRYFIELDQTY])
+{
+	byte data[TELEMETRYMAXPOINT], frame[TELEMETRYMAXFRAME], *end;
+	byte i, field, n = 0, frameSize;
+	unsigned int crc = 0xFFFF;
+	char* line = (char*)data;
+	long value;
+	byte decimals, printDecimals;
+	if(_mode == TELEMETRYCSV)
+	{
+		for(field=0;field<TELEMETRYFIELDQTY;field++)
+		{
+			if(not(_fields & (1 << field))) continue;
+			value = values[field];
+			decimals = pgm_read_byte(&g_telemetryDecimals[field]);
+			printDecimals = pgm_read_byte(&g_telemetryPrintDecimals[field]);
+			for(i=decimals;i<printDecimals;i++) value *= 10;
+			for(i=printDecimals;i<decimals;i++)
+			{
+				value = (value + (value < 0 ? -5 : 5)) / 10;
+			}
+			if(line != (char*)data) *line++ = ',';
+			line = _putFixed(line,value,printDecimals);
+		}
+		*line++ = '\r';
+		*line++ = '\n';
+		n = line - (char*)data;
+	}
+	else if(_mode == TELEMETRYBINARY)
+	{
+		frame[0] = TELEMETRYFRAME;
+		end = _putLE(frame+1,_dropped,2);
+		end = _putLE(end,_fields,2);
+		for(field=0;field<TELEMETRYFIELDQTY;field++)
+		{
+			if(not(_fields & (1 << field))) continue;
+			end = _putLE(end,values[field],
+			             pgm_read_byte(&g_telemetrySizes[field]));
+		}
+		frameSize = end - frame;
+		for(i=0;i<frameSize;i++) crc = crc16(crc,frame[i]);
+		_putLE(end,crc,2);
+		frameSize += 2;
+		data[n++] = SLIPEND;
+		for(i=0;i<frameSize;i++)
+		{
+			if(frame[i] == SLIPEND or frame[i] == SLIPESC)
+			{
+				data[n++] = SLIPESC;
+				data[n++] = (frame[i] == SLIPEND) ? SLIPESCEND : SLIPESCESC;
+			}
+			else data[n++] = frame[i];
+		}
+		data[n++] = SLIPEND;
+	}
+	if(_put(data,n)) return true;
+	_dropped++;
+	return false;
+}
+
+/*!
+ * \brief Move bytes of the ring buffer to the hardware TX buffer,
+ *        without waiting. Call it at each iteration.
+ */
+void Telemetry::drain()
+{
+	byte n;
+#ifdef TELEMETRYAVAILABLEFORWRITE
+	int room = Serial.availableForWrite();
+	n = (room < _qty) ? room : _qty;
+#else
+	unsigned long now = micros();
+	unsigned long sent = (now - _lastDrain) / _byteTime;
+	if(sent >= _txQueued)
+	{
+		_txQueued = 0;
+		_lastDrain = now;
+	}
+	else
+	{
+		_txQueued -= sent;
+		_lastDrain += sent * _byteTime;
+	}
+	n = TELEMETRYTXBUFSIZE - _txQueued;
+	if(n > _qty) n = _qty;
+	_txQueued += n;
+#endif
+	_qty -= n;
+	while(n--)
+	{
+		Serial.write(_buffer[_head]);
+		_head = (_head + 1) % TELEMETRYBUFSIZE;
+	}
+}
+
+/*!
+ * \brief Update a CRC16 (CCITT, polynomial 0x1021).
+ * \param crc : unsigned int. CRC of the previous bytes.
+ * \param data : byte. Next byte.
+ * \return unsigned int : updated CRC.
+ */
+unsigned int Telemetry::crc16(unsigned int crc, byte data)
+{
+	byte i;
+	crc ^= (unsigned int)data << 8;
+	for(i=0;i<8;i++)
+	{
+		crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc & 0xFFFF;
+}
+
+/*!
+ * \brief Copy a formatted data point in the ring buffer, whole or
+ *        not at all.
+ */
+boolean Telemetry::_put(const byte data[], byte n)
+{
+	byte i, tail;
+	if(n > TELEMETRYBUFSIZE - _qty) return false;
+	tail = (_head + _qty) % TELEMETRYBUFSIZE;
+	for(i=0;i<n;i++)
+	{
+		_buffer[tail] = data[i];
+		tail = (tail + 1) % TELEMETRYBUFSIZE;
+	}
+	_qty += n;
+	return true;
+}
+
+/*!
+ * \brief Write a fixed point value in decimal, e.g. 68125 with 3
+ *        decimals is "68.125".
+ * \return char* : after the last character written.
+ */
+char* Telemetry::_putFixed(char* dst, long value, byte decimals)
+{
+	char digits[11];
+	byte n = 0;
+	unsigned long absValue = (value < 0) ? -value : value;
+	if(value < 0) *dst++ = '-';
+	do
+	{
+		digits[n++] = '0' + absValue % 10;
+		absValue /= 10;
+	}
+	while(absValue > 0 or n <= decimals);
+	while(n > 0)
+	{
+		if(n == decimals) *dst++ = '.';
+		*dst++ = digits[--n];
+	}
+	return dst;
+}
+
+/*!
+ * \brief Write the size low bytes of a value, little endian.
+ * \return byte* : after the last byte written.
+ */
+byte* Telemetry::_putLE(byte* dst, unsigned long value, byte size)
+{
+	while(size--)
+	{
+		*dst++ = value & 0xFF;
+		value >>= 8;
+	}
+	return dst;
+}
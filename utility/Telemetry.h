@@ -0,0 +1,117 @@
+/*!
+ * \file Telemetry.h
+ * \brief Telemetry class declaration
+ */
+
+#ifndef Telemetry_h
+#define Telemetry_h
+
+///\brief Bytes waiting in the Telemetry ring buffer (one for Serial)
+#define TELEMETRYBUFSIZE 128
+///\brief Hardware TX buffer of the Arduino core [bytes]
+#define TELEMETRYTXBUFSIZE 64
+///\brief Serial.availableForWrite() is in the cores of IDE 1.6.6 and
+///       later, older ones fall back on a baud rate timing model
+#if ARDUINO >= 10606
+	#define TELEMETRYAVAILABLEFORWRITE
+#endif
+///\brief Default serial baud rate
+#define TELEMETRYBAUD 115200
+
+///\brief No telemetry
+#define TELEMETRYOFF 0
+///\brief One CSV line per data point (see Telemetry::printHeader())
+#define TELEMETRYCSV 1
+///\brief One SLIP frame per data point, see Telemetry::push()
+#define TELEMETRYBINARY 2
+
+///\brief SLIP frame delimiter (binary telemetry and memory dump)
+#define SLIPEND 0xC0
+///\brief SLIP escape, followed by SLIPESCEND or SLIPESCESC
+#define SLIPESC 0xDB
+#define SLIPESCEND 0xDC
+#define SLIPESCESC 0xDD
+
+///\brief Fields of a data point, bits of Telemetry::setFields()
+#define TELEMETRYTIME   0x0001 /// [mSec]
+#define TELEMETRYSP     0x0002 /// set point [celcius/100]
+#define TELEMETRYCV     0x0004 /// SSR control value [mSec at ON state]
+#define TELEMETRYPV     0x0008 /// temperature [celcius/100]
+#define TELEMETRYFLOW   0x0010 /// [L/min/100]
+#define TELEMETRYTIMER  0x0020 /// timer remaining [sec]
+#define TELEMETRYPTERM  0x0040 /// PID proportional term [mSec]
+#define TELEMETRYITERM  0x0080 /// PID integral term [mSec]
+#define TELEMETRYDTERM  0x0100 /// PID derivative term [mSec]
+///\brief Number of fields, index of a field is its bit number
+#define TELEMETRYFIELDQTY 9
+///\brief Fields of g_csvHeader
+#define TELEMETRYDEFAULTFIELDS 0x003F
+
+///\brief Type of a binary telemetry frame (first byte)
+#define TELEMETRYFRAME 'T'
+///\brief Bytes of a binary telemetry frame with every field, CRC included
+#define TELEMETRYMAXFRAME 35
+
+#include "Arduino.h"
+
+// In program memory
+extern const char* const g_telemetryNames[TELEMETRYFIELDQTY] PROGMEM;
+extern const byte g_telemetrySizes[TELEMETRYFIELDQTY] PROGMEM;
+extern const byte g_telemetryDecimals[TELEMETRYFIELDQTY] PROGMEM;
+extern const byte g_telemetryPrintDecimals[TELEMETRYFIELDQTY] PROGMEM;
+
+/*!
+ * \brief Data points sent on the serial port without ever waiting.
+ *
+ * push() formats a data point (CSV line or binary frame) in a ring
+ * buffer, or drops it when the buffer is full. drain() then moves
+ * bytes to the hardware TX buffer, only as many as it can take
+ * (Serial.availableForWrite()), so Serial.write() never blocks. With
+ * cores older than IDE 1.6.6, the bytes sent since the last call are
+ * deduced from the baud rate instead : a Serial.print() in between
+ * then makes the next drain() wait for one TX buffer at most.
+ *
+ * The ring buffer and the TX state belong to the serial port : they
+ * are shared by every instance (several Rims on one Serial), only the
+ * mode, the fields and the dropped count are per instance.
+ */
+class Telemetry
+{
+public:
+
+	Telemetry();
+
+	void setMode(byte mode, unsigned long baud = TELEMETRYBAUD);
+	byte getMode() {return _mode;}
+	void setFields(unsigned int fields) {_fields = fields;}
+	unsigned int getFields() {return _fields;}
+	void printHeader();
+	void reset();
+	boolean push(const long values[TELEMETRYFIELDQTY]);
+	void drain();
+	unsigned int dropped() {return _dropped;}
+
+	static unsigned int crc16(unsigned int crc, byte data);
+
+private:
+
+	boolean _put(const byte data[], byte n);
+	static char* _putFixed(char* dst, long value, byte decimals);
+	static byte* _putLE(byte* dst, unsigned long value, byte size);
+
+	byte _mode;
+	unsigned int _fields;     // TELEMETRYTIME | TELEMETRYSP...
+	unsigned int _dropped;    // data points dropped, buffer full
+	
+	// Serial port, shared
+	static byte _buffer[TELEMETRYBUFSIZE];
+	static byte _head;               // oldest byte in _buffer
+	static byte _qty;                // bytes in _buffer
+#ifndef TELEMETRYAVAILABLEFORWRITE
+	static unsigned int _byteTime;   // µSec per byte on the serial line
+	static byte _txQueued;           // bytes still in the hardware TX buffer
+	static unsigned long _lastDrain; // µSec
+#endif
+};
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "Arduino.h"
 #include "UIRims.h"
+#include "AdcScan.h"
 
 /*!
  * \brief Constructor
@@ -16,17 +17,21 @@
  */
 UIRims::UIRims(LiquidCrystal* lcd, byte pinKeysAnalog,
 			   byte pinLight,char pinSpeaker)
-: _lcd(lcd), _pinKeysAnalog(pinKeysAnalog),_waitNone(true),
-  _cursorCol(0), _cursorRow(0), _pinLight(pinLight), 
-  _pinSpeaker(pinSpeaker),
+: _lcd(lcd), _cursorCol(0), _cursorRow(0), _cursorMoved(false),
+  _blink(false), _blinkShown(false),
+  _pinKeysAnalog(pinKeysAnalog), _pinLight(pinLight), 
+  _pinSpeaker(pinSpeaker), _waitNone(true),
   _tempSP(0), _tempPV(0), _time(0), _flow(0),
   _flowLowBound(-1),_flowUpBound(100)
 {
+	AdcScan::addChannel(pinKeysAnalog);
 	pinMode(pinLight,OUTPUT);
 	if(pinSpeaker != -1) pinMode(pinSpeaker,OUTPUT);
 	digitalWrite(pinLight,HIGH);
 	_lcd->begin(LCDCOLUMNS,LCDROWS);
 	_lcd->clear();
+	memset(_screen,' ',sizeof(_screen));
+	memset(_shown,' ',sizeof(_shown));
 	byte okChar[8] = {
 		B01110,
 		B10001,
@@ -68,10 +73,10 @@ UIRims::UIRims(LiquidCrystal* lcd, byte pinKeysAnalog,
 void UIRims::showTempScreen()
 {
 	_tempScreenShown = true;
-	_lcd->noBlink();
-	_lcd->clear();
-	_printStrLCD("SP:00.0\xdf""C(000\xdf""F)",0,0);
-	_printStrLCD("PV:00.0\xdf""C(000\xdf""F)",0,1);
+	_setBlink(false);
+	_clearLCD();
+	_printStrLCD(F("SP:00.0\xdf""C(000\xdf""F)"),0,0);
+	_printStrLCD(F("PV:00.0\xdf""C(000\xdf""F)"),0,1);
 	this->setTempSP(_tempSP);
 	this->setTempPV(_tempPV, false);
 }
@@ -82,10 +87,10 @@ void UIRims::showTempScreen()
 void UIRims::showTimeFlowScreen()
 {
 	_tempScreenShown = false;
-	_lcd->noBlink();
-	_lcd->clear();
-	_printStrLCD("time:000m00s   x",0 ,0);
-	_printStrLCD(String("flow:00.0L/min \x01"),0,1);
+	_setBlink(false);
+	_clearLCD();
+	_printStrLCD(F("time:000m00s   x"),0 ,0);
+	_printStrLCD(F("flow:00.0L/min \x01"),0,1);
 	this->setTime(_time);
 	this->setFlow(_flow,false);
 }
@@ -99,16 +104,65 @@ void UIRims::switchScreen()
 	else this->showTempScreen();
 }
 
+/*!
+ * \brief Send changed cells to _lcd.
+ *
+ * Screens and setters only write in a copy of the screen : the cells
+ * that differ from what _lcd shows are sent here, at most maxCells at
+ * a time, so a screen switch is spread on many calls. Call it at each
+ * iteration, and while waiting in a dialog.
+ *
+ * \param maxCells : byte. Cells sent at most, each run of consecutive
+ *                   cells also costs a cursor move.
+ */
+void UIRims::refreshLCD(byte maxCells)
+{
+	byte col, row, cells = 0;
+	boolean contiguous;
+	for(row=0;row<LCDROWS and cells<maxCells;row++)
+	{
+		contiguous = false;
+		for(col=0;col<LCDCOLUMNS and cells<maxCells;col++)
+		{
+			if(_screen[row][col] == _shown[row][col])
+			{
+				contiguous = false;
+				continue;
+			}
+			if(not contiguous) _lcd->setCursor(col,row);
+			_lcd->write((byte)_screen[row][col]);
+			_shown[row][col] = _screen[row][col];
+			_cursorMoved = true;
+			contiguous = true;
+			cells++;
+		}
+	}
+	if(_blink and _cursorMoved)
+	{
+		_lcd->setCursor(_cursorCol,_cursorRow);
+		_cursorMoved = false;
+	}
+	if(_blink != _blinkShown)
+	{
+		_blink ? _lcd->blink() : _lcd->noBlink();
+		_blinkShown = _blink;
+	}
+}
+
 /*!
  * \brief Read keys without software debouce. 
+ *
+ * Keypad pin is converted in background by AdcScan once Rims
+ * regulation is started, so this doesn't wait for the ADC.
+ *
  * \param waitNone : boolean. If true, KEYNONE must be detected
  *        to return anything else than KEYNONE.
  * \return byte : KEYNONE, KEYUP, KEYDOWN, KEYLEFT, KEYRIGHT or KEYSELECT
  */
 byte UIRims::readKeysADC(boolean waitNone)
 {
-	byte res;
-	int adcKeyVal = analogRead(_pinKeysAnalog);  
+	byte res = KEYNONE;
+	int adcKeyVal = AdcScan::read(_pinKeysAnalog);
 	if (adcKeyVal > 1000) res = KEYNONE;
 	else if (adcKeyVal < 50) res = KEYRIGHT;
 	else if (adcKeyVal < 195) res = KEYUP;
@@ -139,6 +193,7 @@ byte UIRims::_waitForKeyChange()
 	unsigned long refTime = millis(), currentTime;
 	while(not keyConfirmed)
 	{
+		refreshLCD();
 		currentTime = millis();
 		currentKey = this->readKeysADC(false);
 		if(keyDetected)
@@ -167,13 +222,13 @@ void UIRims::timerRunningChar(boolean state)
 		_setCursorPosition(15,0);
 		if(state == true)
 		{
-			_printStrLCD("\x01",15,0);
-			_lcd->blink();
+			_printStrLCD(F("\x01"),15,0);
+			_setBlink(true);
 		}
 		else
 		{
-			_printStrLCD("x",15,0);
-			_lcd->noBlink();
+			_printStrLCD(F("x"),15,0);
+			_setBlink(false);
 		}
 	}
 }
@@ -208,56 +263,132 @@ void UIRims::lcdLight(boolean state)
 void UIRims::_waitTime(unsigned long timeInMilliSec)
 {
 	unsigned long startTime = millis();
-	while(millis() - startTime <= timeInMilliSec) continue;
+	while(millis() - startTime <= timeInMilliSec) refreshLCD();
+}
+
+/*!
+ * \brief Blank every cell (sent by refreshLCD()).
+ */
+void UIRims::_clearLCD()
+{
+	memset(_screen,' ',sizeof(_screen));
+}
+
+/*!
+ * \brief Blink the cursor (sent by refreshLCD()).
+ * \param state : boolean. If true, blink at _setCursorPosition().
+ */
+void UIRims::_setBlink(boolean state)
+{
+	if(state and not _blink) _cursorMoved = true;
+	_blink = state;
 }
 
 /*!
- * \brief Show mess at column col and row row on _lcd
- * \param mess : String. Message to print
+ * \brief Show mess at column col and row row on _lcd (sent by
+ *        refreshLCD()). Characters after the last column are ignored.
+ * \param mess : const char*. Message to print
  * \param col : byte. starting column on _lcd
  * \param row : byte. starting row on _lcd
  */
-void UIRims::_printStrLCD(String mess, byte col, byte row)
+void UIRims::_printStrLCD(const char* mess, byte col, byte row)
 {
-	_lcd->setCursor(col,row);
-	_lcd->print(mess);
-	_lcd->setCursor(_cursorCol,_cursorRow);
+	for(;*mess != '\0' and col<LCDCOLUMNS;col++) _screen[row][col] = *mess++;
+}
+
+/*!
+ * \brief Same as above with a message in program memory, F("...").
+ */
+void UIRims::_printStrLCD(const __FlashStringHelper* mess,
+						  byte col, byte row)
+{
+	const char* p = reinterpret_cast<const char*>(mess);
+	char c;
+	for(;(c = pgm_read_byte(p++)) != '\0' and col<LCDCOLUMNS;col++)
+	{
+		_screen[row][col] = c;
+	}
 }
 
 /*!
  * \brief Show a floating number at column col and row row
-          on _lcd
+          on _lcd, see _printFixedLCD().
  * \param val : float.
- * \param width : int. minumum width
- * \param prec : int. digit after point
+ * \param width : byte. minumum width
+ * \param prec : byte. digit after point
+ * \param col : byte. starting column on _lcd
+ * \param row : byte. starting row on _lcd
+ */
+void UIRims::_printFloatLCD(float val, byte width, byte prec,
+							byte col, byte row)
+{
+	for(byte i=0;i<prec;i++) val *= 10;
+	val += (val < 0) ? -0.5 : 0.5;
+	_printFixedLCD((long)val,width,prec,col,row);
+}
+
+/*!
+ * \brief Show a fixed point number at column col and row row on _lcd,
+ *        padded with zeros. Decimals are dropped if it doesn't fit in
+ *        width.
+ * \param val : long. Number times 10^prec.
+ * \param width : byte. minumum width
+ * \param prec : byte. digit after point
  * \param col : byte. starting column on _lcd
  * \param row : byte. starting row on _lcd
  */
-void UIRims::_printFloatLCD(float val, int width, int prec,
+void UIRims::_printFixedLCD(long val, byte width, byte prec,
 							byte col, byte row)
 {
-	char myFloatStr[17];
-	String res(dtostrf(val,width,prec,myFloatStr));
-	res.replace(' ','0');
-	if(res.length() > width)
+	char str[LCDCOLUMNS+1];
+	if(_formatFixed(str,val,width,prec) > width and prec > 0)
 	{
-		res = String(dtostrf(val,width,0,myFloatStr));
+		for(;prec>0;prec--) val = (val + (val < 0 ? -5 : 5)) / 10;
+		_formatFixed(str,val,width,0);
 	}
-	_lcd->setCursor(col,row);
-	_lcd->print(res);
-	_lcd->setCursor(_cursorCol,_cursorRow);
+	_printStrLCD(str,col,row);
+}
+
+/*!
+ * \brief Write a fixed point number in str, e.g. 53 with width 4 and
+ *        prec 1 is "05.3".
+ * \param str : char[LCDCOLUMNS+1].
+ * \return byte : length of str.
+ */
+byte UIRims::_formatFixed(char* str, long val, byte width, byte prec)
+{
+	char digits[10];
+	byte n = 0, len;
+	unsigned long absVal = (val < 0) ? -val : val;
+	do
+	{
+		digits[n++] = '0' + absVal % 10;
+		absVal /= 10;
+	}
+	while(absVal > 0 or n <= prec);
+	len = (val < 0) + n + (prec > 0);
+	if(val < 0) *str++ = '-';
+	for(;len<width and len<LCDCOLUMNS;len++) *str++ = '0';
+	while(n > 0)
+	{
+		if(n == prec) *str++ = '.';
+		*str++ = digits[--n];
+	}
+	*str = '\0';
+	return len;
 }
 
 /*!
  * \brief Set _lcd cursor at given column col and given row row
+ *        (sent by refreshLCD()).
  * \param col : byte. starting column on _lcd
  * \param row : byte. starting row on _lcd
  */
 void UIRims::_setCursorPosition(byte col, byte row)
 {
+	if(col != _cursorCol or row != _cursorRow) _cursorMoved = true;
 	_cursorCol = col;
 	_cursorRow = row;
-	_lcd->setCursor(col,row);
 }
 
 /*!
@@ -317,8 +448,8 @@ void UIRims::setTempPV(float tempCelcius, boolean buzz)
 		}
 		else
 		{
-			_printStrLCD(" #NC",3,1);
-			_printStrLCD("#NC",10,1);
+			_printStrLCD(F(" #NC"),3,1);
+			_printStrLCD(F("#NC"),10,1);
 		}
 	}
 }
@@ -339,8 +470,8 @@ void UIRims::setTime(unsigned int timeSec)
 	{
 		int minutes = timeSec / 60;
 		int seconds = timeSec % 60;
-		_printFloatLCD(minutes,3,0,5,0);
-		_printFloatLCD(seconds,2,0,9,0);
+		_printFixedLCD(minutes,3,0,5,0);
+		_printFixedLCD(seconds,2,0,9,0);
 	}
 }
 
@@ -362,9 +493,9 @@ void UIRims::setFlow(float flow, boolean buzz)
 	if(not _tempScreenShown)
 	{
 		_printFloatLCD(constrain(flow,0,99.9),4,1,5,1);
-		if(flowOk) _printStrLCD("\x01",15,1);
-		else if(flow<_flowLowBound) _printStrLCD("\x03",15,1);
-		else _printStrLCD("\x02",15,1);
+		if(flowOk) _printStrLCD(F("\x01"),15,1);
+		else if(flow<_flowLowBound) _printStrLCD(F("\x03"),15,1);
+		else _printStrLCD(F("\x02"),15,1);
 	}
 }
 
@@ -388,13 +519,13 @@ void UIRims::setFlowBounds(float lowBound, float upBound)
  * \param increase : boolean. If true, increment else, decrement.
  * \param lowerBound : float. decreasing limit of the value
  * \param upperBound : float. increasing limit of the value
- * \param timeFormat : boolean. treats the value (in sec) as a time
- *                     with minutes and secondes.
+ * \param format : byte. ASKTEMP, ASKVOLUME or ASKTIME (value in sec
+ *                 shown as a time with minutes and secondes).
  * \return float : result of increment/decrement
  */
 float UIRims::_incDecValue(float value,byte dotPosition, boolean increase,
 						   float lowerBound, float upperBound,
-						   boolean timeFormat)
+						   byte format)
 {
 	float res,constrainedRes;
 	int digitPosition, way = (increase) ? (+1) : (-1);
@@ -406,7 +537,7 @@ float UIRims::_incDecValue(float value,byte dotPosition, boolean increase,
 	{
 		digitPosition = (dotPosition - _cursorCol);
 	}
-	if(not timeFormat)
+	if(format != ASKTIME)
 	{
 		res = value + (way*pow(10,digitPosition));
 	}
@@ -423,11 +554,31 @@ float UIRims::_incDecValue(float value,byte dotPosition, boolean increase,
 	}
 	constrainedRes = (constrain(res,lowerBound,upperBound)!= res) ? \
 	                 (value) : (res);
-	if(not timeFormat) this->setTempSP(constrainedRes);
-	else this->setTime(constrainedRes);
+	_showAskedValue(constrainedRes,format);
 	return constrainedRes;
 }
 
+/*!
+ * \brief Show the value of _askValue() in its format.
+ * \param value : float.
+ * \param format : byte. ASKTEMP, ASKTIME or ASKVOLUME
+ */
+void UIRims::_showAskedValue(float value, byte format)
+{
+	switch(format)
+	{
+		case ASKTIME :
+			this->setTime(value);
+			break;
+		case ASKVOLUME :
+			_printFloatLCD(value,4,1,1,1);
+			break;
+		default :
+			this->setTempSP(value);
+			break;
+	}
+}
+
 /*!
  * \brief Move the cursor left or right on _lcd.
  * \param begin : byte. indicate the position (column) of the
@@ -467,22 +618,21 @@ void UIRims::_moveCursorLR(byte begin, byte end, byte dotPosition,
  * \param defaultVal : float. starting value
  * \param lowerBound : float. value's limits
  * \param upperBound : float. value's limits
- * \param timeFormat : boolean. treats the value (in sec) as a time
- *                      with minutes and secondes.
+ * \param format : byte. ASKTEMP, ASKTIME (value in sec shown as a
+ *                 time with minutes and secondes) or ASKVOLUME.
  * \return float : selected value
  */
 float UIRims::_askValue(byte begin, byte end, 
 						byte dotPosition, byte row,
 						float defaultVal,
 						float lowerBound, float upperBound,
-						boolean timeFormat)
+						byte format)
 {
 	boolean valSelected = false;
 	float value = defaultVal;
-	timeFormat ? this->setTime(defaultVal) : \
-	             this->setTempSP(defaultVal);
+	_showAskedValue(defaultVal,format);
 	_setCursorPosition(dotPosition-1,row);
-	_lcd->blink();
+	_setBlink(true);
 	_waitTime(500);
 	while(not valSelected)
 	{
@@ -492,11 +642,11 @@ float UIRims::_askValue(byte begin, byte end,
 				break;
 			case KEYUP :
 				value = _incDecValue(value,dotPosition,true,
-									lowerBound,upperBound,timeFormat);
+									lowerBound,upperBound,format);
 				break;
 			case KEYDOWN :
 				value = _incDecValue(value,dotPosition,false,
-									lowerBound,upperBound,timeFormat);
+									lowerBound,upperBound,format);
 				break;
 			case KEYLEFT :
 				_moveCursorLR(begin,end,dotPosition,
@@ -508,7 +658,7 @@ float UIRims::_askValue(byte begin, byte end,
 				break;
 			case KEYSELECT :
 				valSelected = true;
-				_lcd->noBlink();
+				_setBlink(false);
 				_setCursorPosition(0,0);
 				break;
 		}
@@ -525,8 +675,8 @@ float UIRims::askSetPoint(float defaultVal)
 {
 	float res;
 	this->showTempScreen();
-	_printStrLCD("                 ",0,1);
-	res = _askValue(3,6,5,0,defaultVal,0.0,99.9,false);
+	_printStrLCD(F("                "),0,1);
+	res = _askValue(3,6,5,0,defaultVal,0.0,99.9,ASKTEMP);
 	return res;
 }
 
@@ -539,8 +689,8 @@ unsigned int UIRims::askTime(unsigned int defaultVal)
 {
 	unsigned int res;
 	this->showTimeFlowScreen();
-	_printStrLCD("                 ",0,1);
-	res = _askValue(5,10,8,0,defaultVal,0,59999,true);
+	_printStrLCD(F("                "),0,1);
+	res = _askValue(5,10,8,0,defaultVal,0,59999,ASKTIME);
 	return res;
 }
 
@@ -560,18 +710,18 @@ byte UIRims::askMashWater(int mashWaterValues[], byte defaultVal)
 	boolean mashWaterSelected = false;
 	byte mashWaterIndex = defaultVal, mashChoices = 0;
 	byte keyPressed = KEYNONE;
-	_printStrLCD("Mash water qty: ",0,0);
+	_printStrLCD(F("Mash water qty: "),0,0);
 	for(int i=0;i<=3;i++)
 	{
 		if(mashWaterValues[i] != - 1)
 		{
-			_printStrLCD(" ",0,1);
-			_printFloatLCD(mashWaterValues[i],2,0,(4*i)+1,1);
-			_printStrLCD("L",(4*i)+3,1);
+			_printStrLCD(F(" "),0,1);
+			_printFixedLCD(mashWaterValues[i],2,0,(4*i)+1,1);
+			_printStrLCD(F("L"),(4*i)+3,1);
 			mashChoices++;
 		}
 	}
-	_printStrLCD("\x7e",mashWaterIndex*4,1);
+	_printStrLCD(F("\x7e"),mashWaterIndex*4,1);
 	_waitTime(500);
 	while(not mashWaterSelected)
 	{
@@ -579,7 +729,7 @@ byte UIRims::askMashWater(int mashWaterValues[], byte defaultVal)
 		if(keyPressed == KEYSELECT) mashWaterSelected = true;
 		else
 		{
-			_printStrLCD(" ",mashWaterIndex*4,1);
+			_printStrLCD(F(" "),mashWaterIndex*4,1);
 			if(keyPressed == KEYUP or keyPressed == KEYRIGHT)
 			{
 				mashWaterIndex = constrain(mashWaterIndex+1,0,mashChoices-1);
@@ -588,20 +738,34 @@ byte UIRims::askMashWater(int mashWaterValues[], byte defaultVal)
 			{
 				mashWaterIndex = constrain(mashWaterIndex-1,0,mashChoices-1);
 			}
-			_printStrLCD("\x7e",mashWaterIndex*4,1);
+			_printStrLCD(F("\x7e"),mashWaterIndex*4,1);
 		}
 	}
 	return mashWaterIndex;
 }
 
+/*!
+ * \brief Ask the exact mash water quantity (gain table of
+ *        Rims::setTuningTable()).
+ * \param defaultVal : float. in liters
+ * \return float : selected value in liters, 0.0 to 99.9
+ */
+float UIRims::askMashVolume(float defaultVal)
+{
+	_clearLCD();
+	_printStrLCD(F("Mash water qty: "),0,0);
+	_printStrLCD(F(" 00.0L"),0,1);
+	return _askValue(1,4,3,1,defaultVal,0.0,99.9,ASKVOLUME);
+}
+
 /*!
  * \brief Show the pump switching warning.
  */
 void UIRims::showPumpWarning(float flow)
 {
-	_lcd->clear();
-	_printStrLCD("start pump  [OK]",0,0);
-	_printStrLCD("flow:00.0L/min",0,1);
+	_clearLCD();
+	_printStrLCD(F("start pump  [OK]"),0,0);
+	_printStrLCD(F("flow:00.0L/min"),0,1);
 	setFlow(flow,false);
 	_waitTime(500);
 }
@@ -611,9 +775,9 @@ void UIRims::showPumpWarning(float flow)
  */
 void UIRims::showHeaterWarning(float state)
 {
-	_lcd->clear();
-	_printStrLCD("start heater[OK]",0,0);
-	_printStrLCD("state:off",0,1);
+	_clearLCD();
+	_printStrLCD(F("start heater[OK]"),0,0);
+	_printStrLCD(F("state:off"),0,1);
 	setHeaterVoltState(state,false);
 	_waitTime(500);
 }
@@ -623,9 +787,10 @@ void UIRims::showHeaterWarning(float state)
  */
 void UIRims::showMemAccessScreen()
 {
-	_lcd->clear();
-	_printStrLCD("USB memory",0,0);
-	_printStrLCD("access mode",0,1);
+	_clearLCD();
+	_printStrLCD(F("USB memory"),0,0);
+	_printStrLCD(F("access mode"),0,1);
+	refreshLCD(LCDROWS*LCDCOLUMNS); // serial menu is blocking
 }
 
 /*!
@@ -636,6 +801,6 @@ void UIRims::showMemAccessScreen()
  */
 void UIRims::setHeaterVoltState(boolean state, boolean buzz)
 {
-	if(not buzz) state ? _printStrLCD("on ",6,1): _printStrLCD("off",6,1);
+	if(not buzz) state ? _printStrLCD(F("on "),6,1): _printStrLCD(F("off"),6,1);
 	else if(!state) tone(_pinSpeaker,POWERFREQ,ALARMLENGTH);
 }
\ No newline at end of file
@@ -15,6 +15,8 @@
 
 #define LCDCOLUMNS 16
 #define LCDROWS 2
+/// \brief Cells sent at most by each UIRims::refreshLCD() call
+#define LCDREFRESHCELLS 4
 
 #define NCTHERM 404
 
@@ -32,6 +34,11 @@
 /// \brief Software key debounce time [mSec]
 #define KEYDEBOUNCETIME 15
 
+/// \brief Value formats of UIRims::_askValue()
+#define ASKTEMP 0   /// set point [celcius] on tempScreen
+#define ASKTIME 1   /// timer [sec] on timeFlowScreen
+#define ASKVOLUME 2 /// mash water [L], see askMashVolume()
+
 #include "Arduino.h"
 #include "LiquidCrystal.h"
 
@@ -65,6 +72,7 @@ public:
 	void showTimeFlowScreen();
 	void showMemAccessScreen();
 	void switchScreen();
+	void refreshLCD(byte maxCells = LCDREFRESHCELLS);
 	
 	// === VARIABLE SETTER ===
 	void setTempSP(float tempCelcius);
@@ -86,6 +94,7 @@ public:
 	float askSetPoint(float defaultVal); // Celsius
 	unsigned int askTime(unsigned int defaultVal); // seconds
 	byte askMashWater(int mashWaterValues[],byte defaultVal);
+	float askMashVolume(float defaultVal); // liters
 
 	
 	
@@ -94,9 +103,16 @@ protected:
 	byte _waitForKeyChange();
 	void _waitTime(unsigned long timeInMilliSec);
 	
-	void _printStrLCD(String mess, byte col, byte row);
-	void _printFloatLCD(float val, int width, int prec,
+	void _clearLCD();
+	void _setBlink(boolean state);
+	void _printStrLCD(const char* mess, byte col, byte row);
+	void _printStrLCD(const __FlashStringHelper* mess,
+					  byte col, byte row);
+	void _printFloatLCD(float val, byte width, byte prec,
+						byte col, byte row);
+	void _printFixedLCD(long val, byte width, byte prec,
 						byte col, byte row);
+	static byte _formatFixed(char* str, long val, byte width, byte prec);
 	void _setCursorPosition(byte col, byte row);
 	float _celciusToFahrenheit(float celcius);
 	void _moveCursorLR(byte begin, byte end, byte dotPosition,
@@ -104,17 +120,23 @@ protected:
 	float _incDecValue(float value,byte dotPosition, 
 					   boolean increase,
 					   float lowerBound, float upperBound,
-					   boolean timeFormat);
+					   byte format);
 	float _askValue(byte begin, byte end, 
 					byte dotPosition, byte row,
 					float defaultVal,
 				    float lowerBound, float upperBound,
-					boolean timeFormat);
+					byte format);
+	void _showAskedValue(float value, byte format);
 private:
 	
 	LiquidCrystal* _lcd;
+	char _screen[LCDROWS][LCDCOLUMNS]; // cells to show
+	char _shown[LCDROWS][LCDCOLUMNS];  // cells on _lcd
 	byte _cursorCol;
 	byte _cursorRow;
+	boolean _cursorMoved;
+	boolean _blink;
+	boolean _blinkShown;
 	byte _pinKeysAnalog;
 	byte _pinLight;
 	char _pinSpeaker;
@@ -25,9 +25,9 @@ UIRimsIdent::UIRimsIdent(LiquidCrystal* lcd,
  */
 void UIRimsIdent::showSerialWarning()
 {
-	_lcd->clear();
-	_printStrLCD("open serial [OK]",0,0);
-	_printStrLCD("monitor",0,1);
+	_clearLCD();
+	_printStrLCD(F("open serial [OK]"),0,0);
+	_printStrLCD(F("monitor"),0,1);
 	_waitTime(500);
 }
 
@@ -36,9 +36,9 @@ void UIRimsIdent::showSerialWarning()
  */
 void UIRimsIdent::showIdentScreen()
 {
-	_lcd->clear();
-	_printStrLCD("000% 000m00s    ",0,0);
-	_printStrLCD("PV:00.0\xdf""C(000\xdf""F)",0,1);
+	_clearLCD();
+	_printStrLCD(F("000% 000m00s    "),0,0);
+	_printStrLCD(F("PV:00.0\xdf""C(000\xdf""F)"),0,1);
 	_tempScreenShown = true;
 }
 
@@ -50,7 +50,32 @@ void UIRimsIdent::showIdentScreen()
 void UIRimsIdent::setIdentCV(unsigned long controlValue, 
 							 unsigned long ssrWindow)
 {
-	_printFloatLCD(controlValue*100/ssrWindow,3,0,0,0);
+	_printFixedLCD(controlValue*100/ssrWindow,3,0,0,0);
+}
+
+/*!
+ * \brief Show the ultimate gain and period of the relay autotune
+ *        (RimsIdent::setAutotune()).
+ * \param ultimateGain : float. [mSec/celcius], 0 if not converged.
+ * \param ultimatePeriod : float. [sec]
+ */
+void UIRimsIdent::showAutotuneResult(float ultimateGain,
+									 float ultimatePeriod)
+{
+	_clearLCD();
+	_tempScreenShown = false;
+	if(ultimateGain > 0)
+	{
+		_printStrLCD(F("Ku:00000 Pu:000s"),0,0);
+		_printFloatLCD(ultimateGain,5,0,3,0);
+		_printFloatLCD(ultimatePeriod,3,0,12,0);
+		_printStrLCD(F("autotune ok [OK]"),0,1);
+	}
+	else
+	{
+		_printStrLCD(F("no convergence"),0,0);
+		_printStrLCD(F("autotune    [OK]"),0,1);
+	}
 }
 
 /*!
@@ -26,6 +26,7 @@ public:
 	void showIdentScreen();
 	
 	void setIdentCV(unsigned long controlValue, unsigned long ssrWindow);
+	void showAutotuneResult(float ultimateGain, float ultimatePeriod);
 	void setTime(unsigned int timeSec);
 };
 
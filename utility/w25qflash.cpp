@@ -4,7 +4,7 @@
 
 
 W25QFlash::W25QFlash() :
-_csPin(255)
+_csPin(255), _busy(true), _queueHead(0), _queueQty(0)
 {
 	SPI.begin();
 	SPI.setClockDivider(SPI_CLOCK_DIV2);
@@ -16,24 +16,50 @@ void W25QFlash::setCSPin(byte csPin)
 	_csPin = csPin;
 	pinMode(csPin,OUTPUT);
 	_deselect();
+	_busy = true;
 }
 
+// An erase started before a reset may still run : waits for it, but
+// not forever. Without a chip, MISO reads 0xFF (status always busy,
+// manufacturer 0xFF) : no memory, the sketch goes on without it. A
+// real status is never 0xFF (all blocks protected, nothing can erase).
 boolean W25QFlash::verifyMem()
 {
-	byte manuf, devID;
+	byte manuf, devID, status;
+	_select();
+	status = _getStatus();
+	_deselect();
+	if(status == 0xFF) return false; // no memory
+	if(not waitFree(W25Q_BUSYTIMEOUT)) return false;
 	_select();
 	_sendCmdAddr(W25Q_READID,0x000000);
 	manuf = SPI.transfer(0xFF);
 	devID = SPI.transfer(0xFF);
 	_deselect();
+	if(manuf == 0xFF) return false; // no memory
 	return (manuf == 0xEF); // Winbond manufacturer
 }
 
-void W25QFlash::waitFree()
+// Only polls after a program or an erase. Status register is sent
+// again and again while selected, the instruction is sent once.
+// timeout [mSec], 0 : no time-out. Returns false if still busy.
+boolean W25QFlash::waitFree(unsigned long timeout)
 {
+	unsigned long start = millis();
+	if(not _busy) return true;
 	_select();
-	while(_getStatus() & W25Q_MASK_BSY);
+	SPI.transfer(W25Q_SR_READ1);
+	while(SPI.transfer(0xFF) & W25Q_MASK_BSY)
+	{
+		if(timeout != 0 and millis() - start >= timeout)
+		{
+			_deselect();
+			return false;
+		}
+	}
 	_deselect();
+	_busy = false;
+	return true;
 }
 
 void W25QFlash::setWriteEnable(bool state)
@@ -46,46 +72,135 @@ void W25QFlash::setWriteEnable(bool state)
 
 void W25QFlash::erase(unsigned long addr, byte command)
 {
+	flush();
 	waitFree();
 	setWriteEnable();
 	_select();
 	if(command != W25Q_ERASE_CHIP) _sendCmdAddr(command,addr);
 	else SPI.transfer(command);
 	_deselect();
+	_busy = true;
 }
 
 
 void W25QFlash::read(unsigned long addr, byte buffer[], unsigned long n)
 {
-	unsigned long i;
+	flush();
 	waitFree();
 	_select();
-	_sendCmdAddr(W25Q_READ,addr);
-	for(i=0;i<n;i++) buffer[i] = SPI.transfer(0xFF);
+	_sendCmdAddr(W25Q_FASTREAD,addr);
+	SPI.transfer(0xFF); // dummy byte
+	_transferIn(buffer,n);
 	_deselect();
-
 }
 
+// Split at page boundaries, one write enable and one instruction
+// per page.
 void W25QFlash::program(unsigned long addr, byte buffer[], unsigned long n)
 {
-	unsigned long i;
-	waitFree();
-	setWriteEnable();
-	_select();
-	_sendCmdAddr(W25Q_PROG_PAGE,addr);
-	for(i=0;i<n;i++)
+	unsigned long size;
+	flush();
+	while(n > 0)
+	{
+		size = W25Q_PAGESIZE - (addr & (W25Q_PAGESIZE-1));
+		if(size > n) size = n;
+		waitFree();
+		setWriteEnable();
+		_select();
+		_sendCmdAddr(W25Q_PROG_PAGE,addr);
+		_transferOut(buffer,size);
+		_deselect();
+		_busy = true;
+		addr += size;
+		buffer += size;
+		n -= size;
+	}
+}
+
+// Up to W25Q_QUEUEDATA bytes are copied in the queue. Up to a page
+// is not copied : the caller keeps its buffer unchanged as long as
+// queued() is true. Buffers across a page boundary are programmed at
+// once by program(), which waits for the memory.
+void W25QFlash::queueProgram(unsigned long addr, byte buffer[],
+                             unsigned long n)
+{
+	byte i;
+	if((addr & (W25Q_PAGESIZE-1)) + n > W25Q_PAGESIZE)
+	{
+		program(addr,buffer,n);
+		return;
+	}
+	if(_queueQty == W25Q_QUEUESIZE) flush();
+	i = (_queueHead + _queueQty) % W25Q_QUEUESIZE;
+	_queueCmd[i] = W25Q_PROG_PAGE;
+	_queueAddr[i] = addr;
+	if(n > W25Q_QUEUEDATA) _queueBuffer[i] = buffer;
+	else
+	{
+		memcpy(_queueData[i],buffer,n);
+		_queueBuffer[i] = _queueData[i];
+	}
+	_queueSize[i] = n;
+	_queueQty++;
+}
+
+// True while a queued program still reads the caller's buffer.
+boolean W25QFlash::queued(const byte buffer[])
+{
+	for(byte j=0;j<_queueQty;j++)
 	{
-		if(not( (addr+i) & 0xFF )) // new page
+		if(_queueBuffer[(_queueHead + j) % W25Q_QUEUESIZE] == buffer)
 		{
-			_deselect();
-			waitFree();
-			setWriteEnable();
-			_select();
-			_sendCmdAddr(W25Q_PROG_PAGE,addr+i);
+			return true;
 		}
-		SPI.transfer(buffer[i]);
 	}
+	return false;
+}
+
+void W25QFlash::queueErase(unsigned long addr, byte command)
+{
+	byte i;
+	if(_queueQty == W25Q_QUEUESIZE) flush();
+	i = (_queueHead + _queueQty) % W25Q_QUEUESIZE;
+	_queueCmd[i] = command;
+	_queueAddr[i] = addr;
+	_queueBuffer[i] = _queueData[i];
+	_queueSize[i] = 0;
+	_queueQty++;
+}
+
+// One step, never waits : a single status read while the memory is
+// busy, else the oldest queued instruction is sent.
+void W25QFlash::poll()
+{
+	byte i = _queueHead;
+	if(_queueQty == 0) return;
+	if(_busy)
+	{
+		_select();
+		_busy = _getStatus() & W25Q_MASK_BSY;
+		_deselect();
+		if(_busy) return;
+	}
+	setWriteEnable();
+	_select();
+	if(_queueCmd[i] == W25Q_ERASE_CHIP) SPI.transfer(_queueCmd[i]);
+	else _sendCmdAddr(_queueCmd[i],_queueAddr[i]);
+	_transferOut(_queueBuffer[i],_queueSize[i]);
 	_deselect();
+	_busy = true;
+	_queueHead = (i + 1) % W25Q_QUEUESIZE;
+	_queueQty--;
+}
+
+// Blocking : send every queued instruction.
+void W25QFlash::flush()
+{
+	while(_queueQty > 0)
+	{
+		waitFree();
+		poll();
+	}
 }
 
 byte W25QFlash::_getStatus()
@@ -100,4 +215,49 @@ void W25QFlash::_sendCmdAddr(byte cmd, unsigned long addr)
 	SPI.transfer((addr>>16) & 0xFF);
 	SPI.transfer((addr>> 8) & 0xFF);
 	SPI.transfer((addr)     & 0xFF);
-}
\ No newline at end of file
+}
+
+#if defined(SPDR) && defined(SPIF)
+// Directly with SPI registers : next byte is loaded (or the previous
+// one stored) while the current one is shifted, no call per byte.
+void W25QFlash::_transferIn(byte buffer[], unsigned long n)
+{
+	byte data;
+	if(n == 0) return;
+	SPDR = 0xFF;
+	while(--n)
+	{
+		while(not(SPSR & (1 << SPIF)));
+		data = SPDR;
+		SPDR = 0xFF;
+		*buffer++ = data;
+	}
+	while(not(SPSR & (1 << SPIF)));
+	*buffer = SPDR;
+}
+
+void W25QFlash::_transferOut(const byte buffer[], unsigned long n)
+{
+	byte data;
+	if(n == 0) return;
+	SPDR = *buffer++;
+	while(--n)
+	{
+		data = *buffer++;
+		while(not(SPSR & (1 << SPIF)));
+		SPDR = data;
+	}
+	while(not(SPSR & (1 << SPIF)));
+	data = SPDR; // clears SPIF
+}
+#else
+void W25QFlash::_transferIn(byte buffer[], unsigned long n)
+{
+	for(unsigned long i=0;i<n;i++) buffer[i] = SPI.transfer(0xFF);
+}
+
+void W25QFlash::_transferOut(const byte buffer[], unsigned long n)
+{
+	for(unsigned long i=0;i<n;i++) SPI.transfer(buffer[i]);
+}
+#endif
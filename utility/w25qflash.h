@@ -9,6 +9,7 @@
 #define W25Q_WDI      0x04
 
 #define W25Q_READ     0x03
+#define W25Q_FASTREAD 0x0B // one dummy byte after address
 
 #define W25Q_PROG_PAGE 0x02
 
@@ -21,6 +22,15 @@
 #define W25Q_SR_READ1  0x05
 #define W25Q_SR_READ2  0x35
 #define W25Q_SR_WRITE  0x01 
+// === W25Q SIZES ===
+#define W25Q_PAGESIZE  256
+
+// === W25Q TIMING ===
+#define W25Q_BUSYTIMEOUT 6000 // mSec, longest erase (chip) of verifyMem()
+
+// === W25Q QUEUE ===
+#define W25Q_QUEUESIZE 4  // instructions waiting for poll()
+#define W25Q_QUEUEDATA 4  // bytes copied by queueProgram(), more : kept by caller
 
 // === W25Q MASKS ===
 
@@ -40,23 +50,42 @@ public :
 	
 	boolean verifyMem();
 	
-	void waitFree();
+	boolean waitFree(unsigned long timeout = 0);
 	void setWriteEnable(bool state = true);
 	
 	void read(unsigned long addr, byte buffer[], unsigned long n);
 	void program(unsigned long addr, byte buffer[], unsigned long n);
 	void erase(unsigned long addr, byte command = W25Q_ERASE_SECTOR);
 	
+	void queueProgram(unsigned long addr, byte buffer[], unsigned long n);
+	void queueErase(unsigned long addr, byte command = W25Q_ERASE_SECTOR);
+	void poll();
+	void flush();
+	boolean pending() {return _queueQty > 0;}
+	boolean queued(const byte buffer[]);
+	
 protected:
 	
 	void _select() {digitalWrite(_csPin,LOW);}
 	void _deselect() {digitalWrite(_csPin,HIGH);}
 	byte _getStatus();
 	void _sendCmdAddr(byte cmd, unsigned long addr);
+	void _transferIn(byte buffer[], unsigned long n);
+	void _transferOut(const byte buffer[], unsigned long n);
 	
 private :
 	
 	byte _csPin;
+	boolean _busy; // program or erase may be running
+	
+	// parallel arrays, oldest instruction at _queueHead
+	byte _queueCmd[W25Q_QUEUESIZE];
+	unsigned long _queueAddr[W25Q_QUEUESIZE];
+	byte _queueData[W25Q_QUEUESIZE][W25Q_QUEUEDATA];
+	const byte* _queueBuffer[W25Q_QUEUESIZE]; // _queueData or caller's
+	unsigned int _queueSize[W25Q_QUEUESIZE];
+	byte _queueHead;
+	byte _queueQty;
 	
 };
 